@@ -26,5 +26,19 @@ namespace Config
         constexpr std::string_view HoldToOverwrite      = "HoldToOverwrite";
         constexpr std::string_view HoldToRestore        = "HoldToRestore";
         constexpr std::string_view HoldToDelete         = "HoldToDelete";
+        // Size in MB written between save commits during a restore. 0 commits once after everything is written.
+        constexpr std::string_view CommitInterval = "CommitInterval";
+        // Folder backups only write files that changed since the newest backup of the title.
+        constexpr std::string_view IncrementalBackups = "IncrementalBackups";
+        // New backups are index files pointing into a chunk store shared by every backup of the title.
+        constexpr std::string_view DeduplicatedBackups = "DeduplicatedBackups";
+        // Folder restores only write files that differ from the save instead of wiping it first.
+        constexpr std::string_view DifferentialRestore = "DifferentialRestore";
+        // Files are read back after they're written and checked against what was read.
+        constexpr std::string_view VerifyCopies = "VerifyCopies";
+        // Number of large files folder copies write at once. 0 picks based on the system.
+        constexpr std::string_view ParallelCopies = "ParallelCopies";
+        // What ZIP backups favor when picking how each file is compressed. 0 is speed, 1 balances speed and size, 2 is size.
+        constexpr std::string_view ZipCompression = "ZipCompression";
     } // namespace Keys
 } // namespace Config
@@ -0,0 +1,38 @@
+#pragma once
+#include "fslib.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace FS
+{
+    // Lists what's in ZIP backups and backup archives without extracting anything. ZIPs are listed from their central
+    // directory and archives from their index, so only the end of the backup is ever read. Listings are cached by path so
+    // going back to a backup doesn't read it again.
+
+    // Single file in a backup. Path is relative to the backup root and UTF-8 so it can be shown as is.
+    typedef struct
+    {
+            std::string Path;
+            uint64_t Size;
+    } BackupListingEntry;
+
+    typedef struct
+    {
+            std::vector<FS::BackupListingEntry> Entries;
+            // What every file adds up to and how much of the backup they take up.
+            uint64_t TotalSize;
+            uint64_t StoredSize;
+            // Size of the backup when it was listed. The cached listing is thrown out if this changes.
+            uint64_t BackupSize;
+    } BackupListing;
+
+    // Returns the listing of the backup at BackupPath, reading it only if it isn't cached. Returns nullptr if BackupPath isn't
+    // a ZIP or an archive, or it couldn't be read.
+    std::shared_ptr<const FS::BackupListing> GetBackupListing(const fslib::Path &BackupPath);
+
+    // Drops the cached listing of BackupPath. This needs to be called when a backup is overwritten or deleted.
+    void ForgetBackupListing(const fslib::Path &BackupPath);
+} // namespace FS
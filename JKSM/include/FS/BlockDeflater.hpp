@@ -0,0 +1,92 @@
+#pragma once
+#include "System/ThreadPool.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <zlib.h>
+
+#include <minizip/zip.h>
+
+namespace FS
+{
+    // Deflates a ZIP entry in blocks on a pool of workers the way pigz does. Every block but the last is ended with a sync
+    // flush so it stops on a byte boundary, which makes the blocks joined in order one ordinary DEFLATE stream. Each block is
+    // primed with the 32KB before it so the ratio stays close to deflating the whole entry on one thread. The blocks' CRCs are
+    // combined into the entry's, so the entry has to be opened raw and closed with zipCloseFileInZipRaw.
+    class BlockDeflater
+    {
+        public:
+            // Size of the blocks entries are cut into.
+            static constexpr size_t BLOCK_SIZE = 0x20000;
+
+            // Starts WorkerCount workers.
+            BlockDeflater(size_t WorkerCount);
+            ~BlockDeflater();
+
+            // Starts a new entry deflated at Level. Deflated blocks are written to Destination in order as they finish.
+            void Begin(zipFile Destination, int Level);
+
+            // Adds Size bytes of Data to the entry. Returns false if deflating or writing failed.
+            bool Update(const void *Data, size_t Size);
+
+            // Deflates whatever is left and waits for every block to be written. The entry's CRC, uncompressed size and
+            // compressed size are written to CrcOut, SizeOut and CompressedSizeOut. Returns false if anything failed.
+            bool Finish(uint32_t &CrcOut, uint64_t &SizeOut, uint64_t &CompressedSizeOut);
+
+        private:
+            // One block being filled, deflated or waiting to be written.
+            typedef struct
+            {
+                    std::unique_ptr<unsigned char[]> Input;
+                    size_t InputSize;
+                    // End of the block before this one.
+                    std::unique_ptr<unsigned char[]> Dictionary;
+                    size_t DictionarySize;
+                    std::unique_ptr<unsigned char[]> Output;
+                    size_t OutputSize;
+                    z_stream Stream;
+                    // Level the block is deflated at and the level Stream is set to.
+                    int Level;
+                    int StreamLevel;
+                    uint32_t Crc;
+                    bool Last;
+                    // Set by the worker once Output and Crc are ready.
+                    bool Done;
+                    bool Failed;
+            } Block;
+
+            // Blocks are used as a ring. m_Filling is being filled, m_Oldest is the oldest one not written yet and m_Pending
+            // is how many are with the workers or waiting to be written.
+            std::vector<std::unique_ptr<Block>> m_Blocks;
+            size_t m_Filling = 0;
+            size_t m_Oldest  = 0;
+            size_t m_Pending = 0;
+            // Size of each block's output buffer.
+            size_t m_OutputCapacity = 0;
+            // Entry being written and what's been written of it so far.
+            zipFile m_Destination     = nullptr;
+            int m_Level               = Z_DEFAULT_COMPRESSION;
+            uint32_t m_Crc            = 0;
+            uint64_t m_Size           = 0;
+            uint64_t m_CompressedSize = 0;
+            bool m_Failed             = false;
+            // Whether the block being filled is the entry's first.
+            bool m_FirstBlock = true;
+            // Guards Done and Failed in every block.
+            std::mutex m_BlockLock;
+            std::condition_variable m_BlockDone;
+            // Workers. This is last so it's joined before the blocks are freed.
+            std::unique_ptr<System::ThreadPool> m_Workers;
+
+            // Hands the block being filled to the workers and moves on to the next one.
+            void SubmitBlock(bool Last);
+            // Waits for the oldest block and writes it.
+            void WriteOldestBlock();
+            // Run by the workers.
+            void DeflateBlock(Block *Target);
+    };
+} // namespace FS
@@ -0,0 +1,101 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace FS
+{
+    // This is a fixed set of buffers passed between a producer and a consumer without copying. The producer takes an empty
+    // buffer, fills it and pushes it. The consumer pops it, uses it and hands it back. Buffers are always returned in the
+    // order they were pushed, so the producer can run BufferCount buffers ahead of the consumer.
+    class BufferRing
+    {
+        public:
+            // One slot in the ring. Size is how much of Data is actually used.
+            typedef struct
+            {
+                    std::unique_ptr<unsigned char[]> Data;
+                    size_t Size = 0;
+            } Buffer;
+
+            // How often and how long each side had to wait on the other. Times are in microseconds. This isn't cleared by Reset
+            // so it covers every file the ring was used for.
+            typedef struct
+            {
+                    uint64_t ProducerWaits;
+                    uint64_t ProducerWaitTime;
+                    uint64_t ConsumerWaits;
+                    uint64_t ConsumerWaitTime;
+            } Statistics;
+
+            // Allocates BufferCount buffers of BufferSize bytes each.
+            BufferRing(size_t BufferCount, size_t BufferSize);
+
+            // Producer: waits for an empty buffer. Returns nullptr if the consumer cancelled.
+            Buffer *AcquireEmpty();
+            // Producer: hands a filled buffer to the consumer.
+            void PushFull(Buffer *FullBuffer);
+            // Producer: signals no more buffers are coming. Must be the last thing the producer does with the ring.
+            void Close();
+
+            // Consumer: waits for the next filled buffer. Returns nullptr once the producer has closed and everything is
+            // drained.
+            Buffer *AcquireFull();
+            // Consumer: gives the buffer back to the producer.
+            void Release(Buffer *EmptyBuffer);
+            // Consumer: tells the producer to stop.
+            void Cancel();
+            // Consumer: signals it's done with the ring. Must be the last thing the consumer does with it.
+            void Finish();
+            // Waits until the producer has called Close. Needed so whatever the producer is using outlives it.
+            void WaitForClose();
+            // Producer: waits until the consumer has called Finish. Same as above for when the consumer is the job.
+            void WaitForFinish();
+
+            // Puts every buffer back in the empty queue so the ring can be used for the next file. Neither side can be using
+            // it.
+            void Reset();
+
+            // Returns the size of each buffer.
+            size_t GetBufferSize() const;
+            // Returns the number of buffers.
+            size_t GetBufferCount() const;
+            // Returns the wait statistics.
+            Statistics GetStatistics();
+
+        private:
+            // Tiny fixed size queue of buffer indexes. It never holds more than the number of buffers, so it never allocates.
+            typedef struct
+            {
+                    std::vector<size_t> Slots;
+                    size_t Head  = 0;
+                    size_t Count = 0;
+            } IndexQueue;
+
+            // Buffers.
+            std::vector<Buffer> m_Buffers;
+            // Size of each buffer.
+            size_t m_BufferSize = 0;
+            // Empty and full queues.
+            IndexQueue m_Empty, m_Full;
+            // Guards both queues and the state flags.
+            std::mutex m_RingLock;
+            // Signaled when either queue or a flag changes.
+            std::condition_variable m_RingCondition;
+            // Producer is finished.
+            bool m_Closed = false;
+            // Consumer wants the producer to stop.
+            bool m_Cancelled = false;
+            // Consumer is finished.
+            bool m_Finished = false;
+            // Wait statistics.
+            Statistics m_Statistics = {0};
+
+            // Queue helpers. Both expect m_RingLock to be held.
+            static void Push(IndexQueue &Queue, size_t Index);
+            static size_t Pop(IndexQueue &Queue);
+    };
+} // namespace FS
@@ -0,0 +1,102 @@
+#pragma once
+#include "FS/BufferRing.hpp"
+#include "FS/Transaction.hpp"
+#include "System/ProgressTask.hpp"
+#include "fslib.hpp"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace FS
+{
+    // This is a store of file chunks shared by every deduplicated backup of a title. Files are split into fixed size chunks
+    // named after their hash and each backup is only an index file listing the chunks it's made of. A chunk the store already
+    // has is never written again.
+    class ChunkStore
+    {
+        public:
+            // Extension index files use.
+            static constexpr std::u16string_view INDEX_EXTENSION = u"jksi";
+            // Name of the store folder inside the title's folder.
+            static constexpr std::u16string_view STORE_NAME = u"._chunks";
+
+            // Opens the store in TitlePath. Nothing is read until it's needed.
+            ChunkStore(const fslib::Path &TitlePath);
+
+            // Splits every file in Source into chunks, writes the ones the store doesn't have yet and writes the index to
+            // IndexPath.
+            bool Backup(System::ProgressTask *Task, const fslib::Path &Source, const fslib::Path &IndexPath);
+
+            // Rebuilds the backup IndexPath points to in Destination. Chunks are streamed straight into the files.
+            bool Restore(System::ProgressTask *Task,
+                         const fslib::Path &IndexPath,
+                         const fslib::Path &Destination,
+                         FS::Transaction *Transaction);
+
+            // Deletes every chunk no index in the title's folder uses anymore. This should be called after an index is deleted
+            // or overwritten.
+            void Collect();
+
+            // Chunks are 128 bit hashes of their data.
+            typedef struct
+            {
+                    uint64_t High;
+                    uint64_t Low;
+            } ChunkID;
+
+            // Single file or directory in an index. Path is relative to the backup root.
+            typedef struct
+            {
+                    bool IsDirectory;
+                    uint64_t Size;
+                    std::u16string Path;
+                    std::vector<ChunkID> Chunks;
+            } IndexEntry;
+
+        private:
+            // Hasher so ChunkIDs can be used in sets.
+            struct ChunkIDHash
+            {
+                    size_t operator()(const ChunkID &ID) const { return static_cast<size_t>(ID.High ^ ID.Low); }
+            };
+            struct ChunkIDEqual
+            {
+                    bool operator()(const ChunkID &A, const ChunkID &B) const { return A.High == B.High && A.Low == B.Low; }
+            };
+            typedef std::unordered_set<ChunkID, ChunkIDHash, ChunkIDEqual> ChunkSet;
+
+            // Title folder and the store inside it.
+            fslib::Path m_TitlePath;
+            fslib::Path m_StorePath;
+            // Chunks known to be in the store. Only filled during a backup.
+            ChunkSet m_KnownChunks;
+            // Which prefix folders are known to exist.
+            std::array<bool, 256> m_PrefixExists = {false};
+            // Ring buffers are chunk sized so every buffer is exactly one chunk.
+            FS::BufferRing m_Ring;
+            // Whether a file couldn't be chunked during the current backup. The index isn't written if one couldn't.
+            bool m_Failed = false;
+
+            // Chunks everything in Source. Entries are appended to EntriesOut. This stops at the first file that fails.
+            void BackupDirectory(System::ProgressTask *Task, const fslib::Path &Source, std::vector<IndexEntry> &EntriesOut);
+            // Chunks a single file.
+            bool BackupFile(System::ProgressTask *Task, const fslib::Path &Source, IndexEntry &EntryOut);
+            // Writes a chunk to the store if it isn't there already.
+            bool WriteChunk(const ChunkID &ID, const unsigned char *Data, size_t Size);
+            // Rebuilds a single file from its chunks.
+            bool RestoreFile(System::ProgressTask *Task,
+                             const IndexEntry &Entry,
+                             const fslib::Path &Destination,
+                             FS::Transaction *Transaction);
+            // This is the pool job that reads Chunks into the ring.
+            void ReadChunksToRing(const std::vector<ChunkID> &Chunks);
+            // Fills Chunks with every chunk in the store.
+            void ListChunks(ChunkSet &Chunks);
+            // Returns the path of the chunk ID in the store.
+            fslib::Path GetChunkPath(const ChunkID &ID) const;
+    };
+} // namespace FS
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <zlib.h>
+
+namespace FS
+{
+    // What ZIP backups favor when they pick how each file is compressed. The values match the ZipCompression config key.
+    enum class CompressionPreference : uint8_t
+    {
+        Speed,
+        Balanced,
+        Size
+    };
+
+    // Picks how each file in a ZIP backup is compressed. The start of every file is deflated at the fast level first to see
+    // how well it compresses. Files that barely shrink, like ones that are already compressed, are stored so no time is
+    // spent on them. The rest are deflated fast or strong depending on the preference and how well the probe did. Every
+    // choice is logged with the ratio it got.
+    class CompressionPolicy
+    {
+        public:
+            // How a file ends up in the ZIP.
+            enum class Method : uint8_t
+            {
+                Store,
+                Fast,
+                Strong
+            };
+
+            // Files this size or smaller are always stored. Deflating them doesn't make up for the headers they need anyway.
+            static constexpr uint64_t TINY_FILE_SIZE = 0x100;
+            // How much of the start of a file is deflated to probe it.
+            static constexpr size_t PROBE_SIZE = 0x4000;
+
+            CompressionPolicy(FS::CompressionPreference Preference);
+            ~CompressionPolicy();
+
+            // Picks the method for a file FileSize bytes long that starts with the SampleSize bytes in Sample.
+            CompressionPolicy::Method Choose(const void *Sample, size_t SampleSize, uint64_t FileSize);
+
+            // Returns the deflate level Choice uses. Store is 0.
+            static int GetLevel(CompressionPolicy::Method Choice);
+
+            // Logs how FileName came out with Choice and what its probe deflated to, then adds it to the totals.
+            void Record(const char *FileName, CompressionPolicy::Method Choice, uint64_t Size, uint64_t CompressedSize);
+
+            // Logs how many files went each way and how much each method saved.
+            void LogTotals() const;
+
+        private:
+            // Files and bytes compressed with one method.
+            typedef struct
+            {
+                    uint32_t FileCount;
+                    uint64_t Size;
+                    uint64_t CompressedSize;
+            } MethodTotals;
+
+            FS::CompressionPreference m_Preference;
+            // Stream the probes are deflated with and where their output goes.
+            z_stream m_Probe  = {};
+            bool m_ProbeReady = false;
+            std::unique_ptr<unsigned char[]> m_ProbeOutput;
+            size_t m_ProbeOutputSize = 0;
+            // Percentage of its size the last probe deflated to.
+            uint32_t m_ProbeRatio = 0;
+            // Totals for each method.
+            MethodTotals m_Totals[3] = {};
+    };
+} // namespace FS
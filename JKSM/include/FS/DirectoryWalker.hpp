@@ -0,0 +1,76 @@
+#pragma once
+#include "FS/PathBuilder.hpp"
+#include "fslib.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace FS
+{
+    // Walks a directory tree without recursion. Only one directory listing is open at a time. Subdirectories are queued by path
+    // and listed once the current listing is finished, so the stack doesn't grow with the depth of the tree. If the queue gets
+    // past QueueLimit bytes, the walker stops queuing and goes into subdirectories right away instead. It remembers where it
+    // was in the parent and opens it again later, so the queue only grows by one entry per level from then on. Entries can be
+    // deleted from a listing while it's walked without anything after them being skipped.
+    // Directories are always returned before anything in them. Entry paths are built in one reused buffer, so nothing is
+    // allocated per entry.
+    class DirectoryWalker
+    {
+        public:
+            // Default limit for the queue in bytes.
+            static constexpr size_t DEFAULT_QUEUE_LIMIT = 0x10000;
+
+            // Starts walking Root. Root itself isn't returned.
+            DirectoryWalker(const fslib::Path &Root, size_t QueueLimit = DEFAULT_QUEUE_LIMIT);
+
+            // Moves to the next entry. Returns false once the whole tree has been walked.
+            bool Next();
+
+            // Keeps the walker from going into the current entry if it's a directory. This is for directories that were
+            // skipped or deleted.
+            void SkipCurrent();
+
+            // Returns the current entry.
+            const fslib::DirectoryEntry &GetEntry() const;
+            // Returns the full path to the current entry.
+            const fslib::Path &GetPath();
+            // Returns the current entry's path relative to Root.
+            std::u16string_view GetRelativePath() const;
+            // Returns the full path to the current entry in UTF-8. It's only converted if this is called.
+            const char *GetUTF8();
+
+            // Returns the most memory the queue used in bytes.
+            size_t GetPeakQueueSize() const;
+
+        private:
+            // Directory waiting to be listed. If the listing was left early, ResumeName is the directory the walk went into and
+            // ResumeIndex is the index after it. The walk picks back up after ResumeName wherever it ended up.
+            typedef struct
+            {
+                    std::u16string Path;
+                    std::u16string ResumeName;
+                    uint32_t ResumeIndex;
+            } QueuedDirectory;
+
+            // Listing currently being walked, its path and the index of the next entry.
+            fslib::Directory m_Listing;
+            fslib::Path m_ListingPath;
+            size_t m_ListingLength = 0;
+            uint32_t m_Index       = 0;
+            // Current entry's full path.
+            FS::PathBuilder m_Current;
+            // Whether the current entry is a directory that still needs to be walked.
+            bool m_WalkCurrent = false;
+            // Directories waiting to be listed. The last one is listed first.
+            std::vector<QueuedDirectory> m_Queue;
+            size_t m_QueueSize = 0, m_PeakQueueSize = 0, m_QueueLimit = 0;
+
+            // Adds a directory to the queue.
+            void Push(std::u16string_view Path, std::u16string_view ResumeName, uint32_t ResumeIndex);
+            // Opens Path and starts walking it from Index, or from after ResumeName if it's there.
+            void OpenListing(std::u16string_view Path, std::u16string_view ResumeName, uint32_t Index);
+    };
+} // namespace FS
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace FS
+{
+    // Streaming xxHash64. This is what backup manifests use to tell whether a file changed.
+    class Hash64
+    {
+        public:
+            Hash64(uint64_t Seed = 0);
+
+            // Feeds Length bytes of Data to the hash.
+            void Update(const void *Data, size_t Length);
+
+            // Returns the hash of everything passed to Update so far. This doesn't change the state.
+            uint64_t Finish() const;
+
+            // Hashes Data in one shot.
+            static uint64_t Get(const void *Data, size_t Length, uint64_t Seed = 0);
+
+        private:
+            // Running accumulators.
+            uint64_t m_Accumulators[4];
+            // Seed used.
+            uint64_t m_Seed = 0;
+            // Total bytes hashed.
+            uint64_t m_TotalLength = 0;
+            // Bytes that didn't fill a full 32 byte stripe yet.
+            unsigned char m_Stripe[32];
+            size_t m_StripeLength = 0;
+    };
+} // namespace FS
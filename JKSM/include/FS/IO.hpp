@@ -1,4 +1,9 @@
 #pragma once
+#include "FS/BufferRing.hpp"
+#include "FS/CompressionPolicy.hpp"
+#include "FS/Journal.hpp"
+#include "FS/Manifest.hpp"
+#include "FS/Transaction.hpp"
 #include "System/ProgressTask.hpp"
 #include "fslib.hpp"
 
@@ -7,15 +12,95 @@
 
 namespace FS
 {
-    // This recursively copies Source to Destination. Progress task is so the progress can be shown to the user. Commit is false
-    // by default. This needs to be true for User and System saves.
+    // Number of files in a tree and their combined size.
+    typedef struct
+    {
+            uint32_t FileCount;
+            uint64_t TotalSize;
+    } DirectoryTotals;
+
+    // How copies check what they wrote. Expected is a manifest with the hash every file should have, nullptr if there isn't
+    // one. ReadBack reads every file back after it's written and checks it against what was read.
+    typedef struct
+    {
+            const FS::Manifest *Expected;
+            bool ReadBack;
+    } Verification;
+
+    // Sets how many large files directory copies write at the same time. 1 copies one file at a time. Copies to archives
+    // that need a transaction always copy one file at a time. ZIP backups are deflated on this many threads.
+    void SetCopyWorkerCount(size_t WorkerCount);
+    // Returns how many workers copies and archives actually use. This is the count set above capped at the most supported.
+    size_t GetCopyWorkerCount();
+    // Sets whether directory copies batch small files. It's always on in JKSM. The benchmark turns it off to measure what it
+    // saves.
+    void SetSmallFileBatching(bool Enabled);
+    // Totals the files in Source without opening any of them. Used to show progress for the whole operation. The time it
+    // takes is logged.
+    void GetDirectoryTotals(const fslib::Path &Source, FS::DirectoryTotals &TotalsOut);
+    // This recursively copies Source to Destination. Progress task is so the progress can be shown to the user. Transaction
+    // records the files written so the archive can be committed. This is needed for User and System saves. nullptr if not.
+    // Journal records finished files so the copy can be resumed if it's interrupted. nullptr if that isn't wanted. Stored is
+    // the manifest of the folder backup being restored. Files stored without their zero runs are restored under their own name
+    // with the runs written back. They're skipped if Stored doesn't have their runs. It's needed whether or not anything is
+    // verified and is nullptr if Source isn't a backup. Verify is how written files are checked. nullptr skips checking.
     void CopyDirectoryToDirectory(System::ProgressTask *Task,
                                   const fslib::Path &Source,
                                   const fslib::Path &Destination,
-                                  bool Commit);
+                                  FS::Transaction *Transaction,
+                                  FS::Journal *Journal,
+                                  const FS::Manifest *Stored,
+                                  const FS::Verification *Verify);
+    // This copies Source to the backup folder Destination and records every file in ManifestOut. Files that match Previous
+    // aren't copied and are recorded as references to the backup holding them. Previous can be nullptr for a full backup.
+    // Large files are stored without their blocks of zeros, which are recorded in the manifest as zero runs. Those files
+    // get Manifest::COMPACTED_SUFFIX added to their name. Journal and Verify are the same as above. Only ReadBack applies
+    // since the manifest is being written.
+    void CopyDirectoryToBackup(System::ProgressTask *Task,
+                               const fslib::Path &Source,
+                               const fslib::Path &Destination,
+                               const FS::Manifest *Previous,
+                               std::u16string_view PreviousName,
+                               FS::Manifest &ManifestOut,
+                               FS::Journal *Journal,
+                               const FS::Verification *Verify);
+    // This restores Source to Destination without clearing it first. Files that are already the same aren't written again and
+    // anything in Destination that isn't in Source or listed in Keep is deleted. Keep is the backup's manifest and the zero
+    // runs in it are written back. It can be nullptr. Verify is the same as above.
+    void RestoreDirectoryDifferential(System::ProgressTask *Task,
+                                      const fslib::Path &Source,
+                                      const fslib::Path &Destination,
+                                      FS::Transaction *Transaction,
+                                      const FS::Manifest *Keep,
+                                      const FS::Verification *Verify);
+    // Copies a single file from Source to Destination. Transaction is the same as above. ZeroRuns are the runs Source was
+    // stored without. They're written back as zeros. nullptr copies the file as it is. Returns false if the whole file
+    // couldn't be copied.
+    bool CopyFile(System::ProgressTask *Task,
+                  const fslib::Path &Source,
+                  const fslib::Path &Destination,
+                  FS::Transaction *Transaction,
+                  const std::vector<FS::Manifest::ZeroRun> *ZeroRuns);
     // This recursively copies source to the zipFile passed. This needs to be like this, because 3DS threads don't normally have
-    // enough stack space for minizip to work.
-    void CopyDirectoryToZip(System::ProgressTask *Task, const fslib::Path &Source, zipFile Destination);
-    // This unzips the unzFile passed to Destination
-    void CopyZipToDirectory(System::ProgressTask *Task, unzFile Source, const fslib::Path &Destination, bool Commit);
+    // enough stack space for minizip to work. Entries are deflated in blocks on several threads and are still ordinary
+    // deflated entries any unzip tool can read. Preference is what's favored when each file's compression is picked.
+    // PreviousBackup is an older ZIP of Source that Destination replaces. Files with the same size and CRC as their entry in it
+    // are copied over still compressed instead of being deflated again. It can be nullptr. Returns false if any file couldn't
+    // be added. Destination is incomplete then and shouldn't replace anything.
+    bool CopyDirectoryToZip(System::ProgressTask *Task,
+                            const fslib::Path &Source,
+                            zipFile Destination,
+                            FS::CompressionPreference Preference,
+                            unzFile PreviousBackup);
+    // This unzips the unzFile passed to Destination. Entries are inflated on the calling thread while a job on the I/O pool
+    // writes what's already inflated. Progress is reported against the total of every entry in the central directory.
+    // Transaction is the same as above. Every entry is checked against the CRC stored in the ZIP. Only ReadBack in Verify
+    // applies.
+    void CopyZipToDirectory(System::ProgressTask *Task,
+                            unzFile Source,
+                            const fslib::Path &Destination,
+                            FS::Transaction *Transaction,
+                            const FS::Verification *Verify);
+    // Resets Ring and queues a job on the I/O pool that reads SourceFile into it. The ring is closed once the file is read.
+    void StartReadJob(fslib::File &SourceFile, FS::BufferRing &Ring);
 } // namespace FS
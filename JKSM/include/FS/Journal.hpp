@@ -0,0 +1,67 @@
+#pragma once
+#include "fslib.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace FS
+{
+    // This is a small log on the SD card of what a copy has finished so far. If the copy is interrupted, running the same copy
+    // again skips whatever the journal says is already done and picks large files back up where they stopped.
+    class Journal
+    {
+        public:
+            // Path of the journal JKSM uses. Only one copy runs at a time, so only one journal is needed.
+            static constexpr std::u16string_view DEFAULT_PATH = u"sdmc:/JKSM/Journal.bin";
+
+            // Record of a file that was fully copied.
+            typedef struct
+            {
+                    uint64_t Size;
+                    uint64_t Hash;
+            } CompletedFile;
+
+            Journal(const fslib::Path &JournalPath);
+
+            // Starts journaling a copy of Source to Destination. If the journal on the SD is from the same copy, it's loaded
+            // and true is returned if it recorded anything. If not, it's replaced with a new one.
+            bool Begin(const fslib::Path &Source, const fslib::Path &Destination);
+
+            // Returns the record for RelativePath if it was completed or nullptr if it wasn't.
+            const CompletedFile *FindCompleted(std::u16string_view RelativePath) const;
+
+            // Returns how far RelativePath got before the copy was interrupted. 0 if it wasn't in progress.
+            uint64_t GetResumeOffset(std::u16string_view RelativePath) const;
+
+            // Records RelativePath was fully copied.
+            void FileCompleted(std::u16string_view RelativePath, uint64_t Size, uint64_t Hash);
+
+            // Records Offset bytes of RelativePath have been copied.
+            void FileProgress(std::u16string_view RelativePath, uint64_t Offset);
+
+            // Writes everything recorded since the last flush to the journal. Nothing recorded counts until this is called.
+            void Flush();
+
+            // Deletes the journal. This is called once the copy is done.
+            void Finish();
+
+        private:
+            // Path to the journal.
+            fslib::Path m_JournalPath;
+            // Files completed.
+            std::unordered_map<std::u16string, CompletedFile> m_Completed;
+            // File in progress and how far it got.
+            std::u16string m_PartialPath;
+            uint64_t m_PartialOffset = 0;
+            // Records waiting to be flushed.
+            std::vector<unsigned char> m_Pending;
+
+            // Appends a record to m_Pending.
+            void AddRecord(uint8_t Type, std::u16string_view RelativePath, uint64_t Size, uint64_t Hash);
+            // Loads the records in the journal file.
+            void LoadRecords(const unsigned char *Data, size_t DataSize);
+    };
+} // namespace FS
@@ -0,0 +1,109 @@
+#pragma once
+#include "FS/Transaction.hpp"
+#include "System/ProgressTask.hpp"
+#include "fslib.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace FS
+{
+    // This is the list of files in a folder backup with their sizes and hashes. It's stored in the backup as ._manifest.
+    // Files that didn't change since the previous backup aren't written again. Their entry instead references the backup that
+    // actually holds the data.
+    class Manifest
+    {
+        public:
+            // Name of the file in the backup folder.
+            static constexpr std::u16string_view FILE_NAME = u"._manifest";
+            // Added to the name of files stored without their zero runs. Their data is shifted down wherever a run was left
+            // out, so they're never under the original name. Nothing can mistake them for the real file without the manifest.
+            static constexpr std::u16string_view COMPACTED_SUFFIX = u".jksmz";
+
+            // Run of zeros left out of a file when it was stored. Offset is where it starts in the original file.
+            typedef struct
+            {
+                    uint64_t Offset;
+                    uint64_t Length;
+            } ZeroRun;
+
+            // Single file in the backup. Path is relative to the backup root. Reference is the name of the sibling backup
+            // holding the data. It's empty if the data is in this backup. ZeroRuns are the runs of zeros the stored file
+            // leaves out, in order. The stored file is only the rest of the data back to back.
+            typedef struct
+            {
+                    std::u16string Path;
+                    uint64_t Size;
+                    uint64_t Hash;
+                    std::u16string Reference;
+                    std::vector<ZeroRun> ZeroRuns;
+            } Entry;
+
+            Manifest() = default;
+
+            // Loads the manifest from BackupPath. Returns false if it doesn't exist or is invalid.
+            bool Load(const fslib::Path &BackupPath);
+
+            // Writes the manifest to BackupPath.
+            bool Save(const fslib::Path &BackupPath) const;
+
+            // Adds an entry.
+            void AddEntry(Entry NewEntry);
+
+            // Returns the entry for Path or nullptr if there isn't one.
+            const Entry *FindEntry(std::u16string_view Path) const;
+
+            // Returns all entries.
+            std::vector<Entry> &GetEntries();
+            const std::vector<Entry> &GetEntries() const;
+
+            // The generation increases by one for every backup of a title. It's how the newest backup is found.
+            uint32_t GetGeneration() const;
+            void SetGeneration(uint32_t Generation);
+
+            // Reads only the generation from BackupPath's manifest.
+            static bool ReadGeneration(const fslib::Path &BackupPath, uint32_t &GenerationOut);
+
+        private:
+            // Generation.
+            uint32_t m_Generation = 0;
+            // Entries in the order they were added.
+            std::vector<Entry> m_Entries;
+            // Path -> index in m_Entries.
+            std::unordered_map<std::u16string, size_t> m_EntryMap;
+    };
+
+    // Returns how many bytes of zeros ZeroRuns add up to.
+    uint64_t GetZeroRunTotal(const std::vector<FS::Manifest::ZeroRun> &ZeroRuns);
+
+    // Returns where Entry's data is in the backup holding it, relative to the backup's root. This is Entry's path with
+    // COMPACTED_SUFFIX added if it was stored without zero runs.
+    std::u16string GetStoredPath(const FS::Manifest::Entry &Entry);
+
+    // Returns whether any file in the folder backup at BackupPath was stored without its zero runs. Those can't be restored
+    // without the backup's manifest.
+    bool HasCompactedFiles(const fslib::Path &BackupPath);
+
+    // Finds the backup in TitlePath with the highest generation, skipping Exclude. Returns false if no backup has a manifest.
+    bool LoadLatestManifest(const fslib::Path &TitlePath,
+                            std::u16string_view Exclude,
+                            FS::Manifest &ManifestOut,
+                            std::u16string &NameOut);
+
+    // Copies every referenced file in BackupPath's manifest from the backup holding it to Destination. If Differential is
+    // true, files in Destination whose size and hash already match aren't copied.
+    void RestoreManifestReferences(System::ProgressTask *Task,
+                                   const fslib::Path &TitlePath,
+                                   const fslib::Path &BackupPath,
+                                   const fslib::Path &Destination,
+                                   FS::Transaction *Transaction,
+                                   bool Differential);
+
+    // Copies data any other backup in TitlePath references from BackupName into that backup. This needs to be called before
+    // BackupName is deleted or overwritten. Returns false if any file couldn't be copied. Those are still referenced from
+    // BackupName, so it has to be kept.
+    bool ReleaseManifestReferences(System::ProgressTask *Task, const fslib::Path &TitlePath, std::u16string_view BackupName);
+} // namespace FS
@@ -0,0 +1,52 @@
+#pragma once
+#include "fslib.hpp"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace FS
+{
+    // Builds paths under a root in one buffer that's reused as a tree is walked. Appending and truncating don't allocate once
+    // the buffer has grown to the deepest path, so walks don't allocate a new path for every entry. The UTF-8 version is only
+    // converted when it's asked for.
+    class PathBuilder
+    {
+        public:
+            PathBuilder() = default;
+            // Starts the builder at Root.
+            PathBuilder(const fslib::Path &Root);
+
+            // Starts over at Root. Paths are relative to it from here on.
+            void SetRoot(std::u16string_view Root);
+
+            // Sets the whole path. It has to be under the root for GetRelativePath to make sense.
+            void Assign(std::u16string_view Path);
+            // Appends Name with a slash in front of it.
+            void Append(std::u16string_view Name);
+            // Cuts the path back to Length characters.
+            void Truncate(size_t Length);
+            // Sets the path to the root plus RelativePath.
+            void SetRelative(std::u16string_view RelativePath);
+
+            // Returns the length of the path.
+            size_t GetLength() const;
+            // Returns the full path.
+            const fslib::Path &GetPath();
+            // Returns the path relative to the root.
+            std::u16string_view GetRelativePath() const;
+            // Returns the full path in UTF-8.
+            const char *GetUTF8();
+
+        private:
+            // Path being built and the root's length including the slash after it.
+            std::u16string m_Buffer;
+            size_t m_RootLength = 0;
+            // Path handed out by GetPath. It's only updated when the buffer changed.
+            fslib::Path m_Path;
+            bool m_PathCurrent = false;
+            // UTF-8 version of the path. Same as above.
+            char m_UTF8[fslib::MAX_PATH] = {0};
+            bool m_UTF8Current = false;
+    };
+} // namespace FS
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+namespace FS
+{
+    // This batches commits to a save archive. Instead of committing after every file, writes are recorded and the archive is
+    // committed once at the end, or every CommitInterval bytes for very large restores.
+    class Transaction
+    {
+        public:
+            // Device is the archive to commit. CommitInterval is in bytes. 0 means only commit when Finish is called.
+            Transaction(std::u16string_view Device, uint64_t CommitInterval = 0);
+
+            // Records Size bytes were written to a file that was just closed. Commits if the interval has been passed. Returns
+            // true if it did.
+            bool FileWritten(uint64_t Size);
+
+            // Commits anything left and logs how many commits were made and how long they took. Returns false if any failed.
+            bool Finish();
+
+            // Returns the number of commits made so far.
+            uint32_t GetCommitCount() const;
+
+            // Returns the total time spent committing in microseconds.
+            uint64_t GetCommitTime() const;
+
+        private:
+            // Device being committed.
+            std::u16string_view m_Device;
+            // Bytes between commits.
+            uint64_t m_CommitInterval = 0;
+            // Bytes written since the last commit.
+            uint64_t m_PendingBytes = 0;
+            // Whether anything was written since the last commit.
+            bool m_HasPendingWrites = false;
+            // Whether or not a commit failed.
+            bool m_CommitFailed = false;
+            // Stats.
+            uint32_t m_CommitCount = 0;
+            uint64_t m_CommitTime  = 0;
+
+            // Commits the device and times it.
+            void Commit();
+    };
+} // namespace FS
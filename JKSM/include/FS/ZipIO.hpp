@@ -0,0 +1,18 @@
+#pragma once
+#include "fslib.hpp"
+
+#include <minizip/unzip.h>
+#include <minizip/zip.h>
+
+namespace FS
+{
+    // Opens ZIP archives through fslib instead of minizip's stdio functions. Archives are read and written where they are, so
+    // nothing has to be moved around first and more than one can be open at once. Writes are gathered into one large buffer
+    // before they reach the SD card, since minizip writes headers and deflate output in small pieces.
+
+    // Creates a new archive at ZipPath, replacing anything already there. Returns nullptr on failure. Close it with zipClose.
+    zipFile OpenZipForWriting(const fslib::Path &ZipPath);
+
+    // Opens the archive at ZipPath for reading. Returns nullptr on failure. Close it with unzClose.
+    unzFile OpenZipForReading(const fslib::Path &ZipPath);
+} // namespace FS
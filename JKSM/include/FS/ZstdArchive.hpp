@@ -0,0 +1,125 @@
+#pragma once
+#include "FS/BufferRing.hpp"
+#include "FS/Transaction.hpp"
+#include "System/ProgressTask.hpp"
+#include "System/ThreadPool.hpp"
+#include "fslib.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <zstd.h>
+
+namespace FS
+{
+    // JKSM's own backup archive. Every file is joined into one stream that's cut into frames of FRAME_SIZE bytes, and each
+    // frame is compressed on its own by a pool of workers. Small files share frames, so the ratio is better than ZIP's one
+    // stream per file. An index at the end lists every entry with where it starts in the stream, its size and its hash, and
+    // every frame with where it is in the archive. Since frames don't depend on each other, any entry can be read by
+    // decompressing only the frames it's in.
+    class ZstdArchive
+    {
+        public:
+            // Extension archives use.
+            static constexpr std::u16string_view EXTENSION = u"jksm";
+            // Size of every frame but the last.
+            static constexpr size_t FRAME_SIZE = 0x40000;
+            // Level frames are compressed at.
+            static constexpr int COMPRESSION_LEVEL = 3;
+
+            // Single file or directory in an archive. Path is relative to the backup root. Offset is where the file starts in
+            // the stream.
+            typedef struct
+            {
+                    bool IsDirectory;
+                    uint64_t Offset;
+                    uint64_t Size;
+                    uint64_t Hash;
+                    std::u16string Path;
+            } IndexEntry;
+
+            // Where one frame is in the archive and how much of the stream it holds.
+            typedef struct
+            {
+                    uint64_t Offset;
+                    uint32_t CompressedSize;
+                    uint32_t Size;
+            } FrameEntry;
+
+            // Frames are compressed on WorkerCount workers. Nothing is started until a backup needs it.
+            ZstdArchive(size_t WorkerCount);
+            ~ZstdArchive();
+
+            // Compresses everything in Source into a new archive at ArchivePath.
+            bool Backup(System::ProgressTask *Task, const fslib::Path &Source, const fslib::Path &ArchivePath);
+
+            // Decompresses the archive at ArchivePath into Destination. Frames are streamed straight into the files and every
+            // file is checked against the hash in the index. Transaction is the same as regular copies.
+            bool Restore(System::ProgressTask *Task,
+                         const fslib::Path &ArchivePath,
+                         const fslib::Path &Destination,
+                         FS::Transaction *Transaction);
+
+            // Reads and checks only the index of the archive at ArchivePath. Nothing is decompressed.
+            static bool ReadIndex(const fslib::Path &ArchivePath,
+                                  std::vector<IndexEntry> &EntriesOut,
+                                  std::vector<FrameEntry> &FramesOut);
+
+        private:
+            // One frame being filled, compressed or waiting to be written.
+            typedef struct
+            {
+                    std::unique_ptr<unsigned char[]> Input;
+                    size_t InputSize;
+                    std::unique_ptr<unsigned char[]> Output;
+                    size_t OutputSize;
+                    ZSTD_CCtx *Context;
+                    // Set by the worker once Output is ready.
+                    bool Done;
+                    bool Failed;
+            } FrameSlot;
+
+            size_t m_WorkerCount = 1;
+            // Frame slots are used as a ring the same way BlockDeflater's blocks are. They're only allocated for backups.
+            std::vector<std::unique_ptr<FrameSlot>> m_Slots;
+            size_t m_Filling = 0;
+            size_t m_Oldest  = 0;
+            size_t m_Pending = 0;
+            // Archive being written, how far into it frames have been written and the frames written so far.
+            fslib::File m_Archive;
+            uint64_t m_ArchiveOffset = 0;
+            std::vector<FrameEntry> m_Frames;
+            bool m_Failed = false;
+            // Source files are read into this during backups and frames are read into it during restores.
+            FS::BufferRing m_Ring;
+            // Guards Done and Failed in every slot.
+            std::mutex m_SlotLock;
+            std::condition_variable m_SlotDone;
+            // Workers. This is last so it's joined before the slots are freed.
+            std::unique_ptr<System::ThreadPool> m_Workers;
+
+            // Adds every file in Source to the stream and appends their entries to EntriesOut. StreamOffset is where the next
+            // file starts.
+            void BackupDirectory(System::ProgressTask *Task,
+                                 const fslib::Path &Source,
+                                 std::vector<IndexEntry> &EntriesOut,
+                                 uint64_t &StreamOffset);
+            // Adds a single file to the stream. Returns false if nothing was added. Failing partway fails the whole archive.
+            bool BackupFile(System::ProgressTask *Task, const fslib::Path &Source, IndexEntry &EntryOut);
+            // Adds Size bytes of Data to the stream.
+            void AddToStream(const unsigned char *Data, size_t Size);
+            // Hands the slot being filled to the workers and moves on to the next one.
+            void SubmitFrame();
+            // Waits for the oldest slot and writes its frame.
+            void WriteOldestFrame();
+            // Run by the workers.
+            void CompressFrame(FrameSlot *Target);
+            // Allocates the frame slots and starts the workers.
+            bool Prepare();
+    };
+} // namespace FS
@@ -20,6 +20,8 @@ namespace Strings
         static constexpr std::string_view FolderMenuNew            = "FolderMenuNew";
         static constexpr std::string_view BackupMenuCurrentBackups = "BackupMenuCurrentBackups";
         static constexpr std::string_view CopyingFile              = "CopyingFile";
+        static constexpr std::string_view CopyingSmallFiles        = "CopyingSmallFiles";
+        static constexpr std::string_view ProgressRate             = "ProgressRate";
         static constexpr std::string_view AddingToZip              = "AddingToZip";
         static constexpr std::string_view DeletingBackup           = "DeletingBackup";
         static constexpr std::string_view KeyboardButtons          = "KeyboardButtons";
@@ -27,6 +29,7 @@ namespace Strings
         static constexpr std::string_view HoldingText              = "HoldingText";
         static constexpr std::string_view OK                       = "OK";
         static constexpr std::string_view BackupMenuConfirmations  = "BackupMenuConfirmations";
+        static constexpr std::string_view BackupContents           = "BackupContents";
         static constexpr std::string_view TitleOptions             = "TitleOptions";
         static constexpr std::string_view TitleOptionConfirmations = "TitleOptionConfirmations";
         static constexpr std::string_view TitleOptionTaskStatus    = "TitleOptionTaskStatus";
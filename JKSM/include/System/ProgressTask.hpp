@@ -1,11 +1,30 @@
 #pragma once
 #include "System/Task.hpp"
 
+#include <algorithm>
+#include <chrono>
+
 namespace System
 {
+    // The values ProgressTask tracks. They're in a base listed before Task so they're initialized before Task starts the
+    // thread. As ProgressTask's own members they'd be initialized after and could overwrite what the thread already set.
+    class ProgressValues
+    {
+        protected:
+            // The Current/Goal value.
+            double m_Current = 0.0f;
+            // The maximum/goal value
+            double m_Goal = 0.0f;
+            // Total of the whole operation and how much of it was finished before the current Reset. Total is 0 if unknown.
+            double m_OperationTotal = 0.0f;
+            double m_OperationDone  = 0.0f;
+            // When the operation total was set.
+            std::chrono::steady_clock::time_point m_OperationStart;
+    };
+
     // This is basically a task with a few extra functions to allow tracking the progress of a task.
     // Functions that use this should use the same signature as task, except taking System::ProgressTask instead of Task.
-    class ProgressTask : public System::Task
+    class ProgressTask : private ProgressValues, public System::Task
     {
         public:
             template <typename... Args>
@@ -15,9 +34,11 @@ namespace System
             }
             ~ProgressTask() {};
 
-            // This is so I don't have to type so much. Sets current to 0 and sets goal to whatever is passed.
+            // This is so I don't have to type so much. Sets current to 0 and sets goal to whatever is passed. If there's an
+            // operation total, whatever was done before is kept so the bar doesn't start over.
             void Reset(double Goal)
             {
+                m_OperationDone += m_Current;
                 m_Current = 0;
                 m_Goal    = Goal;
             }
@@ -26,12 +47,39 @@ namespace System
 
             void SetCurrent(double Current) { m_Current = Current; }
 
-            double GetProgress() const { return (m_Current / m_Goal); }
+            // Sets the total of the whole operation. Progress, the rate and time left are all reported against it after this.
+            void SetOperationTotal(double Total)
+            {
+                m_OperationTotal = Total;
+                m_OperationDone  = 0;
+                m_Current        = 0;
+                m_OperationStart = std::chrono::steady_clock::now();
+            }
 
-        private:
-            // The Current/Goal value.
-            double m_Current = 0.0f;
-            // The maximum/goal value
-            double m_Goal = 0.0f;
+            // Counts Amount as done without it going through Reset and SetCurrent. This is for files that are skipped.
+            void Skip(double Amount) { m_OperationDone += Amount; }
+
+            bool HasOperationTotal() const { return m_OperationTotal > 0; }
+
+            double GetProgress() const
+            {
+                if (m_OperationTotal > 0) { return std::min((m_OperationDone + m_Current) / m_OperationTotal, 1.0); }
+                return (m_Current / m_Goal);
+            }
+
+            // Returns how much of the operation is done per second.
+            double GetRate() const
+            {
+                double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_OperationStart).count();
+                return Seconds > 0 ? (m_OperationDone + m_Current) / Seconds : 0;
+            }
+
+            // Returns the seconds left at the current rate. -1 if it can't be known yet.
+            double GetSecondsRemaining() const
+            {
+                double Rate = ProgressTask::GetRate();
+                if (m_OperationTotal <= 0 || Rate <= 0) { return -1; }
+                return std::max(m_OperationTotal - (m_OperationDone + m_Current), 0.0) / Rate;
+            }
     };
 } // namespace System
@@ -1,7 +1,7 @@
 #pragma once
+#include "System/TaskStatus.hpp"
 #include "logging/logger.hpp"
 
-#include <cstdarg>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -44,24 +44,14 @@ namespace System
                 m_Finished = true;
             }
 
-            // Returns status string.
-            std::string GetStatus()
-            {
-                std::scoped_lock<std::mutex> ThreadLock(m_ThreadLock);
-                return m_ThreadStatus;
-            }
+            // Returns status string. It's only formatted here, so this should only be called from the UI thread.
+            const char *GetStatus() { return m_ThreadStatus.Get(); }
 
-            // Allows thread to set status string.
-            void SetStatus(const char *Format, ...)
+            // Allows thread to set status string. Format and up to one argument are stored and formatted later by GetStatus.
+            template <typename... Args>
+            void SetStatus(const char *Format, Args... Arguments)
             {
-                char VaBuffer[0x1000];
-                std::va_list VaList;
-                va_start(VaList, Format);
-                vsnprintf(VaBuffer, 0x1000, Format, VaList);
-                va_end(VaList);
-
-                std::scoped_lock<std::mutex> ThreadLock(m_ThreadLock);
-                m_ThreadStatus = VaBuffer;
+                m_ThreadStatus.Set(Format, Arguments...);
             }
 
         private:
@@ -71,7 +61,7 @@ namespace System
             std::mutex m_ThreadLock;
             // Whether task is still running.
             bool m_Finished = false;
-            // String that shows thread's status.
-            std::string m_ThreadStatus;
+            // Thread's status.
+            System::TaskStatus m_ThreadStatus;
     };
 }; // namespace System
@@ -0,0 +1,225 @@
+#pragma once
+#include <3ds.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+namespace System
+{
+    // Status string a task's threads publish for the UI. A thread claims a free slot, stores the format and its argument in it
+    // and hands it over with one atomic exchange. Nothing is formatted on its side and nobody waits on anybody. The UI formats
+    // the newest slot when it asks for the status, so that happens at most once a frame and only when it changed. Every slot
+    // is either free, being written by one thread, the newest one published or the one the UI formatted last. UTF-16 strings
+    // are stored as they are and only converted to UTF-8 there too, so statuses that are never shown are never converted.
+    class TaskStatus
+    {
+        public:
+            // Most characters of a string argument that are kept. Anything past this is cut off.
+            static constexpr size_t MAX_TEXT_LENGTH = 0x300;
+            // Size of the formatted status.
+            static constexpr size_t STATUS_BUFFER_SIZE = 0x400;
+
+            // Publishes Format with up to one argument. Format has to stay valid until it's replaced. The string table's
+            // strings always are. Threads can publish at the same time. Whichever publishes last is what's shown.
+            template <typename... Args>
+            void Set(const char *Format, Args... Arguments)
+            {
+                static_assert(sizeof...(Args) <= 1, "Task status only takes one argument.");
+
+                uint8_t Back    = TaskStatus::ClaimSlot();
+                Slot &BackSlot  = m_Slots[Back];
+                BackSlot.Format = Format;
+                BackSlot.Type   = ArgumentType::None;
+                (TaskStatus::StoreArgument(BackSlot, Arguments), ...);
+
+                // Whatever was newest before is replaced and free again.
+                uint8_t Replaced = m_Newest.exchange(Back | NEW_STATUS, std::memory_order_acq_rel) & SLOT_MASK;
+                m_FreeSlots.fetch_or(static_cast<uint8_t>(1u << Replaced), std::memory_order_release);
+            }
+
+            // Returns the newest status. Only the UI thread should call this.
+            const char *Get()
+            {
+                if (m_Newest.load(std::memory_order_relaxed) & NEW_STATUS)
+                {
+                    m_Front = m_Newest.exchange(m_Front, std::memory_order_acq_rel) & SLOT_MASK;
+                    TaskStatus::Format(m_Slots[m_Front]);
+                }
+                return m_Status;
+            }
+
+        private:
+            // Number of slots. This is enough for six threads to be writing at once. JKSM never has more than the task's
+            // thread and its copy workers publishing.
+            static constexpr uint8_t SLOT_COUNT = 8;
+            // Bit set in m_Newest when the slot in it hasn't been formatted yet.
+            static constexpr uint8_t NEW_STATUS = 0x8;
+            static constexpr uint8_t SLOT_MASK  = 0x7;
+
+            // What the argument is so it can be passed to snprintf as the right type.
+            enum class ArgumentType : uint8_t
+            {
+                None,
+                Text,
+                WideText,
+                Integer32,
+                Integer64,
+                Decimal
+            };
+
+            typedef struct
+            {
+                    const char *Format;
+                    ArgumentType Type;
+                    union
+                    {
+                            uint32_t Integer32;
+                            uint64_t Integer64;
+                            double Decimal;
+                    };
+                    // Strings are copied since they're usually on the thread's stack.
+                    union
+                    {
+                            char Text[MAX_TEXT_LENGTH + 1];
+                            char16_t WideText[MAX_TEXT_LENGTH + 1];
+                    };
+            } Slot;
+
+            Slot m_Slots[SLOT_COUNT] = {};
+            // One bit for every slot nobody is using. Writers claim them from here.
+            std::atomic<uint8_t> m_FreeSlots = 0xFC;
+            // Newest slot published.
+            std::atomic<uint8_t> m_Newest = 1;
+            // Slot the UI formatted last.
+            uint8_t m_Front = 0;
+            // Formatted status.
+            char m_Status[STATUS_BUFFER_SIZE] = {0};
+            // UTF-8 version of a UTF-16 argument. Only the UI thread uses this.
+            char m_ConvertedText[MAX_TEXT_LENGTH + 1] = {0};
+
+            // Takes a free slot for the calling thread. There's always one unless more threads are writing than there are
+            // slots for. Then this waits for one of them to publish.
+            uint8_t ClaimSlot()
+            {
+                uint8_t FreeSlots = m_FreeSlots.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    if (FreeSlots == 0)
+                    {
+                        std::this_thread::yield();
+                        FreeSlots = m_FreeSlots.load(std::memory_order_relaxed);
+                        continue;
+                    }
+
+                    uint8_t Claimed = static_cast<uint8_t>(__builtin_ctz(FreeSlots));
+                    if (m_FreeSlots.compare_exchange_weak(FreeSlots,
+                                                          static_cast<uint8_t>(FreeSlots & ~(1u << Claimed)),
+                                                          std::memory_order_acquire,
+                                                          std::memory_order_relaxed))
+                    {
+                        return Claimed;
+                    }
+                }
+            }
+
+            template <typename Type>
+            static void StoreArgument(Slot &Target, Type Argument)
+            {
+                if constexpr (std::is_convertible_v<Type, const char16_t *>)
+                {
+                    const char16_t *Text = Argument ? Argument : u"";
+                    size_t Length        = std::char_traits<char16_t>::length(Text);
+                    Length               = Length < MAX_TEXT_LENGTH ? Length : MAX_TEXT_LENGTH;
+                    std::memcpy(Target.WideText, Text, Length * sizeof(char16_t));
+                    Target.WideText[Length] = u'\0';
+                    Target.Type             = ArgumentType::WideText;
+                }
+                else if constexpr (std::is_convertible_v<Type, const char *>)
+                {
+                    const char *Text = Argument ? Argument : "";
+                    size_t Length    = strnlen(Text, MAX_TEXT_LENGTH);
+                    std::memcpy(Target.Text, Text, Length);
+                    Target.Text[Length] = '\0';
+                    Target.Type         = ArgumentType::Text;
+                }
+                else if constexpr (std::is_floating_point_v<Type>)
+                {
+                    Target.Decimal = Argument;
+                    Target.Type    = ArgumentType::Decimal;
+                }
+                else
+                {
+                    static_assert(std::is_integral_v<Type> || std::is_enum_v<Type>, "Unsupported task status argument.");
+                    if constexpr (sizeof(Type) > sizeof(uint32_t))
+                    {
+                        Target.Integer64 = static_cast<uint64_t>(Argument);
+                        Target.Type      = ArgumentType::Integer64;
+                    }
+                    else
+                    {
+                        Target.Integer32 = static_cast<uint32_t>(Argument);
+                        Target.Type      = ArgumentType::Integer32;
+                    }
+                }
+            }
+
+            void Format(const Slot &Source)
+            {
+                if (!Source.Format)
+                {
+                    m_Status[0] = '\0';
+                    return;
+                }
+
+                switch (Source.Type)
+                {
+                    case ArgumentType::None:
+                    {
+                        // Without an argument, Format is shown as it is.
+                        snprintf(m_Status, STATUS_BUFFER_SIZE, "%s", Source.Format);
+                    }
+                    break;
+
+                    case ArgumentType::Text:
+                    {
+                        snprintf(m_Status, STATUS_BUFFER_SIZE, Source.Format, Source.Text);
+                    }
+                    break;
+
+                    case ArgumentType::WideText:
+                    {
+                        // The conversion doesn't terminate the string itself.
+                        ssize_t Length = utf16_to_utf8(reinterpret_cast<uint8_t *>(m_ConvertedText),
+                                                       reinterpret_cast<const uint16_t *>(Source.WideText),
+                                                       MAX_TEXT_LENGTH);
+                        m_ConvertedText[Length < 0 ? 0 : std::min<size_t>(Length, MAX_TEXT_LENGTH)] = '\0';
+                        snprintf(m_Status, STATUS_BUFFER_SIZE, Source.Format, m_ConvertedText);
+                    }
+                    break;
+
+                    case ArgumentType::Integer32:
+                    {
+                        snprintf(m_Status, STATUS_BUFFER_SIZE, Source.Format, Source.Integer32);
+                    }
+                    break;
+
+                    case ArgumentType::Integer64:
+                    {
+                        snprintf(m_Status, STATUS_BUFFER_SIZE, Source.Format, Source.Integer64);
+                    }
+                    break;
+
+                    case ArgumentType::Decimal:
+                    {
+                        snprintf(m_Status, STATUS_BUFFER_SIZE, Source.Format, Source.Decimal);
+                    }
+                    break;
+                }
+            }
+    };
+} // namespace System
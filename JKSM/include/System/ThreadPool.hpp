@@ -0,0 +1,77 @@
+#pragma once
+#include <3ds.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace System
+{
+    // This is a set of long-lived worker threads jobs are sent to instead of spawning a new thread every time. Jobs run in the
+    // order they were submitted.
+    class ThreadPool
+    {
+        public:
+            // Queue statistics. Times are in microseconds.
+            typedef struct
+            {
+                    uint64_t JobCount      = 0;
+                    uint64_t TotalWaitTime = 0;
+                    uint64_t MaxWaitTime   = 0;
+            } Statistics;
+
+            // Starts WorkerCount threads on CPUCore at the priority of the thread creating the pool. -2 is the app's default
+            // core.
+            ThreadPool(size_t WorkerCount, int CPUCore = -2);
+            // Runs whatever is still queued and joins the workers.
+            ~ThreadPool();
+
+            // Queues Job to be run by the first free worker.
+            void Submit(std::function<void()> Job);
+
+            // Returns the number of worker threads.
+            size_t GetWorkerCount() const;
+
+            // Returns how many jobs have run and how long they sat in the queue before a worker picked them up since the last
+            // ResetStatistics.
+            Statistics GetStatistics();
+
+            // Starts the statistics over so they only cover what's submitted after this.
+            void ResetStatistics();
+
+        private:
+            // Job and the time it was queued.
+            typedef struct
+            {
+                    std::function<void()> Job;
+                    std::chrono::steady_clock::time_point QueuedAt;
+            } QueuedJob;
+
+            // Workers.
+            std::vector<Thread> m_Workers;
+            // Jobs waiting for a worker.
+            std::deque<QueuedJob> m_Queue;
+            // Guards the queue, statistics and exit flag.
+            std::mutex m_QueueLock;
+            std::condition_variable m_QueueCondition;
+            // Signals workers to exit once the queue is empty.
+            bool m_Exiting = false;
+            // Queue statistics.
+            Statistics m_Statistics;
+
+            // Function workers run.
+            void WorkerFunction();
+            // Entry point passed to threadCreate. Pool is the ThreadPool the worker belongs to.
+            static void WorkerEntry(void *Pool);
+    };
+
+    // Returns the core pools that run alongside the UI should start their workers on. This is the New 3DS's extra core if there
+    // is one so they don't compete with the UI. Otherwise, it's the app's default core.
+    int GetWorkerCore();
+
+    // Returns the pool JKSM's file I/O jobs are run on. It's created the first time it's needed.
+    System::ThreadPool &GetIOPool();
+} // namespace System
@@ -0,0 +1,42 @@
+#pragma once
+#include "FS/BackupListing.hpp"
+#include "UI/Menu.hpp"
+#include "appstates/BaseState.hpp"
+
+#include <memory>
+#include <string>
+
+class BackupInspectState final : public BaseState
+{
+    public:
+        /// @brief Creates a new state listing what's in a backup.
+        BackupInspectState(BaseState *creatingState, std::shared_ptr<const FS::BackupListing> listing);
+
+        /// @brief Required destructor.
+        ~BackupInspectState() {};
+
+        /// @brief Update override.
+        void update() override;
+
+        /// @brief Draw top override.
+        void draw_top(SDL_Surface *target) override;
+
+        /// @brief Draw bottom override.
+        void draw_bottom(SDL_Surface *target) override;
+
+    private:
+        /// @brief Pointer to the spawning state so I can draw the top.
+        BaseState *m_creatingState{};
+
+        /// @brief Listing being shown. This keeps it alive even if it's dropped from the cache.
+        std::shared_ptr<const FS::BackupListing> m_listing{};
+
+        /// @brief Menu of the files in the backup.
+        UI::Menu m_entryMenu;
+
+        /// @brief File count and sizes shown in the header.
+        std::string m_header{};
+
+        /// @brief Centered coordinate for the header text.
+        int m_textX{};
+};
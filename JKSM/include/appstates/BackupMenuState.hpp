@@ -7,6 +7,7 @@
 
 #include <memory>
 #include <mutex>
+#include <vector>
 
 class BackupMenuState final : public BaseState
 {
@@ -48,6 +49,9 @@ class BackupMenuState final : public BaseState
         /// @brief Listing of the target directory.
         fslib::Directory m_directoryListing{};
 
+        /// @brief Indexes of the entries in m_directoryListing shown in the menu.
+        std::vector<uint32_t> m_backupIndexes{};
+
         /// @brief Centered coordinate for the header text.
         int m_textX{};
 
@@ -46,4 +46,7 @@ class ProgressTaskState : public BaseState
 
         /// @brief Centered X coord to render the percentage to.
         int m_percentageX{};
+
+        /// @brief Throughput and time left. Empty if the task doesn't know the total of the whole operation.
+        std::string m_rateString;
 };
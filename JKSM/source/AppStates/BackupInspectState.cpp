@@ -0,0 +1,49 @@
+#include "appstates/BackupInspectState.hpp"
+
+#include "SDL/SDL.hpp"
+#include "StringUtil.hpp"
+#include "Strings.hpp"
+#include "input.hpp"
+
+// Returns Size in the largest unit it fills.
+static std::string GetSizeString(uint64_t Size)
+{
+    if (Size >= 0x100000) { return StringUtil::GetFormattedString("%.2f MB", static_cast<double>(Size) / 0x100000); }
+    else if (Size >= 0x400) { return StringUtil::GetFormattedString("%.2f KB", static_cast<double>(Size) / 0x400); }
+    return StringUtil::GetFormattedString("%llu B", Size);
+}
+
+// This is semi-locked for the same reason the backup menu is.
+BackupInspectState::BackupInspectState(BaseState *creatingState, std::shared_ptr<const FS::BackupListing> listing)
+    : BaseState(BaseState::StateFlags::SemiLock)
+    , m_creatingState(creatingState)
+    , m_listing(listing)
+    , m_entryMenu(4, 20, 312, 12)
+{
+    for (const FS::BackupListingEntry &Entry : m_listing->Entries)
+    {
+        m_entryMenu.AddOption(StringUtil::GetFormattedString("%s (%s)", Entry.Path.c_str(), GetSizeString(Entry.Size).c_str()));
+    }
+
+    m_header = StringUtil::GetFormattedString(Strings::GetStringByName(Strings::Names::BackupContents, 0),
+                                              m_listing->Entries.size(),
+                                              GetSizeString(m_listing->TotalSize).c_str(),
+                                              GetSizeString(m_listing->StoredSize).c_str());
+    m_textX  = 160 - (m_noto->GetTextWidth(12, m_header.c_str()) / 2);
+}
+
+void BackupInspectState::update()
+{
+    m_entryMenu.Update();
+
+    if (input::button_pressed(KEY_B)) { BaseState::deactivate(); }
+}
+
+void BackupInspectState::draw_top(SDL_Surface *target) { m_creatingState->draw_top(target); }
+
+void BackupInspectState::draw_bottom(SDL_Surface *target)
+{
+    SDL::DrawRect(target, 0, 0, 320, 16, SDL::Colors::BarColor);
+    m_noto->BlitTextAt(target, m_textX, 1, 12, m_noto->NO_TEXT_WRAP, m_header.c_str());
+    m_entryMenu.Draw(target);
+}
@@ -2,9 +2,13 @@
 
 #include "Config.hpp"
 #include "Data/Data.hpp"
+#include "FS/BackupListing.hpp"
+#include "FS/ChunkStore.hpp"
 #include "FS/FS.hpp"
 #include "FS/IO.hpp"
 #include "FS/SaveMount.hpp"
+#include "FS/ZipIO.hpp"
+#include "FS/ZstdArchive.hpp"
 #include "JKSM.hpp"
 #include "Keyboard.hpp"
 #include "SDL/SDL.hpp"
@@ -12,13 +16,20 @@
 #include "Strings.hpp"
 #include "System/ProgressTask.hpp"
 #include "System/Task.hpp"
+#include "appstates/BackupInspectState.hpp"
 #include "appstates/ConfirmState.hpp"
+#include "appstates/MessageState.hpp"
 #include "appstates/ProgressTaskState.hpp"
 #include "appstates/TaskState.hpp"
 #include "input.hpp"
 
 #include <string_view>
 
+// Name the secure value is saved under. Trying to make sure no game would possibly use this...
+static constexpr std::u16string_view SECURE_VALUE_NAME = u"._secure_value";
+// Same name for the entry in ZIPs.
+static constexpr const char *SECURE_VALUE_ENTRY = "._secure_value";
+
 // Struct used for confirming actions. This is a general struct and not everything is used by every action/function
 // clang-format off
 typedef struct
@@ -38,6 +49,8 @@ static void CreateNewBackup(System::ProgressTask *task,
 static void OverwriteBackup(System::ProgressTask *task, std::shared_ptr<TargetStruct> dataStruct);
 static void RestoreBackup(System::ProgressTask *task, std::shared_ptr<TargetStruct> dataStruct);
 static void DeleteBackup(System::Task *task, std::shared_ptr<TargetStruct> dataStruct);
+static void BackupToFolder(System::ProgressTask *task, const fslib::Path &backupPath);
+static void SetOperationTotal(System::ProgressTask *task, const fslib::Path &source, uint64_t extraSize);
 
 // We're going to mark this as a task even though it isn't so JKSM doesn't let users shift from it.
 BackupMenuState::BackupMenuState(BaseState *creatingState, const Data::TitleData *data, Data::SaveDataType saveType)
@@ -110,12 +123,14 @@ void BackupMenuState::update()
     else if (input::button_pressed(KEY_A) && m_backupMenu.GetSelected() > 0)
     {
         // Confirm struct
+        uint32_t Selected = m_backupIndexes[m_backupMenu.GetSelected() - 1];
         std::shared_ptr<TargetStruct> DataStruct(new TargetStruct);
-        DataStruct->TargetPath = m_directoryPath / m_directoryListing[m_backupMenu.GetSelected() - 1];
+        DataStruct->TargetPath  = m_directoryPath / m_directoryListing[Selected];
+        DataStruct->TargetTitle = m_data;
 
         // Query string
         char TargetName[fslib::MAX_PATH] = {0};
-        StringUtil::ToUTF8(m_directoryListing[m_backupMenu.GetSelected() - 1].get_filename(), TargetName, fslib::MAX_PATH);
+        StringUtil::ToUTF8(m_directoryListing[Selected].get_filename(), TargetName, fslib::MAX_PATH);
         std::string ConfirmOverwrite =
             StringUtil::GetFormattedString(Strings::GetStringByName(Strings::Names::BackupMenuConfirmations, 0), TargetName);
 
@@ -129,14 +144,15 @@ void BackupMenuState::update()
     else if (input::button_pressed(KEY_Y) && m_backupMenu.GetSelected() > 0)
     {
         // Create confirmation struct.
+        uint32_t Selected = m_backupIndexes[m_backupMenu.GetSelected() - 1];
         std::shared_ptr<TargetStruct> ConfirmStruct(new TargetStruct);
-        ConfirmStruct->TargetPath  = m_directoryPath / m_directoryListing[m_backupMenu.GetSelected() - 1];
+        ConfirmStruct->TargetPath  = m_directoryPath / m_directoryListing[Selected];
         ConfirmStruct->SaveType    = m_saveType;
         ConfirmStruct->TargetTitle = m_data;
 
         // Query string
         char TargetName[fslib::MAX_PATH] = {0};
-        StringUtil::ToUTF8(m_directoryListing[m_backupMenu.GetSelected() - 1].get_filename(), TargetName, fslib::MAX_PATH);
+        StringUtil::ToUTF8(m_directoryListing[Selected].get_filename(), TargetName, fslib::MAX_PATH);
         std::string RestoreString =
             StringUtil::GetFormattedString(Strings::GetStringByName(Strings::Names::BackupMenuConfirmations, 1), TargetName);
 
@@ -151,13 +167,14 @@ void BackupMenuState::update()
     else if (input::button_pressed(KEY_X) && m_backupMenu.GetSelected() > 0)
     {
         // Confirm struct
+        uint32_t Selected = m_backupIndexes[m_backupMenu.GetSelected() - 1];
         std::shared_ptr<TargetStruct> ConfirmStruct(new TargetStruct);
-        ConfirmStruct->TargetPath   = m_directoryPath / m_directoryListing[m_backupMenu.GetSelected() - 1];
+        ConfirmStruct->TargetPath   = m_directoryPath / m_directoryListing[Selected];
         ConfirmStruct->CallingState = this;
 
         // String
         char TargetName[fslib::MAX_PATH] = {0};
-        StringUtil::ToUTF8(m_directoryListing[m_backupMenu.GetSelected() - 1].get_filename(), TargetName, fslib::MAX_PATH);
+        StringUtil::ToUTF8(m_directoryListing[Selected].get_filename(), TargetName, fslib::MAX_PATH);
         std::string DeleteString =
             StringUtil::GetFormattedString(Strings::GetStringByName(Strings::Names::BackupMenuConfirmations, 2), TargetName);
 
@@ -168,6 +185,29 @@ void BackupMenuState::update()
                                                                                   DeleteBackup,
                                                                                   ConfirmStruct));
     }
+    else if (input::button_pressed(KEY_SELECT) && m_backupMenu.GetSelected() > 0)
+    {
+        // Only the central directory or index is read, so this is quick enough to do here.
+        uint32_t Selected      = m_backupIndexes[m_backupMenu.GetSelected() - 1];
+        fslib::Path TargetPath = m_directoryPath / m_directoryListing[Selected];
+        if (TargetPath.get_extension() != u"zip" && TargetPath.get_extension() != FS::ZstdArchive::EXTENSION)
+        {
+            MessageState::create_and_push(this, Strings::GetStringByName(Strings::Names::BackupContents, 1));
+            return;
+        }
+
+        std::shared_ptr<const FS::BackupListing> Listing = FS::GetBackupListing(TargetPath);
+        if (!Listing)
+        {
+            char TargetName[fslib::MAX_PATH] = {0};
+            StringUtil::ToUTF8(m_directoryListing[Selected].get_filename(), TargetName, fslib::MAX_PATH);
+            MessageState::create_and_push(
+                this,
+                StringUtil::GetFormattedString(Strings::GetStringByName(Strings::Names::BackupContents, 2), TargetName));
+            return;
+        }
+        JKSM::PushState(std::make_shared<BackupInspectState>(this, Listing));
+    }
     else if (input::button_pressed(KEY_B)) { BaseState::deactivate(); }
 }
 
@@ -194,65 +234,178 @@ void BackupMenuState::refresh()
     std::lock_guard listGuard{m_listingMutex};
     m_directoryListing.open(m_directoryPath);
     m_backupMenu.Reset();
+    m_backupIndexes.clear();
 
     // Loop and copy directory to menu after adding new
     m_backupMenu.AddOption(Strings::GetStringByName(Strings::Names::FolderMenuNew, 0));
     for (uint32_t i = 0; i < m_directoryListing.get_count(); i++)
     {
+        // The chunk store isn't a backup. Neither are the secure values saved next to single file backups.
+        std::u16string_view FileName = m_directoryListing[i].get_filename();
+        if (FS::ChunkStore::STORE_NAME == FileName || FileName.ends_with(SECURE_VALUE_NAME)) { continue; }
+        m_backupIndexes.push_back(i);
+
         char UTF8Buffer[0x80] = {0};
         StringUtil::ToUTF8(m_directoryListing[i].get_filename(), UTF8Buffer, 0x80);
         m_backupMenu.AddOption(UTF8Buffer);
     }
 }
 
+// Returns the title folder backupPath is in.
+static inline fslib::Path GetTitlePath(const fslib::Path &backupPath)
+{
+    return backupPath.sub_path(backupPath.find_last_of(u'/'));
+}
+
+// Returns the preference ZIP backups are compressed with. Anything out of range is treated as balanced.
+static inline FS::CompressionPreference GetZipCompression()
+{
+    int8_t Preference = Config::GetByKey(Config::Keys::ZipCompression);
+    if (Preference < 0 || Preference > static_cast<int8_t>(FS::CompressionPreference::Size))
+    {
+        return FS::CompressionPreference::Balanced;
+    }
+    return static_cast<FS::CompressionPreference>(Preference);
+}
+
+// Returns where the secure value for backupPath is saved. Folders keep it inside. Archives and deduplicated backups are single
+// files, so it's saved next to them. ZIPs keep it as an entry instead.
+static inline fslib::Path GetSecureValuePath(const fslib::Path &backupPath)
+{
+    if (fslib::directory_exists(backupPath)) { return backupPath / SECURE_VALUE_NAME; }
+    return backupPath + SECURE_VALUE_NAME;
+}
+
+// Saves targetTitle's secure value with backupPath if secure value preservation is on. Backup is the ZIP being written or
+// nullptr if backupPath isn't one.
+static void ExportSecureValue(const Data::TitleData *targetTitle, const fslib::Path &backupPath, zipFile Backup)
+{
+    uint64_t SecureValue = 0;
+    bool HasSecureValue  = Config::GetByKey(Config::Keys::PreserveSecureValues) &&
+                           fslib::get_secure_value_for_title(targetTitle->GetUniqueID(), SecureValue);
+    if (Backup)
+    {
+        if (!HasSecureValue) { return; }
+
+        // Eight bytes don't get any smaller deflated, so it's stored.
+        bool Opened  = zipOpenNewFileInZip(Backup, SECURE_VALUE_ENTRY, NULL, 0, 0, NULL, 0, NULL, 0, 0) == ZIP_OK;
+        bool Written = Opened && zipWriteInFileInZip(Backup, &SecureValue, sizeof(uint64_t)) == ZIP_OK;
+        if (Opened && zipCloseFileInZip(Backup) != ZIP_OK) { Written = false; }
+        if (!Written) { logger::log("Error while exporting secure value to ZIP during backup."); }
+        return;
+    }
+
+    fslib::Path SecureValuePath = GetSecureValuePath(backupPath);
+    if (!HasSecureValue)
+    {
+        // One left by an older backup with the same name doesn't belong to this one.
+        if (fslib::file_exists(SecureValuePath)) { fslib::delete_file(SecureValuePath); }
+        return;
+    }
+
+    fslib::File SecureValueFile(SecureValuePath, FS_OPEN_CREATE | FS_OPEN_WRITE);
+    if (!SecureValueFile.is_open() || SecureValueFile.write(&SecureValue, sizeof(uint64_t)) != sizeof(uint64_t))
+    {
+        logger::log("Error while exporting secure value during backup: %s", fslib::error::get_string());
+    }
+}
+
+// Sets targetTitle's secure value to the one saved with backupPath if secure value preservation is on. If it's off, the title's
+// secure value is deleted instead.
+static void ImportSecureValue(const Data::TitleData *targetTitle, const fslib::Path &backupPath)
+{
+    if (!Config::GetByKey(Config::Keys::PreserveSecureValues))
+    {
+        if (!FS::DeleteSecureValue(targetTitle->GetUniqueID()))
+        {
+            logger::log("Error occurred while trying to delete secure value for game.");
+        }
+        return;
+    }
+
+    uint64_t SecureValue        = 0;
+    bool Found                  = false;
+    bool Read                   = false;
+    fslib::Path SecureValuePath = GetSecureValuePath(backupPath);
+    if (fslib::file_exists(SecureValuePath))
+    {
+        Found = true;
+        fslib::File SecureValueFile(SecureValuePath, FS_OPEN_READ);
+        Read = SecureValueFile.is_open() && SecureValueFile.read(&SecureValue, sizeof(uint64_t)) == sizeof(uint64_t);
+    }
+    else if (fslib::file_exists(backupPath) && backupPath.get_extension() != FS::ZstdArchive::EXTENSION &&
+             backupPath.get_extension() != FS::ChunkStore::INDEX_EXTENSION)
+    {
+        // Anything else is assumed to be a ZIP like restores do. Closing it closes the entry too.
+        unzFile Backup = FS::OpenZipForReading(backupPath);
+        Found          = Backup && unzLocateFile(Backup, SECURE_VALUE_ENTRY, 0) == UNZ_OK;
+        Read           = Found && unzOpenCurrentFile(Backup) == UNZ_OK &&
+                         unzReadCurrentFile(Backup, &SecureValue, sizeof(uint64_t)) == sizeof(uint64_t);
+        if (Backup) { unzClose(Backup); }
+    }
+
+    if (Found && (!Read || !fslib::set_secure_value_for_title(targetTitle->GetUniqueID(), SecureValue)))
+    {
+        logger::log("Error occurred while attempting to set and preserve secure value for game.");
+    }
+}
+
 static void CreateNewBackup(System::ProgressTask *task,
                             fslib::Path backupPath,
                             const Data::TitleData *targetTitle,
                             BackupMenuState *creatingState)
 {
+    SetOperationTotal(task, FS::SAVE_ROOT, 0);
+
+    // Archives are only made when asked for by name. Deduplicated backups are used if asked for by name or the config, unless
+    // the name or config asks for a zip.
+    bool UseArchive  = backupPath.get_extension() == FS::ZstdArchive::EXTENSION;
+    bool Deduplicate = backupPath.get_extension() == FS::ChunkStore::INDEX_EXTENSION ||
+                       (Config::GetByKey(Config::Keys::DeduplicatedBackups) && !Config::GetByKey(Config::Keys::ExportToZip) &&
+                        backupPath.get_extension() != u"zip" && !UseArchive);
+
+    if (UseArchive)
+    {
+        FS::ZstdArchive Archive(FS::GetCopyWorkerCount());
+        if (!Archive.Backup(task, FS::SAVE_ROOT, backupPath)) { logger::log("Error creating backup archive."); }
+        ExportSecureValue(targetTitle, backupPath, nullptr);
+    }
+    else if (Deduplicate)
+    {
+        if (backupPath.get_extension() != FS::ChunkStore::INDEX_EXTENSION) { backupPath += u".jksi"; }
+
+        FS::ChunkStore Store(GetTitlePath(backupPath));
+        if (!Store.Backup(task, FS::SAVE_ROOT, backupPath)) { logger::log("Error creating deduplicated backup."); }
+        ExportSecureValue(targetTitle, backupPath, nullptr);
+    }
     // Make sure destination exists.
-    if (!Config::GetByKey(Config::Keys::ExportToZip) && backupPath.get_extension() != u"zip" &&
+    else if (!Config::GetByKey(Config::Keys::ExportToZip) && backupPath.get_extension() != u"zip" &&
         (fslib::directory_exists(backupPath) || fslib::create_directory(backupPath)))
     {
-        // Copy save as-is to target directory.
-        FS::CopyDirectoryToDirectory(task, FS::SAVE_ROOT, backupPath, false);
-
-        // If secure value preservation is active, try to dump it with the save if it exists.
-        uint64_t SecureValue = 0;
-        if (Config::GetByKey(Config::Keys::PreserveSecureValues) &&
-            fslib::get_secure_value_for_title(targetTitle->GetUniqueID(), SecureValue))
-        {
-            // Path. Trying to make sure no game would possibly use this...
-            fslib::Path SecureValuePath = backupPath / u"._secure_value";
-
-            fslib::File SecureValueFile(SecureValuePath, FS_OPEN_CREATE | FS_OPEN_WRITE);
-            if (!SecureValueFile.is_open() || SecureValueFile.write(&SecureValue, sizeof(uint64_t)) != sizeof(uint64_t))
-            {
-                logger::log("Error while exporting secure value during backup: %s", fslib::error::get_string());
-                return;
-            }
-        }
+        // Copy save to target directory.
+        BackupToFolder(task, backupPath);
+        ExportSecureValue(targetTitle, backupPath, nullptr);
     }
     else if (Config::GetByKey(Config::Keys::ExportToZip) || backupPath.get_extension() == u"zip")
     {
-        // Create the main backup first.
-        zipFile Backup = zipOpen("sdmc:/Temp.zip", APPEND_STATUS_CREATE);
-        FS::CopyDirectoryToZip(task, FS::SAVE_ROOT, Backup);
-
-        // Check if we need to add the secure value to the zip.
-        uint64_t SecureValue = 0;
-        if (Config::GetByKey(Config::Keys::PreserveSecureValues) &&
-            fslib::get_secure_value_for_title(targetTitle->GetUniqueID(), SecureValue) &&
-            zipOpenNewFileInZip(Backup, "._secure_value", NULL, 0, 0, NULL, 0, NULL, Z_DEFLATED, Z_DEFAULT_COMPRESSION) ==
-                ZIP_OK)
+        // The archive is written where it belongs.
+        zipFile Backup = FS::OpenZipForWriting(backupPath);
+        if (!Backup)
         {
-            zipWriteInFileInZip(Backup, &SecureValue, sizeof(uint64_t));
-            zipCloseFileInZip(Backup);
+            logger::log("Error creating ZIP backup.");
+            creatingState->refresh();
+            task->Finish();
+            return;
         }
+        bool Copied = FS::CopyDirectoryToZip(task, FS::SAVE_ROOT, Backup, GetZipCompression(), nullptr);
+        ExportSecureValue(targetTitle, backupPath, Backup);
 
-        // Close and move zip to destination.
-        zipClose(Backup, NULL);
-        fslib::rename_file(u"sdmc:/Temp.zip", backupPath);
+        // A ZIP missing files or with broken entries isn't kept around to be restored later.
+        if (zipClose(Backup, NULL) != ZIP_OK || !Copied)
+        {
+            logger::log("Error finishing ZIP backup.");
+            fslib::delete_file(backupPath);
+        }
     }
     creatingState->refresh();
     task->Finish();
@@ -260,76 +413,190 @@ static void CreateNewBackup(System::ProgressTask *task,
 
 static void OverwriteBackup(System::ProgressTask *task, std::shared_ptr<TargetStruct> dataStruct)
 {
+    FS::ForgetBackupListing(dataStruct->TargetPath);
+
     // fslib::directory_exists can also be used to test if the target is a directory.
+    // Other backups might reference files in this one, so those need to be moved out before it's deleted.
+    if (fslib::directory_exists(dataStruct->TargetPath) &&
+        !FS::ReleaseManifestReferences(task, GetTitlePath(dataStruct->TargetPath), dataStruct->TargetPath.get_filename()))
+    {
+        logger::log("Backup wasn't overwritten. Other backups still need files from it.");
+        task->Finish();
+        return;
+    }
+    SetOperationTotal(task, FS::SAVE_ROOT, 0);
+
     if (fslib::directory_exists(dataStruct->TargetPath) && fslib::delete_directory_recursively(dataStruct->TargetPath) &&
         fslib::create_directory(dataStruct->TargetPath))
     {
-        FS::CopyDirectoryToDirectory(task, FS::SAVE_ROOT, dataStruct->TargetPath, false);
+        BackupToFolder(task, dataStruct->TargetPath);
+        ExportSecureValue(dataStruct->TargetTitle, dataStruct->TargetPath, nullptr);
     }
-    else if (fslib::file_exists(dataStruct->TargetPath) && fslib::delete_file(dataStruct->TargetPath))
+    else if (dataStruct->TargetPath.get_extension() == FS::ChunkStore::INDEX_EXTENSION &&
+             fslib::file_exists(dataStruct->TargetPath) && fslib::delete_file(dataStruct->TargetPath))
     {
-        // Assuming this is a zip.
-        zipFile Backup = zipOpen("sdmc:/Temp.zip", APPEND_STATUS_CREATE);
-        FS::CopyDirectoryToZip(task, FS::SAVE_ROOT, Backup);
-        zipClose(Backup, NULL);
-        fslib::rename_file(u"sdmc:/Temp.zip", dataStruct->TargetPath);
+        // Chunks only the old index used are dropped after the new one is written.
+        FS::ChunkStore Store(GetTitlePath(dataStruct->TargetPath));
+        if (!Store.Backup(task, FS::SAVE_ROOT, dataStruct->TargetPath))
+        {
+            logger::log("Error overwriting deduplicated backup.");
+        }
+        Store.Collect();
+        ExportSecureValue(dataStruct->TargetTitle, dataStruct->TargetPath, nullptr);
+    }
+    else if (dataStruct->TargetPath.get_extension() == FS::ZstdArchive::EXTENSION &&
+             fslib::file_exists(dataStruct->TargetPath) && fslib::delete_file(dataStruct->TargetPath))
+    {
+        FS::ZstdArchive Archive(FS::GetCopyWorkerCount());
+        if (!Archive.Backup(task, FS::SAVE_ROOT, dataStruct->TargetPath)) { logger::log("Error overwriting backup archive."); }
+        ExportSecureValue(dataStruct->TargetTitle, dataStruct->TargetPath, nullptr);
+    }
+    else if (fslib::file_exists(dataStruct->TargetPath))
+    {
+        // Assuming this is a zip. The new one is written next to the old one so files that haven't changed can be copied
+        // from it still compressed. The old one is only replaced once the new one is finished with every file in it.
+        fslib::Path UpdatePath = dataStruct->TargetPath + u".tmp";
+        unzFile Previous       = FS::OpenZipForReading(dataStruct->TargetPath);
+        zipFile Backup         = FS::OpenZipForWriting(UpdatePath);
+        bool Finished          = false;
+        if (!Backup) { logger::log("Error creating ZIP backup."); }
+        else
+        {
+            bool Copied = FS::CopyDirectoryToZip(task, FS::SAVE_ROOT, Backup, GetZipCompression(), Previous);
+            ExportSecureValue(dataStruct->TargetTitle, dataStruct->TargetPath, Backup);
+            Finished = zipClose(Backup, NULL) == ZIP_OK && Copied;
+            if (!Finished) { logger::log("Error finishing ZIP backup. The previous one was kept."); }
+        }
+        // The old one has to be closed before it can be replaced.
+        if (Previous) { unzClose(Previous); }
+
+        if (!Finished) { fslib::delete_file(UpdatePath); }
+        else if (!fslib::delete_file(dataStruct->TargetPath) || !fslib::rename_file(UpdatePath, dataStruct->TargetPath))
+        {
+            logger::log("Error replacing ZIP backup: %s", fslib::error::get_string());
+        }
     }
     task->Finish();
 }
 
 static void RestoreBackup(System::ProgressTask *task, std::shared_ptr<TargetStruct> dataStruct)
 {
-    if (!fslib::delete_directory_recursively(FS::SAVE_ROOT))
+    // Folder backups store files without their zero runs under a suffix and only the manifest has the runs. If it's missing or
+    // damaged, nothing is touched.
+    bool IsFolder = fslib::directory_exists(dataStruct->TargetPath);
+    FS::Manifest BackupManifest;
+    bool HasManifest = IsFolder && BackupManifest.Load(dataStruct->TargetPath);
+    if (IsFolder && !HasManifest && FS::HasCompactedFiles(dataStruct->TargetPath))
     {
-        logger::log("Error occurred resetting save data: %s", fslib::error::get_string());
+        logger::log("Backup can't be restored. Files in it need its manifest and it's missing or damaged.");
         task->Finish();
         return;
     }
 
-    // Secure value check. Scoped so path gets freed immediately after check is finished.
+    // Differential restores only work with folders. They take care of removing what the backup doesn't have themselves.
+    bool Differential = Config::GetByKey(Config::Keys::DifferentialRestore) && IsFolder;
+
+    // Full folder restores are journaled. If the same restore was interrupted before, the save isn't wiped again and it picks
+    // up where it stopped.
+    FS::Journal RestoreJournal(FS::Journal::DEFAULT_PATH);
+    bool Journaled = !Differential && IsFolder;
+    bool Resuming  = Journaled && RestoreJournal.Begin(dataStruct->TargetPath, FS::SAVE_ROOT);
+
+    if (!Differential && !Resuming && !fslib::delete_directory_recursively(FS::SAVE_ROOT))
     {
-        // This is the path the secure value if it exits.
-        fslib::Path SecureValuePath = dataStruct->TargetPath / u"._secure_value";
-        if (Config::GetByKey(Config::Keys::PreserveSecureValues) && fslib::file_exists(SecureValuePath))
-        {
-            // Try to open file and read secure value.
-            uint64_t SecureValue = 0;
-            fslib::File SecureValueFile(SecureValuePath, FS_OPEN_READ);
-            if (!SecureValueFile.is_open() || SecureValueFile.read(&SecureValue, sizeof(uint64_t)) != sizeof(uint64_t) ||
-                !fslib::set_secure_value_for_title(dataStruct->TargetTitle->GetUniqueID(), SecureValue))
-            {
-                logger::log("Error occurred while attempting to set and preserve secure value for game.");
-            }
-        }
-        else if (!Config::GetByKey(Config::Keys::PreserveSecureValues) &&
-                 !FS::DeleteSecureValue(dataStruct->TargetTitle->GetUniqueID()))
-        {
-            logger::log("Error occurred while trying to delete secure value for game.");
-        }
+        logger::log("Error occurred resetting save data: %s", fslib::error::get_string());
+        if (Journaled) { RestoreJournal.Finish(); }
+        task->Finish();
+        return;
     }
 
-    // Whether or not committing data is needed.
+    // Every backup format keeps the secure value somewhere.
+    ImportSecureValue(dataStruct->TargetTitle, dataStruct->TargetPath);
+
+    // Whether or not committing data is needed. If it is, everything is committed once at the end unless the config asks for
+    // more frequent commits.
     bool CommitData = (dataStruct->SaveType == Data::SaveDataType::SaveTypeUser ||
                        dataStruct->SaveType == Data::SaveDataType::SaveTypeSystem);
+    int8_t CommitInterval = Config::GetByKey(Config::Keys::CommitInterval);
+    FS::Transaction SaveTransaction(FS::SAVE_MOUNT, CommitInterval > 0 ? static_cast<uint64_t>(CommitInterval) << 20 : 0);
+    FS::Transaction *Transaction = CommitData ? &SaveTransaction : nullptr;
 
     // This can also be used to test if the target is a directory. Not just if it exists.
-    if (fslib::directory_exists(dataStruct->TargetPath))
+    if (IsFolder)
+    {
+        // Files the manifest references from other backups aren't in the folder. They still count towards the total and
+        // differential restores need to keep them. So do the zero runs left out of the files that are.
+        uint64_t ReferencedSize = 0;
+        for (const FS::Manifest::Entry &CurrentEntry : BackupManifest.GetEntries())
+        {
+            if (!CurrentEntry.Reference.empty()) { ReferencedSize += CurrentEntry.Size; }
+            else { ReferencedSize += FS::GetZeroRunTotal(CurrentEntry.ZeroRuns); }
+        }
+        SetOperationTotal(task, dataStruct->TargetPath, ReferencedSize);
+
+        // The backup's data is always checked against the hashes in its manifest while it's copied.
+        FS::Verification Verify = {.Expected = HasManifest ? &BackupManifest : nullptr,
+                                   .ReadBack = Config::GetByKey(Config::Keys::VerifyCopies) == 1};
+        if (Differential)
+        {
+            FS::RestoreDirectoryDifferential(task,
+                                             dataStruct->TargetPath,
+                                             FS::SAVE_ROOT,
+                                             Transaction,
+                                             HasManifest ? &BackupManifest : nullptr,
+                                             &Verify);
+        }
+        else
+        {
+            FS::CopyDirectoryToDirectory(task,
+                                         dataStruct->TargetPath,
+                                         FS::SAVE_ROOT,
+                                         Transaction,
+                                         &RestoreJournal,
+                                         HasManifest ? &BackupManifest : nullptr,
+                                         &Verify);
+        }
+
+        // Files an incremental backup didn't store itself are copied from the backups that have them.
+        FS::RestoreManifestReferences(task,
+                                      GetTitlePath(dataStruct->TargetPath),
+                                      dataStruct->TargetPath,
+                                      FS::SAVE_ROOT,
+                                      Transaction,
+                                      Differential);
+    }
+    else if (dataStruct->TargetPath.get_extension() == FS::ZstdArchive::EXTENSION)
     {
-        FS::CopyDirectoryToDirectory(task, dataStruct->TargetPath, FS::SAVE_ROOT, CommitData);
+        // Restores never start the workers.
+        FS::ZstdArchive Archive(1);
+        if (!Archive.Restore(task, dataStruct->TargetPath, FS::SAVE_ROOT, Transaction))
+        {
+            logger::log("Error restoring backup archive.");
+        }
+    }
+    else if (dataStruct->TargetPath.get_extension() == FS::ChunkStore::INDEX_EXTENSION)
+    {
+        FS::ChunkStore Store(GetTitlePath(dataStruct->TargetPath));
+        if (!Store.Restore(task, dataStruct->TargetPath, FS::SAVE_ROOT, Transaction))
+        {
+            logger::log("Error restoring deduplicated backup.");
+        }
     }
     else
     {
-        // This is just assuming the file is a zip file. This probably isn't the greatest idea.
-        fslib::rename_file(dataStruct->TargetPath, u"sdmc:/Temp.zip");
-
-        // Open file for *unzips* and extract it to save archive.
-        unzFile UnZip = unzOpen("sdmc:/Temp.zip");
-        FS::CopyZipToDirectory(task, UnZip, FS::SAVE_ROOT, CommitData);
-        unzClose(UnZip);
-
-        // Rename file back to original.
-        fslib::rename_file(u"sdmc:/Temp.zip", dataStruct->TargetPath);
+        // This is just assuming the file is a zip file. This probably isn't the greatest idea. It's read where it is.
+        unzFile UnZip = FS::OpenZipForReading(dataStruct->TargetPath);
+        if (!UnZip) { logger::log("Error opening ZIP backup for restore."); }
+        else
+        {
+            FS::Verification Verify = {.Expected = nullptr, .ReadBack = Config::GetByKey(Config::Keys::VerifyCopies) == 1};
+            FS::CopyZipToDirectory(task, UnZip, FS::SAVE_ROOT, Transaction, &Verify);
+            unzClose(UnZip);
+        }
     }
+
+    if (Transaction && !Transaction->Finish()) { logger::log("One or more commits failed during restore."); }
+    if (Journaled) { RestoreJournal.Finish(); }
     task->Finish();
 }
 
@@ -339,6 +606,15 @@ static void DeleteBackup(System::Task *task, std::shared_ptr<TargetStruct> dataS
     char TargetName[fslib::MAX_PATH] = {0};
     StringUtil::ToUTF8(dataStruct->TargetPath.full_path(), TargetName, fslib::MAX_PATH);
     task->SetStatus(Strings::GetStringByName(Strings::Names::DeletingBackup, 0), TargetName);
+    FS::ForgetBackupListing(dataStruct->TargetPath);
+
+    if (fslib::directory_exists(dataStruct->TargetPath) &&
+        !FS::ReleaseManifestReferences(nullptr, GetTitlePath(dataStruct->TargetPath), dataStruct->TargetPath.get_filename()))
+    {
+        logger::log("Backup wasn't deleted. Other backups still need files from it.");
+        task->Finish();
+        return;
+    }
 
     if (fslib::directory_exists(dataStruct->TargetPath) && fslib::delete_directory_recursively(dataStruct->TargetPath))
     {
@@ -346,6 +622,14 @@ static void DeleteBackup(System::Task *task, std::shared_ptr<TargetStruct> dataS
     }
     else if (fslib::file_exists(dataStruct->TargetPath) && fslib::delete_file(dataStruct->TargetPath))
     {
+        // Archives and deduplicated backups have their secure value next to them.
+        fslib::Path SecureValuePath = GetSecureValuePath(dataStruct->TargetPath);
+        if (fslib::file_exists(SecureValuePath)) { fslib::delete_file(SecureValuePath); }
+
+        if (dataStruct->TargetPath.get_extension() == FS::ChunkStore::INDEX_EXTENSION)
+        {
+            FS::ChunkStore(GetTitlePath(dataStruct->TargetPath)).Collect();
+        }
         dataStruct->CallingState->refresh();
     }
     else { logger::log("Error deleting backup: %s", fslib::error::get_string()); }
@@ -354,3 +638,42 @@ static void DeleteBackup(System::Task *task, std::shared_ptr<TargetStruct> dataS
 
     task->Finish();
 }
+
+static void BackupToFolder(System::ProgressTask *task, const fslib::Path &backupPath)
+{
+    // The newest backup is needed either way so this one gets the next generation.
+    fslib::Path TitlePath = GetTitlePath(backupPath);
+    FS::Manifest Previous;
+    std::u16string PreviousName;
+    bool HasPrevious = FS::LoadLatestManifest(TitlePath, backupPath.get_filename(), Previous, PreviousName);
+
+    FS::Manifest BackupManifest;
+    BackupManifest.SetGeneration(HasPrevious ? Previous.GetGeneration() + 1 : 1);
+
+    // If the last backup to this folder was interrupted, whatever it finished is kept.
+    FS::Journal BackupJournal(FS::Journal::DEFAULT_PATH);
+    BackupJournal.Begin(FS::SAVE_ROOT, backupPath);
+
+    bool Incremental        = HasPrevious && Config::GetByKey(Config::Keys::IncrementalBackups);
+    FS::Verification Verify = {.Expected = nullptr, .ReadBack = Config::GetByKey(Config::Keys::VerifyCopies) == 1};
+    FS::CopyDirectoryToBackup(task,
+                              FS::SAVE_ROOT,
+                              backupPath,
+                              Incremental ? &Previous : nullptr,
+                              PreviousName,
+                              BackupManifest,
+                              &BackupJournal,
+                              &Verify);
+
+    BackupManifest.Save(backupPath);
+    BackupJournal.Finish();
+}
+
+static void SetOperationTotal(System::ProgressTask *task, const fslib::Path &source, uint64_t extraSize)
+{
+    // Progress is shown for the whole operation instead of starting over for every file. extraSize is for anything that
+    // isn't in source but is copied anyway.
+    FS::DirectoryTotals Totals;
+    FS::GetDirectoryTotals(source, Totals);
+    task->SetOperationTotal(static_cast<double>(Totals.TotalSize + extraSize));
+}
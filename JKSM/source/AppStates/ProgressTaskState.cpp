@@ -1,6 +1,7 @@
 #include "appstates/ProgressTaskState.hpp"
 
 #include "StringUtil.hpp"
+#include "Strings.hpp"
 #include "UI/Draw.hpp"
 
 #include <cmath>
@@ -12,6 +13,18 @@ void ProgressTaskState::update()
     m_LoadBarWidth      = std::ceil(256.0f * m_task->GetProgress());
     m_percentageString  = StringUtil::GetFormattedString("%u", m_currentPercentage);
     m_percentageX       = 160 - (m_noto->GetTextWidth(12, m_percentageString.c_str()) / 2);
+
+    // Nothing is shown until there is a rate to go by.
+    double SecondsRemaining = m_task->HasOperationTotal() ? m_task->GetSecondsRemaining() : -1;
+    if (SecondsRemaining < 0) { m_rateString.clear(); }
+    else
+    {
+        uint32_t Seconds = static_cast<uint32_t>(SecondsRemaining);
+        m_rateString     = StringUtil::GetFormattedString(Strings::GetStringByName(Strings::Names::ProgressRate, 0),
+                                                      m_task->GetRate() / 1048576.0f,
+                                                      Seconds / 60,
+                                                      Seconds % 60);
+    }
 }
 
 void ProgressTaskState::draw_top(SDL_Surface *target)
@@ -25,7 +38,9 @@ void ProgressTaskState::draw_bottom(SDL_Surface *target)
     SDL::DrawRect(target, 0, 0, 320, 16, SDL::Colors::BarColor);
     // Dialog box and status
     UI::DrawDialogBox(target, 8, 18, 304, 204);
-    m_noto->BlitTextAt(target, 30, 30, 12, 268, "%s", m_task->GetStatus().c_str());
+    m_noto->BlitTextAt(target, 30, 30, 12, 268, "%s", m_task->GetStatus());
+    // Throughput and time left above the bar.
+    if (!m_rateString.empty()) { m_noto->BlitTextAt(target, 32, 168, 12, 256, "%s", m_rateString.c_str()); }
     // Bar showing progress.
     SDL::DrawRect(target, 32, 188, 256, 16, SDL::Colors::Black);
     SDL::DrawRect(target, 32, 188, m_LoadBarWidth, 16, SDL::Colors::Green);
@@ -25,7 +25,11 @@ enum
     PRESERVE_SECURE_VALUE,
     HOLD_FOR_OVERWRITE,
     HOLD_FOR_RESTORE,
-    HOLD_FOR_DELETION
+    HOLD_FOR_DELETION,
+    INCREMENTAL_BACKUPS,
+    DEDUPLICATED_BACKUPS,
+    DIFFERENTIAL_RESTORE,
+    VERIFY_COPIES
 };
 
 // This doesn't really convert bools, but tha
@@ -126,6 +130,22 @@ void SettingsState::update_menu_strings()
     m_settingsMenu.EditOption(7,
                               StringUtil::GetFormattedString(Strings::GetStringByName(Strings::Names::SettingsMenu, 7),
                                                              GetValueText(Config::GetByKey(Config::Keys::HoldToDelete))));
+    m_settingsMenu.EditOption(
+        8,
+        StringUtil::GetFormattedString(Strings::GetStringByName(Strings::Names::SettingsMenu, 8),
+                                       GetValueText(Config::GetByKey(Config::Keys::IncrementalBackups))));
+    m_settingsMenu.EditOption(
+        9,
+        StringUtil::GetFormattedString(Strings::GetStringByName(Strings::Names::SettingsMenu, 9),
+                                       GetValueText(Config::GetByKey(Config::Keys::DeduplicatedBackups))));
+    m_settingsMenu.EditOption(
+        10,
+        StringUtil::GetFormattedString(Strings::GetStringByName(Strings::Names::SettingsMenu, 10),
+                                       GetValueText(Config::GetByKey(Config::Keys::DifferentialRestore))));
+    m_settingsMenu.EditOption(
+        11,
+        StringUtil::GetFormattedString(Strings::GetStringByName(Strings::Names::SettingsMenu, 11),
+                                       GetValueText(Config::GetByKey(Config::Keys::VerifyCopies))));
 }
 
 void SettingsState::update_config()
@@ -186,6 +206,30 @@ void SettingsState::update_config()
             Config::SetByKey(Config::Keys::HoldToDelete, Config::GetByKey(Config::Keys::HoldToDelete) ? 0 : 1);
         }
         break;
+
+        case INCREMENTAL_BACKUPS:
+        {
+            Config::SetByKey(Config::Keys::IncrementalBackups, Config::GetByKey(Config::Keys::IncrementalBackups) ? 0 : 1);
+        }
+        break;
+
+        case DEDUPLICATED_BACKUPS:
+        {
+            Config::SetByKey(Config::Keys::DeduplicatedBackups, Config::GetByKey(Config::Keys::DeduplicatedBackups) ? 0 : 1);
+        }
+        break;
+
+        case DIFFERENTIAL_RESTORE:
+        {
+            Config::SetByKey(Config::Keys::DifferentialRestore, Config::GetByKey(Config::Keys::DifferentialRestore) ? 0 : 1);
+        }
+        break;
+
+        case VERIFY_COPIES:
+        {
+            Config::SetByKey(Config::Keys::VerifyCopies, Config::GetByKey(Config::Keys::VerifyCopies) ? 0 : 1);
+        }
+        break;
     }
 
     if (SaveConfig) { Config::Save(); }
@@ -19,6 +19,5 @@ void TaskState::draw_bottom(SDL_Surface *target)
     // Render dialog box
     UI::DrawDialogBox(target, 8, 18, 304, 204);
     // Render status here, wrapped. Didn't work too well centered on the top screen.
-    std::string ThreadStatus = m_task->GetStatus();
-    m_noto->BlitTextAt(target, 30, 30, 12, 268, ThreadStatus.c_str());
+    m_noto->BlitTextAt(target, 30, 30, 12, 268, "%s", m_task->GetStatus());
 }
@@ -19,6 +19,25 @@ namespace
     uint8_t s_SystemLanguage = 0;
 } // namespace
 
+// Fills the map with the default value for every key.
+static void SetDefaults()
+{
+    s_ConfigMap[Config::Keys::TextMode.data()]             = 0;
+    s_ConfigMap[Config::Keys::ForceEnglish.data()]         = 0;
+    s_ConfigMap[Config::Keys::PreserveSecureValues.data()] = 0;
+    s_ConfigMap[Config::Keys::HoldToOverwrite.data()]      = 1;
+    s_ConfigMap[Config::Keys::HoldToRestore.data()]        = 1;
+    s_ConfigMap[Config::Keys::HoldToDelete.data()]         = 1;
+    s_ConfigMap[Config::Keys::ExportToZip.data()]          = 0;
+    s_ConfigMap[Config::Keys::CommitInterval.data()]       = 0;
+    s_ConfigMap[Config::Keys::IncrementalBackups.data()]   = 0;
+    s_ConfigMap[Config::Keys::DeduplicatedBackups.data()]  = 0;
+    s_ConfigMap[Config::Keys::DifferentialRestore.data()]  = 0;
+    s_ConfigMap[Config::Keys::VerifyCopies.data()]         = 0;
+    s_ConfigMap[Config::Keys::ParallelCopies.data()]       = 0;
+    s_ConfigMap[Config::Keys::ZipCompression.data()]       = 1;
+}
+
 void Config::Initialize()
 {
     // Read system language first.
@@ -37,6 +56,9 @@ void Config::Initialize()
         return;
     }
 
+    // Start from the defaults so keys added after the config was written still have a value.
+    SetDefaults();
+
     json_object_iterator CurrentConfigValue = json_object_iter_begin(ConfigJSON.get());
     json_object_iterator ConfigEnd          = json_object_iter_end(ConfigJSON.get());
     while (!json_object_iter_equal(&CurrentConfigValue, &ConfigEnd))
@@ -52,13 +74,7 @@ void Config::Initialize()
 
 void Config::ResetToDefault()
 {
-    s_ConfigMap[Config::Keys::TextMode.data()]             = 0;
-    s_ConfigMap[Config::Keys::ForceEnglish.data()]         = 0;
-    s_ConfigMap[Config::Keys::PreserveSecureValues.data()] = 0;
-    s_ConfigMap[Config::Keys::HoldToOverwrite.data()]      = 1;
-    s_ConfigMap[Config::Keys::HoldToRestore.data()]        = 1;
-    s_ConfigMap[Config::Keys::HoldToDelete.data()]         = 1;
-    s_ConfigMap[Config::Keys::ExportToZip.data()]          = 0;
+    SetDefaults();
 
     /*
     // Zip is only enabled by default if on New 3DS. It's too slow on original.
@@ -0,0 +1,136 @@
+#include "FS/BackupListing.hpp"
+
+#include "FS/ZipIO.hpp"
+#include "FS/ZstdArchive.hpp"
+#include "StringUtil.hpp"
+#include "logging/logger.hpp"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+    // Most listings kept at once. The one used longest ago is dropped to make room.
+    constexpr size_t MAX_CACHED_LISTINGS = 32;
+
+    typedef struct
+    {
+            std::shared_ptr<const FS::BackupListing> Listing;
+            uint64_t LastUsed;
+    } CachedListing;
+
+    // Listings are read on the main thread, but backups are overwritten and deleted by tasks.
+    std::mutex s_CacheLock;
+    std::unordered_map<std::u16string, CachedListing> s_Cache;
+    uint64_t s_UseCounter = 0;
+} // namespace
+
+// Lists the ZIP at ZipPath from its central directory. Nothing is inflated.
+static bool ListZip(const fslib::Path &ZipPath, FS::BackupListing &ListingOut)
+{
+    unzFile Zip = FS::OpenZipForReading(ZipPath);
+    if (!Zip)
+    {
+        logger::log("Error opening ZIP to list it.");
+        return false;
+    }
+
+    unz_global_info64 GlobalInfo;
+    if (unzGetGlobalInfo64(Zip, &GlobalInfo) == UNZ_OK) { ListingOut.Entries.reserve(GlobalInfo.number_entry); }
+
+    int ZipError = unzGoToFirstFile(Zip);
+    while (ZipError == UNZ_OK)
+    {
+        unz_file_info64 FileInfo;
+        char FileName[fslib::MAX_PATH] = {0};
+        ZipError = unzGetCurrentFileInfo64(Zip, &FileInfo, FileName, fslib::MAX_PATH, NULL, 0, NULL, 0);
+        if (ZipError != UNZ_OK) { break; }
+
+        // Directories only show up as part of the paths of the files in them.
+        std::string_view Name(FileName);
+        if (!Name.empty() && Name.back() != '/')
+        {
+            ListingOut.Entries.push_back({std::string(Name), FileInfo.uncompressed_size});
+            ListingOut.TotalSize += FileInfo.uncompressed_size;
+            ListingOut.StoredSize += FileInfo.compressed_size;
+        }
+        ZipError = unzGoToNextFile(Zip);
+    }
+    unzClose(Zip);
+
+    if (ZipError != UNZ_END_OF_LIST_OF_FILE)
+    {
+        logger::log("Error reading ZIP central directory: %i.", ZipError);
+        return false;
+    }
+    return true;
+}
+
+// Lists the archive at ArchivePath from its index.
+static bool ListArchive(const fslib::Path &ArchivePath, FS::BackupListing &ListingOut)
+{
+    std::vector<FS::ZstdArchive::IndexEntry> Entries;
+    std::vector<FS::ZstdArchive::FrameEntry> Frames;
+    if (!FS::ZstdArchive::ReadIndex(ArchivePath, Entries, Frames)) { return false; }
+
+    ListingOut.Entries.reserve(Entries.size());
+    for (const FS::ZstdArchive::IndexEntry &Entry : Entries)
+    {
+        if (Entry.IsDirectory) { continue; }
+
+        char PathUTF8[fslib::MAX_PATH] = {0};
+        StringUtil::ToUTF8(Entry.Path.c_str(), PathUTF8, fslib::MAX_PATH);
+        ListingOut.Entries.push_back({PathUTF8, Entry.Size});
+        ListingOut.TotalSize += Entry.Size;
+    }
+    // Files share frames, so only the whole archive has a stored size.
+    for (const FS::ZstdArchive::FrameEntry &Frame : Frames) { ListingOut.StoredSize += Frame.CompressedSize; }
+    return true;
+}
+
+std::shared_ptr<const FS::BackupListing> FS::GetBackupListing(const fslib::Path &BackupPath)
+{
+    uint64_t BackupSize = 0;
+    if (!fslib::file_exists(BackupPath) || !fslib::get_file_size(BackupPath, BackupSize)) { return nullptr; }
+
+    std::u16string Key(BackupPath.full_path());
+    {
+        std::scoped_lock<std::mutex> CacheLock(s_CacheLock);
+        auto Found = s_Cache.find(Key);
+        if (Found != s_Cache.end() && Found->second.Listing->BackupSize == BackupSize)
+        {
+            Found->second.LastUsed = ++s_UseCounter;
+            return Found->second.Listing;
+        }
+    }
+
+    // The lock isn't held while reading so tasks aren't held up by it.
+    std::shared_ptr<FS::BackupListing> Listing = std::make_shared<FS::BackupListing>();
+    Listing->TotalSize  = 0;
+    Listing->StoredSize = 0;
+    Listing->BackupSize = BackupSize;
+
+    bool Listed = false;
+    if (BackupPath.get_extension() == u"zip") { Listed = ListZip(BackupPath, *Listing); }
+    else if (BackupPath.get_extension() == FS::ZstdArchive::EXTENSION) { Listed = ListArchive(BackupPath, *Listing); }
+    if (!Listed) { return nullptr; }
+
+    std::scoped_lock<std::mutex> CacheLock(s_CacheLock);
+    if (s_Cache.size() >= MAX_CACHED_LISTINGS && s_Cache.find(Key) == s_Cache.end())
+    {
+        auto Oldest = s_Cache.begin();
+        for (auto Current = s_Cache.begin(); Current != s_Cache.end(); ++Current)
+        {
+            if (Current->second.LastUsed < Oldest->second.LastUsed) { Oldest = Current; }
+        }
+        s_Cache.erase(Oldest);
+    }
+    s_Cache[Key] = {Listing, ++s_UseCounter};
+    return Listing;
+}
+
+void FS::ForgetBackupListing(const fslib::Path &BackupPath)
+{
+    std::scoped_lock<std::mutex> CacheLock(s_CacheLock);
+    s_Cache.erase(std::u16string(BackupPath.full_path()));
+}
@@ -0,0 +1,185 @@
+#include "FS/BlockDeflater.hpp"
+
+#include "logging/logger.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Most of the block before that deflate can refer back to.
+    constexpr size_t DICTIONARY_SIZE = 0x8000;
+    // Room past deflateBound for the sync flush's empty stored block.
+    constexpr size_t SYNC_FLUSH_SIZE = 0x10;
+} // namespace
+
+FS::BlockDeflater::BlockDeflater(size_t WorkerCount)
+{
+    WorkerCount = std::max<size_t>(WorkerCount, 1);
+
+    // One more block than there are workers so the next one can be filled while they're all busy.
+    for (size_t i = 0; i < WorkerCount + 1; i++)
+    {
+        // Everything else starts zeroed. Blocks are done until they're submitted.
+        std::unique_ptr<Block> NewBlock(new Block());
+        NewBlock->Input      = std::unique_ptr<unsigned char[]>(new unsigned char[BLOCK_SIZE]);
+        NewBlock->Dictionary = std::unique_ptr<unsigned char[]>(new unsigned char[DICTIONARY_SIZE]);
+        NewBlock->Done       = true;
+
+        // Raw deflate. Minizip writes the ZIP headers itself. The level is changed to the entry's when the block is used.
+        NewBlock->StreamLevel = Z_DEFAULT_COMPRESSION;
+        if (deflateInit2(&NewBlock->Stream, NewBlock->StreamLevel, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            // deflateReset fails on this block when it's used, so the entries it's part of fail.
+            logger::log("Error initializing deflate for ZIP blocks.");
+        }
+        else if (m_OutputCapacity == 0) { m_OutputCapacity = deflateBound(&NewBlock->Stream, BLOCK_SIZE) + SYNC_FLUSH_SIZE; }
+        m_Blocks.push_back(std::move(NewBlock));
+    }
+
+    for (std::unique_ptr<Block> &CurrentBlock : m_Blocks)
+    {
+        CurrentBlock->Output = std::unique_ptr<unsigned char[]>(new unsigned char[m_OutputCapacity]);
+    }
+    m_Workers = std::make_unique<System::ThreadPool>(WorkerCount);
+}
+
+FS::BlockDeflater::~BlockDeflater()
+{
+    // Nothing can still be deflating once the workers are joined.
+    m_Workers.reset();
+    for (std::unique_ptr<Block> &CurrentBlock : m_Blocks) { deflateEnd(&CurrentBlock->Stream); }
+}
+
+void FS::BlockDeflater::Begin(zipFile Destination, int Level)
+{
+    m_Destination                  = Destination;
+    m_Level                        = Level;
+    m_Crc                          = crc32(0, Z_NULL, 0);
+    m_Size                         = 0;
+    m_CompressedSize               = 0;
+    m_FirstBlock                   = true;
+    m_Failed                       = false;
+    m_Blocks[m_Filling]->InputSize = 0;
+}
+
+bool FS::BlockDeflater::Update(const void *Data, size_t Size)
+{
+    const unsigned char *Input = reinterpret_cast<const unsigned char *>(Data);
+    while (Size > 0)
+    {
+        Block &Filling  = *m_Blocks[m_Filling];
+        size_t CopySize = std::min(Size, BLOCK_SIZE - Filling.InputSize);
+        std::memcpy(&Filling.Input[Filling.InputSize], Input, CopySize);
+        Filling.InputSize += CopySize;
+        Input += CopySize;
+        Size -= CopySize;
+
+        if (Filling.InputSize == BLOCK_SIZE) { BlockDeflater::SubmitBlock(false); }
+    }
+    return !m_Failed;
+}
+
+bool FS::BlockDeflater::Finish(uint32_t &CrcOut, uint64_t &SizeOut, uint64_t &CompressedSizeOut)
+{
+    // The last block is submitted even if it's empty since it's the one that ends the stream.
+    BlockDeflater::SubmitBlock(true);
+    while (m_Pending > 0) { BlockDeflater::WriteOldestBlock(); }
+
+    CrcOut            = m_Crc;
+    SizeOut           = m_Size;
+    CompressedSizeOut = m_CompressedSize;
+    return !m_Failed;
+}
+
+void FS::BlockDeflater::SubmitBlock(bool Last)
+{
+    Block *Submitted = m_Blocks[m_Filling].get();
+    Submitted->Last  = Last;
+    Submitted->Level = m_Level;
+    if (m_FirstBlock) { Submitted->DictionarySize = 0; }
+    m_FirstBlock = false;
+
+    {
+        std::scoped_lock<std::mutex> BlockLock(m_BlockLock);
+        Submitted->Done   = false;
+        Submitted->Failed = false;
+    }
+    m_Workers->Submit([this, Submitted]() { BlockDeflater::DeflateBlock(Submitted); });
+    ++m_Pending;
+
+    m_Filling = (m_Filling + 1) % m_Blocks.size();
+    if (Last) { return; }
+
+    // The next block can only be filled once it's been written.
+    if (m_Pending == m_Blocks.size()) { BlockDeflater::WriteOldestBlock(); }
+
+    // It's primed with the end of the one just submitted. That one's only read by its worker, so this is safe to copy now.
+    Block &Next         = *m_Blocks[m_Filling];
+    Next.InputSize      = 0;
+    Next.DictionarySize = std::min(Submitted->InputSize, DICTIONARY_SIZE);
+    std::memcpy(Next.Dictionary.get(), &Submitted->Input[Submitted->InputSize - Next.DictionarySize], Next.DictionarySize);
+}
+
+void FS::BlockDeflater::WriteOldestBlock()
+{
+    Block &Oldest = *m_Blocks[m_Oldest];
+    {
+        std::unique_lock<std::mutex> BlockLock(m_BlockLock);
+        m_BlockDone.wait(BlockLock, [&Oldest]() { return Oldest.Done; });
+    }
+
+    if (Oldest.Failed) { m_Failed = true; }
+    else if (!m_Failed && zipWriteInFileInZip(m_Destination, Oldest.Output.get(), Oldest.OutputSize) != ZIP_OK)
+    {
+        logger::log("Error writing deflated block to ZIP.");
+        m_Failed = true;
+    }
+
+    m_Crc = crc32_combine(m_Crc, Oldest.Crc, Oldest.InputSize);
+    m_Size += Oldest.InputSize;
+    m_CompressedSize += Oldest.OutputSize;
+    m_Oldest = (m_Oldest + 1) % m_Blocks.size();
+    --m_Pending;
+}
+
+void FS::BlockDeflater::DeflateBlock(Block *Target)
+{
+    z_stream &Stream = Target->Stream;
+    bool Deflated    = deflateReset(&Stream) == Z_OK;
+    // The level can only change before anything's deflated, which it is right after a reset.
+    if (Deflated && Target->StreamLevel != Target->Level)
+    {
+        Deflated = deflateParams(&Stream, Target->Level, Z_DEFAULT_STRATEGY) == Z_OK;
+        if (Deflated) { Target->StreamLevel = Target->Level; }
+    }
+    if (Deflated && Target->DictionarySize > 0)
+    {
+        Deflated = deflateSetDictionary(&Stream, Target->Dictionary.get(), Target->DictionarySize) == Z_OK;
+    }
+
+    if (Deflated)
+    {
+        Stream.next_in   = Target->Input.get();
+        Stream.avail_in  = Target->InputSize;
+        Stream.next_out  = Target->Output.get();
+        Stream.avail_out = m_OutputCapacity;
+
+        // The sync flush is what puts the end of the block on a byte boundary so the next one can follow it.
+        int DeflateError   = deflate(&Stream, Target->Last ? Z_FINISH : Z_SYNC_FLUSH);
+        Target->OutputSize = m_OutputCapacity - Stream.avail_out;
+        // Running out of room means the output was cut off.
+        if (Target->Last) { Deflated = DeflateError == Z_STREAM_END; }
+        else { Deflated = DeflateError == Z_OK && Stream.avail_out > 0; }
+    }
+    if (!Deflated) { logger::log("Error deflating ZIP block."); }
+
+    Target->Crc = crc32(crc32(0, Z_NULL, 0), Target->Input.get(), Target->InputSize);
+
+    {
+        std::scoped_lock<std::mutex> BlockLock(m_BlockLock);
+        Target->Done   = true;
+        Target->Failed = !Deflated;
+    }
+    m_BlockDone.notify_all();
+}
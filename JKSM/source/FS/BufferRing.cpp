@@ -0,0 +1,144 @@
+#include "FS/BufferRing.hpp"
+
+#include <chrono>
+
+// Waits on Condition until Ready returns true. If it had to wait at all, the wait is added to WaitCount and WaitTime.
+template <typename Predicate>
+static void WaitAndRecord(std::condition_variable &Condition,
+                          std::unique_lock<std::mutex> &Lock,
+                          Predicate Ready,
+                          uint64_t &WaitCount,
+                          uint64_t &WaitTime)
+{
+    if (Ready()) { return; }
+
+    auto WaitStart = std::chrono::steady_clock::now();
+    Condition.wait(Lock, Ready);
+    WaitTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - WaitStart).count();
+    ++WaitCount;
+}
+
+FS::BufferRing::BufferRing(size_t BufferCount, size_t BufferSize)
+    : m_Buffers(BufferCount)
+    , m_BufferSize(BufferSize)
+{
+    m_Empty.Slots.resize(BufferCount);
+    m_Full.Slots.resize(BufferCount);
+    for (size_t i = 0; i < BufferCount; i++)
+    {
+        m_Buffers[i].Data = std::make_unique<unsigned char[]>(BufferSize);
+        BufferRing::Push(m_Empty, i);
+    }
+}
+
+FS::BufferRing::Buffer *FS::BufferRing::AcquireEmpty()
+{
+    std::unique_lock<std::mutex> RingLock(m_RingLock);
+    WaitAndRecord(m_RingCondition,
+                  RingLock,
+                  [this]() { return m_Cancelled || m_Empty.Count > 0; },
+                  m_Statistics.ProducerWaits,
+                  m_Statistics.ProducerWaitTime);
+    if (m_Cancelled) { return nullptr; }
+
+    Buffer *EmptyBuffer = &m_Buffers[BufferRing::Pop(m_Empty)];
+    EmptyBuffer->Size   = 0;
+    return EmptyBuffer;
+}
+
+void FS::BufferRing::PushFull(Buffer *FullBuffer)
+{
+    std::scoped_lock<std::mutex> RingLock(m_RingLock);
+    BufferRing::Push(m_Full, static_cast<size_t>(FullBuffer - m_Buffers.data()));
+    m_RingCondition.notify_all();
+}
+
+void FS::BufferRing::Close()
+{
+    // The notify happens under the lock so the consumer can't tear the ring down before this returns.
+    std::scoped_lock<std::mutex> RingLock(m_RingLock);
+    m_Closed = true;
+    m_RingCondition.notify_all();
+}
+
+FS::BufferRing::Buffer *FS::BufferRing::AcquireFull()
+{
+    std::unique_lock<std::mutex> RingLock(m_RingLock);
+    WaitAndRecord(m_RingCondition,
+                  RingLock,
+                  [this]() { return m_Full.Count > 0 || m_Closed; },
+                  m_Statistics.ConsumerWaits,
+                  m_Statistics.ConsumerWaitTime);
+    if (m_Full.Count == 0) { return nullptr; }
+
+    return &m_Buffers[BufferRing::Pop(m_Full)];
+}
+
+void FS::BufferRing::Release(Buffer *EmptyBuffer)
+{
+    std::scoped_lock<std::mutex> RingLock(m_RingLock);
+    BufferRing::Push(m_Empty, static_cast<size_t>(EmptyBuffer - m_Buffers.data()));
+    m_RingCondition.notify_all();
+}
+
+void FS::BufferRing::Cancel()
+{
+    std::scoped_lock<std::mutex> RingLock(m_RingLock);
+    m_Cancelled = true;
+    m_RingCondition.notify_all();
+}
+
+void FS::BufferRing::Finish()
+{
+    // Same as Close.
+    std::scoped_lock<std::mutex> RingLock(m_RingLock);
+    m_Finished = true;
+    m_RingCondition.notify_all();
+}
+
+void FS::BufferRing::WaitForClose()
+{
+    std::unique_lock<std::mutex> RingLock(m_RingLock);
+    m_RingCondition.wait(RingLock, [this]() { return m_Closed; });
+}
+
+void FS::BufferRing::WaitForFinish()
+{
+    std::unique_lock<std::mutex> RingLock(m_RingLock);
+    m_RingCondition.wait(RingLock, [this]() { return m_Finished; });
+}
+
+void FS::BufferRing::Reset()
+{
+    std::scoped_lock<std::mutex> RingLock(m_RingLock);
+    m_Empty.Head = m_Empty.Count = 0;
+    m_Full.Head = m_Full.Count = 0;
+    for (size_t i = 0; i < m_Buffers.size(); i++) { BufferRing::Push(m_Empty, i); }
+    m_Closed    = false;
+    m_Cancelled = false;
+    m_Finished  = false;
+}
+
+size_t FS::BufferRing::GetBufferSize() const { return m_BufferSize; }
+
+size_t FS::BufferRing::GetBufferCount() const { return m_Buffers.size(); }
+
+FS::BufferRing::Statistics FS::BufferRing::GetStatistics()
+{
+    std::scoped_lock<std::mutex> RingLock(m_RingLock);
+    return m_Statistics;
+}
+
+void FS::BufferRing::Push(IndexQueue &Queue, size_t Index)
+{
+    Queue.Slots[(Queue.Head + Queue.Count) % Queue.Slots.size()] = Index;
+    ++Queue.Count;
+}
+
+size_t FS::BufferRing::Pop(IndexQueue &Queue)
+{
+    size_t Index = Queue.Slots[Queue.Head];
+    Queue.Head   = (Queue.Head + 1) % Queue.Slots.size();
+    --Queue.Count;
+    return Index;
+}
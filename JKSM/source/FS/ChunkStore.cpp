@@ -0,0 +1,525 @@
+#include "FS/ChunkStore.hpp"
+
+#include "FS/DirectoryWalker.hpp"
+#include "FS/Hash.hpp"
+#include "FS/IO.hpp"
+#include "StringUtil.hpp"
+#include "Strings.hpp"
+#include "System/ThreadPool.hpp"
+#include "logging/logger.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace
+{
+    // Size of every chunk but the last of a file.
+    constexpr size_t CHUNK_SIZE = 0x10000;
+    // Number of chunks the read job can get ahead.
+    constexpr size_t CHUNK_BUFFER_COUNT = 4;
+    // Seed for the second half of chunk IDs.
+    constexpr uint64_t CHUNK_SEED = 0x4A4B534D43484B53;
+    // Chunks are written here first and renamed once complete so a cut off write can't leave a bad chunk behind.
+    constexpr std::u16string_view PARTIAL_CHUNK_NAME = u"._partial";
+
+    // JKSI
+    constexpr uint32_t INDEX_MAGIC = 0x49534B4A;
+    // Current revision of the index format.
+    constexpr uint8_t INDEX_REVISION = 0x01;
+
+    // Header at the beginning of index files.
+    typedef struct
+    {
+            uint32_t Magic;
+            uint8_t Revision;
+            uint32_t ChunkSize;
+            uint32_t EntryCount;
+    } __attribute__((packed)) IndexHeader;
+
+    // Each entry is this followed by PathLength UTF-16 characters and then the entry's chunk IDs.
+    typedef struct
+    {
+            uint8_t IsDirectory;
+            uint64_t Size;
+            uint16_t PathLength;
+    } __attribute__((packed)) IndexEntryHeader;
+} // namespace
+
+// Returns the number of chunks a file of Size bytes is split into.
+static inline size_t GetChunkCount(uint64_t Size) { return static_cast<size_t>((Size + CHUNK_SIZE - 1) / CHUNK_SIZE); }
+
+// Returns the ID of a chunk holding Size bytes of Data.
+static inline FS::ChunkStore::ChunkID GetChunkID(const unsigned char *Data, size_t Size)
+{
+    return {FS::Hash64::Get(Data, Size), FS::Hash64::Get(Data, Size, CHUNK_SEED)};
+}
+
+// Appends Size bytes of Data to Buffer.
+static inline void AppendBytes(std::vector<unsigned char> &Buffer, const void *Data, size_t Size)
+{
+    const unsigned char *Bytes = static_cast<const unsigned char *>(Data);
+    Buffer.insert(Buffer.end(), Bytes, Bytes + Size);
+}
+
+// Writes the 32 hex character name of ID to NameOut. NameOut must be able to hold 33 characters.
+static void GetChunkName(const FS::ChunkStore::ChunkID &ID, char16_t *NameOut)
+{
+    char Name[33] = {0};
+    std::snprintf(Name,
+                  33,
+                  "%016llX%016llX",
+                  static_cast<unsigned long long>(ID.High),
+                  static_cast<unsigned long long>(ID.Low));
+    for (int i = 0; i < 33; i++) { NameOut[i] = Name[i]; }
+}
+
+// Parses a chunk file name back to its ID. Returns false if it isn't one.
+static bool ParseChunkName(const char16_t *Name, FS::ChunkStore::ChunkID &IDOut)
+{
+    uint64_t Halves[2] = {0};
+    for (int i = 0; i < 32; i++)
+    {
+        char16_t Character = Name[i];
+        uint64_t Digit     = 0;
+        if (Character >= u'0' && Character <= u'9') { Digit = Character - u'0'; }
+        else if (Character >= u'A' && Character <= u'F') { Digit = Character - u'A' + 10; }
+        else { return false; }
+        Halves[i / 16] = Halves[i / 16] << 4 | Digit;
+    }
+    IDOut = {Halves[0], Halves[1]};
+    return Name[32] == u'\0';
+}
+
+static bool SaveIndex(const fslib::Path &IndexPath, const std::vector<FS::ChunkStore::IndexEntry> &Entries)
+{
+    // Built in memory so it's a single write.
+    std::vector<unsigned char> Buffer;
+    IndexHeader Header = {.Magic      = INDEX_MAGIC,
+                          .Revision   = INDEX_REVISION,
+                          .ChunkSize  = CHUNK_SIZE,
+                          .EntryCount = static_cast<uint32_t>(Entries.size())};
+    AppendBytes(Buffer, &Header, sizeof(IndexHeader));
+
+    for (const FS::ChunkStore::IndexEntry &CurrentEntry : Entries)
+    {
+        IndexEntryHeader EntryHeader = {.IsDirectory = CurrentEntry.IsDirectory,
+                                        .Size        = CurrentEntry.Size,
+                                        .PathLength  = static_cast<uint16_t>(CurrentEntry.Path.length())};
+        AppendBytes(Buffer, &EntryHeader, sizeof(IndexEntryHeader));
+        AppendBytes(Buffer, CurrentEntry.Path.data(), CurrentEntry.Path.length() * sizeof(char16_t));
+        AppendBytes(Buffer, CurrentEntry.Chunks.data(), CurrentEntry.Chunks.size() * sizeof(FS::ChunkStore::ChunkID));
+    }
+
+    fslib::File IndexFile(IndexPath, FS_OPEN_CREATE | FS_OPEN_WRITE, Buffer.size());
+    if (!IndexFile.is_open() || IndexFile.write(Buffer.data(), Buffer.size()) != static_cast<ssize_t>(Buffer.size()))
+    {
+        logger::log("Error writing backup index: %s", fslib::error::get_string());
+        return false;
+    }
+    return true;
+}
+
+static bool LoadIndex(const fslib::Path &IndexPath, std::vector<FS::ChunkStore::IndexEntry> &EntriesOut)
+{
+    fslib::File IndexFile(IndexPath, FS_OPEN_READ);
+    if (!IndexFile.is_open())
+    {
+        logger::log("Error opening backup index: %s", fslib::error::get_string());
+        return false;
+    }
+
+    // Read the whole thing and parse it from memory.
+    size_t IndexSize = static_cast<size_t>(IndexFile.get_size());
+    std::unique_ptr<unsigned char[]> Data(new unsigned char[IndexSize]);
+    if (IndexSize < sizeof(IndexHeader) || IndexFile.read(Data.get(), IndexSize) != static_cast<ssize_t>(IndexSize))
+    {
+        logger::log("Error reading backup index: %s", fslib::error::get_string());
+        return false;
+    }
+
+    IndexHeader Header;
+    std::memcpy(&Header, Data.get(), sizeof(IndexHeader));
+    if (Header.Magic != INDEX_MAGIC || Header.Revision != INDEX_REVISION || Header.ChunkSize != CHUNK_SIZE)
+    {
+        logger::log("Backup index is invalid or from an unsupported version.");
+        return false;
+    }
+
+    size_t Offset = sizeof(IndexHeader);
+    EntriesOut.clear();
+    EntriesOut.reserve(Header.EntryCount);
+    for (uint32_t i = 0; i < Header.EntryCount; i++)
+    {
+        IndexEntryHeader EntryHeader;
+        if (Offset + sizeof(IndexEntryHeader) > IndexSize) { return false; }
+        std::memcpy(&EntryHeader, &Data[Offset], sizeof(IndexEntryHeader));
+        Offset += sizeof(IndexEntryHeader);
+
+        size_t ChunkCount = EntryHeader.IsDirectory ? 0 : GetChunkCount(EntryHeader.Size);
+        size_t PathBytes  = EntryHeader.PathLength * sizeof(char16_t);
+        size_t ChunkBytes = ChunkCount * sizeof(FS::ChunkStore::ChunkID);
+        if (Offset + PathBytes + ChunkBytes > IndexSize)
+        {
+            logger::log("Backup index is truncated.");
+            return false;
+        }
+
+        FS::ChunkStore::IndexEntry NewEntry = {.IsDirectory = EntryHeader.IsDirectory != 0,
+                                               .Size        = EntryHeader.Size,
+                                               .Path        = std::u16string(EntryHeader.PathLength, u'\0'),
+                                               .Chunks      = std::vector<FS::ChunkStore::ChunkID>(ChunkCount)};
+        std::memcpy(NewEntry.Path.data(), &Data[Offset], PathBytes);
+        Offset += PathBytes;
+        std::memcpy(NewEntry.Chunks.data(), &Data[Offset], ChunkBytes);
+        Offset += ChunkBytes;
+
+        EntriesOut.push_back(std::move(NewEntry));
+    }
+    return true;
+}
+
+FS::ChunkStore::ChunkStore(const fslib::Path &TitlePath)
+    : m_TitlePath(TitlePath)
+    , m_StorePath(TitlePath / STORE_NAME)
+    , m_Ring(CHUNK_BUFFER_COUNT, CHUNK_SIZE)
+{
+}
+
+bool FS::ChunkStore::Backup(System::ProgressTask *Task, const fslib::Path &Source, const fslib::Path &IndexPath)
+{
+    if (!fslib::directory_exists(m_StorePath) && !fslib::create_directory(m_StorePath))
+    {
+        logger::log("Error creating chunk store: %s", fslib::error::get_string());
+        return false;
+    }
+
+    // One listing up front is a lot cheaper than checking whether every chunk exists.
+    m_KnownChunks.clear();
+    ChunkStore::ListChunks(m_KnownChunks);
+    size_t StartingChunkCount = m_KnownChunks.size();
+
+    m_Failed = false;
+    std::vector<IndexEntry> Entries;
+    ChunkStore::BackupDirectory(Task, Source, Entries);
+
+    logger::log("Chunk store: %zu new chunk(s) written.", m_KnownChunks.size() - StartingChunkCount);
+    // An index missing files would restore without them. Chunks already written are collected with the rest later.
+    if (m_Failed)
+    {
+        logger::log("Error backing up to chunk store. A file couldn't be stored, so the index wasn't written.");
+        return false;
+    }
+    return SaveIndex(IndexPath, Entries);
+}
+
+bool FS::ChunkStore::Restore(System::ProgressTask *Task,
+                             const fslib::Path &IndexPath,
+                             const fslib::Path &Destination,
+                             FS::Transaction *Transaction)
+{
+    std::vector<IndexEntry> Entries;
+    if (!LoadIndex(IndexPath, Entries)) { return false; }
+
+    // The index already has every file's size, so the whole restore's total is free.
+    if (Task)
+    {
+        uint64_t TotalSize = 0;
+        for (const IndexEntry &CurrentEntry : Entries) { TotalSize += CurrentEntry.Size; }
+        Task->SetOperationTotal(static_cast<double>(TotalSize));
+    }
+
+    // Entries are stored parents first, so directories always exist before what's in them.
+    bool Success = true;
+    for (const IndexEntry &CurrentEntry : Entries)
+    {
+        fslib::Path FullDestination = Destination / CurrentEntry.Path;
+        if (CurrentEntry.IsDirectory)
+        {
+            if (!fslib::directory_exists(FullDestination) && !fslib::create_directory(FullDestination))
+            {
+                logger::log("Error creating destination directory: %s", fslib::error::get_string());
+                Success = false;
+            }
+            continue;
+        }
+
+        if (!ChunkStore::RestoreFile(Task, CurrentEntry, FullDestination, Transaction)) { Success = false; }
+    }
+    return Success;
+}
+
+void FS::ChunkStore::Collect()
+{
+    // Gather every chunk still used by an index.
+    fslib::Directory TitleDir(m_TitlePath);
+    if (!TitleDir.is_open()) { return; }
+
+    ChunkSet UsedChunks;
+    for (uint32_t i = 0; i < TitleDir.get_count(); i++)
+    {
+        fslib::Path EntryPath = m_TitlePath / TitleDir[i];
+        if (TitleDir[i].is_directory() || EntryPath.get_extension() != INDEX_EXTENSION) { continue; }
+
+        std::vector<IndexEntry> Entries;
+        if (!LoadIndex(EntryPath, Entries))
+        {
+            // Deleting chunks an unreadable index might need isn't worth the risk.
+            logger::log("Skipping chunk collection. An index couldn't be read.");
+            return;
+        }
+
+        for (const IndexEntry &CurrentEntry : Entries)
+        {
+            UsedChunks.insert(CurrentEntry.Chunks.begin(), CurrentEntry.Chunks.end());
+        }
+    }
+
+    ChunkSet StoredChunks;
+    ChunkStore::ListChunks(StoredChunks);
+
+    size_t DeletedCount = 0;
+    for (const ChunkID &ID : StoredChunks)
+    {
+        if (UsedChunks.contains(ID)) { continue; }
+
+        if (!fslib::delete_file(ChunkStore::GetChunkPath(ID)))
+        {
+            logger::log("Error deleting unused chunk: %s", fslib::error::get_string());
+            continue;
+        }
+        ++DeletedCount;
+    }
+    logger::log("Chunk store: %zu unused chunk(s) deleted.", DeletedCount);
+}
+
+void FS::ChunkStore::BackupDirectory(System::ProgressTask *Task,
+                                     const fslib::Path &Source,
+                                     std::vector<IndexEntry> &EntriesOut)
+{
+    // The walker returns directories before what's in them, so entries end up parents first.
+    FS::DirectoryWalker Walker(Source);
+    while (Walker.Next())
+    {
+        // Same as regular copies.
+        const fslib::DirectoryEntry &Entry = Walker.GetEntry();
+        if (std::char_traits<char16_t>::compare(u"._secure_value", Entry.get_filename(), 14) == 0) { continue; }
+
+        IndexEntry NewEntry = {.IsDirectory = Entry.is_directory(),
+                               .Size        = 0,
+                               .Path        = std::u16string(Walker.GetRelativePath()),
+                               .Chunks      = {}};
+
+        if (!NewEntry.IsDirectory && !ChunkStore::BackupFile(Task, Walker.GetPath(), NewEntry))
+        {
+            m_Failed = true;
+            break;
+        }
+        EntriesOut.push_back(std::move(NewEntry));
+    }
+}
+
+bool FS::ChunkStore::BackupFile(System::ProgressTask *Task, const fslib::Path &Source, IndexEntry &EntryOut)
+{
+    fslib::File SourceFile(Source, FS_OPEN_READ);
+    if (!SourceFile.is_open())
+    {
+        logger::log("Error opening source file: %s", fslib::error::get_string());
+        return false;
+    }
+    EntryOut.Size = SourceFile.get_size();
+    EntryOut.Chunks.reserve(GetChunkCount(EntryOut.Size));
+
+    if (Task)
+    {
+        Task->SetStatus(Strings::GetStringByName(Strings::Names::CopyingFile, 0), Source.full_path());
+        Task->Reset(static_cast<double>(EntryOut.Size));
+    }
+
+    // Every buffer the read job fills is exactly one chunk.
+    FS::StartReadJob(SourceFile, m_Ring);
+
+    uint64_t BytesChunked = 0;
+    for (FS::BufferRing::Buffer *ChunkBuffer = m_Ring.AcquireFull(); ChunkBuffer; ChunkBuffer = m_Ring.AcquireFull())
+    {
+        ChunkID ID       = GetChunkID(ChunkBuffer->Data.get(), ChunkBuffer->Size);
+        bool Written     = ChunkStore::WriteChunk(ID, ChunkBuffer->Data.get(), ChunkBuffer->Size);
+        size_t ChunkSize = ChunkBuffer->Size;
+        m_Ring.Release(ChunkBuffer);
+        if (!Written)
+        {
+            m_Ring.Cancel();
+            break;
+        }
+
+        EntryOut.Chunks.push_back(ID);
+        BytesChunked += ChunkSize;
+        if (Task) { Task->SetCurrent(static_cast<double>(BytesChunked)); }
+    }
+    m_Ring.WaitForClose();
+
+    if (BytesChunked != EntryOut.Size)
+    {
+        char UTF8Buffer[0x301] = {0};
+        StringUtil::ToUTF8(Source.full_path(), UTF8Buffer, 0x301);
+        logger::log("Error chunking %s: %llu of %llu bytes stored.", UTF8Buffer, BytesChunked, EntryOut.Size);
+        return false;
+    }
+    return true;
+}
+
+bool FS::ChunkStore::WriteChunk(const ChunkID &ID, const unsigned char *Data, size_t Size)
+{
+    if (m_KnownChunks.contains(ID)) { return true; }
+
+    // Chunks are spread across 256 folders by their first byte so no single folder gets huge.
+    uint8_t Prefix = static_cast<uint8_t>(ID.High >> 56);
+    if (!m_PrefixExists[Prefix])
+    {
+        fslib::Path PrefixPath = ChunkStore::GetChunkPath(ID);
+        PrefixPath             = PrefixPath.sub_path(PrefixPath.find_last_of(u'/'));
+        if (!fslib::directory_exists(PrefixPath) && !fslib::create_directory(PrefixPath))
+        {
+            logger::log("Error creating chunk folder: %s", fslib::error::get_string());
+            return false;
+        }
+        m_PrefixExists[Prefix] = true;
+    }
+
+    fslib::Path PartialPath = m_StorePath / PARTIAL_CHUNK_NAME;
+    {
+        fslib::File ChunkFile(PartialPath, FS_OPEN_CREATE | FS_OPEN_WRITE, Size);
+        if (!ChunkFile.is_open() || ChunkFile.write(Data, Size) != static_cast<ssize_t>(Size))
+        {
+            logger::log("Error writing chunk: %s", fslib::error::get_string());
+            return false;
+        }
+    }
+
+    if (!fslib::rename_file(PartialPath, ChunkStore::GetChunkPath(ID)))
+    {
+        logger::log("Error moving chunk into store: %s", fslib::error::get_string());
+        return false;
+    }
+    m_KnownChunks.insert(ID);
+    return true;
+}
+
+bool FS::ChunkStore::RestoreFile(System::ProgressTask *Task,
+                                 const IndexEntry &Entry,
+                                 const fslib::Path &Destination,
+                                 FS::Transaction *Transaction)
+{
+    fslib::File DestinationFile(Destination, FS_OPEN_CREATE | FS_OPEN_WRITE, Entry.Size);
+    if (!DestinationFile.is_open())
+    {
+        logger::log("Error opening destination file: %s", fslib::error::get_string());
+        return false;
+    }
+
+    if (Task)
+    {
+        Task->SetStatus(Strings::GetStringByName(Strings::Names::CopyingFile, 0), Destination.full_path());
+        Task->Reset(static_cast<double>(Entry.Size));
+    }
+
+    m_Ring.Reset();
+    System::GetIOPool().Submit([this, &Entry]() { ChunkStore::ReadChunksToRing(Entry.Chunks); });
+
+    uint64_t BytesWritten = 0;
+    for (FS::BufferRing::Buffer *ChunkBuffer = m_Ring.AcquireFull(); ChunkBuffer; ChunkBuffer = m_Ring.AcquireFull())
+    {
+        ssize_t WriteCount = DestinationFile.write(ChunkBuffer->Data.get(), ChunkBuffer->Size);
+        m_Ring.Release(ChunkBuffer);
+        if (WriteCount <= 0)
+        {
+            logger::log("Error writing to file: %s", fslib::error::get_string());
+            m_Ring.Cancel();
+            break;
+        }
+
+        BytesWritten += WriteCount;
+        if (Task) { Task->SetCurrent(static_cast<double>(BytesWritten)); }
+    }
+    m_Ring.WaitForClose();
+    DestinationFile.close();
+
+    if (Transaction) { Transaction->FileWritten(BytesWritten); }
+
+    if (BytesWritten != Entry.Size)
+    {
+        char UTF8Buffer[0x301] = {0};
+        StringUtil::ToUTF8(Destination.full_path(), UTF8Buffer, 0x301);
+        logger::log("Error restoring %s: %llu of %llu bytes written.", UTF8Buffer, BytesWritten, Entry.Size);
+        return false;
+    }
+    return true;
+}
+
+void FS::ChunkStore::ReadChunksToRing(const std::vector<ChunkID> &Chunks)
+{
+    for (const ChunkID &ID : Chunks)
+    {
+        FS::BufferRing::Buffer *ChunkBuffer = m_Ring.AcquireEmpty();
+        if (!ChunkBuffer) { break; }
+
+        fslib::File ChunkFile(ChunkStore::GetChunkPath(ID), FS_OPEN_READ);
+        ssize_t BytesRead = ChunkFile.is_open() ? ChunkFile.read(ChunkBuffer->Data.get(), m_Ring.GetBufferSize()) : -1;
+        if (BytesRead <= 0)
+        {
+            logger::log("Error reading chunk: %s", fslib::error::get_string());
+            m_Ring.Release(ChunkBuffer);
+            break;
+        }
+
+        // Chunks are named after their hash, so a damaged one can be caught before it's written anywhere. The file it's part
+        // of comes up short and the restore fails.
+        ChunkID ReadID = GetChunkID(ChunkBuffer->Data.get(), static_cast<size_t>(BytesRead));
+        if (ReadID.High != ID.High || ReadID.Low != ID.Low)
+        {
+            char16_t ChunkName[33]   = {0};
+            char UTF8ChunkName[0x21] = {0};
+            GetChunkName(ID, ChunkName);
+            StringUtil::ToUTF8(ChunkName, UTF8ChunkName, 0x21);
+            logger::log("Chunk %s doesn't match its ID. The store is damaged.", UTF8ChunkName);
+            m_Ring.Release(ChunkBuffer);
+            break;
+        }
+
+        ChunkBuffer->Size = static_cast<size_t>(BytesRead);
+        m_Ring.PushFull(ChunkBuffer);
+    }
+    m_Ring.Close();
+}
+
+void FS::ChunkStore::ListChunks(ChunkSet &Chunks)
+{
+    fslib::Directory StoreDir(m_StorePath);
+    if (!StoreDir.is_open()) { return; }
+
+    for (uint32_t i = 0; i < StoreDir.get_count(); i++)
+    {
+        if (!StoreDir[i].is_directory()) { continue; }
+
+        fslib::Directory PrefixDir(m_StorePath / StoreDir[i]);
+        if (!PrefixDir.is_open()) { continue; }
+
+        for (uint32_t j = 0; j < PrefixDir.get_count(); j++)
+        {
+            ChunkID ID;
+            if (PrefixDir[j].is_directory() || !ParseChunkName(PrefixDir[j].get_filename(), ID)) { continue; }
+
+            Chunks.insert(ID);
+            m_PrefixExists[static_cast<uint8_t>(ID.High >> 56)] = true;
+        }
+    }
+}
+
+fslib::Path FS::ChunkStore::GetChunkPath(const ChunkID &ID) const
+{
+    char16_t ChunkName[33] = {0};
+    GetChunkName(ID, ChunkName);
+
+    char16_t PrefixName[3] = {ChunkName[0], ChunkName[1], u'\0'};
+    return m_StorePath / PrefixName / ChunkName;
+}
@@ -0,0 +1,107 @@
+#include "FS/CompressionPolicy.hpp"
+
+#include "logging/logger.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    // Level each method deflates at. Probes use the fast level.
+    constexpr int METHOD_LEVELS[] = {0, 1, 6};
+    constexpr int FAST_LEVEL      = METHOD_LEVELS[1];
+    // Files whose probe deflates to more than this percentage of its size are stored. Indexed by preference.
+    constexpr uint32_t STORE_RATIOS[] = {90, 95, 98};
+    // Balanced deflates files strong when the probe at least halves.
+    constexpr uint32_t BALANCED_STRONG_RATIO = 50;
+    // Probe ratio of files that weren't probed.
+    constexpr uint32_t NOT_PROBED = UINT32_MAX;
+    // Names of the methods for the log.
+    constexpr const char *METHOD_NAMES[] = {"stored", "fast", "strong"};
+} // namespace
+
+FS::CompressionPolicy::CompressionPolicy(FS::CompressionPreference Preference)
+    : m_Preference(Preference)
+{
+    // Probes are raw deflate at the fast level, the same as the fast method.
+    m_ProbeReady = deflateInit2(&m_Probe, FAST_LEVEL, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    if (!m_ProbeReady)
+    {
+        logger::log("Error initializing compression probe. Files will be deflated fast.");
+        return;
+    }
+    m_ProbeOutputSize = deflateBound(&m_Probe, PROBE_SIZE);
+    m_ProbeOutput     = std::unique_ptr<unsigned char[]>(new unsigned char[m_ProbeOutputSize]);
+}
+
+FS::CompressionPolicy::~CompressionPolicy()
+{
+    if (m_ProbeReady) { deflateEnd(&m_Probe); }
+}
+
+FS::CompressionPolicy::Method FS::CompressionPolicy::Choose(const void *Sample, size_t SampleSize, uint64_t FileSize)
+{
+    m_ProbeRatio = NOT_PROBED;
+    if (FileSize <= TINY_FILE_SIZE || SampleSize == 0) { return Method::Store; }
+    if (!m_ProbeReady || deflateReset(&m_Probe) != Z_OK) { return Method::Fast; }
+
+    size_t ProbeSize  = std::min(SampleSize, PROBE_SIZE);
+    m_Probe.next_in   = reinterpret_cast<Bytef *>(const_cast<void *>(Sample));
+    m_Probe.avail_in  = ProbeSize;
+    m_Probe.next_out  = m_ProbeOutput.get();
+    m_Probe.avail_out = m_ProbeOutputSize;
+    if (deflate(&m_Probe, Z_FINISH) != Z_STREAM_END) { return Method::Fast; }
+    m_ProbeRatio = ((m_ProbeOutputSize - m_Probe.avail_out) * 100) / ProbeSize;
+
+    if (m_ProbeRatio > STORE_RATIOS[static_cast<size_t>(m_Preference)]) { return Method::Store; }
+
+    // Speed never deflates strong and size always does. Balanced only does for files the probe at least halved.
+    if (m_Preference == FS::CompressionPreference::Speed) { return Method::Fast; }
+    else if (m_Preference == FS::CompressionPreference::Size) { return Method::Strong; }
+    return m_ProbeRatio <= BALANCED_STRONG_RATIO ? Method::Strong : Method::Fast;
+}
+
+int FS::CompressionPolicy::GetLevel(CompressionPolicy::Method Choice) { return METHOD_LEVELS[static_cast<size_t>(Choice)]; }
+
+void FS::CompressionPolicy::Record(const char *FileName,
+                                   CompressionPolicy::Method Choice,
+                                   uint64_t Size,
+                                   uint64_t CompressedSize)
+{
+    MethodTotals &Totals = m_Totals[static_cast<size_t>(Choice)];
+    ++Totals.FileCount;
+    Totals.Size += Size;
+    Totals.CompressedSize += CompressedSize;
+
+    uint64_t Ratio = Size > 0 ? (CompressedSize * 100) / Size : 100;
+    if (m_ProbeRatio == NOT_PROBED)
+    {
+        logger::log("%s: %s without probing, %llu -> %llu bytes (%llu%%).",
+                    FileName,
+                    METHOD_NAMES[static_cast<size_t>(Choice)],
+                    Size,
+                    CompressedSize,
+                    Ratio);
+        return;
+    }
+    logger::log("%s: %s after probing to %u%%, %llu -> %llu bytes (%llu%%).",
+                FileName,
+                METHOD_NAMES[static_cast<size_t>(Choice)],
+                m_ProbeRatio,
+                Size,
+                CompressedSize,
+                Ratio);
+}
+
+void FS::CompressionPolicy::LogTotals() const
+{
+    for (size_t i = 0; i < 3; i++)
+    {
+        if (m_Totals[i].FileCount == 0) { continue; }
+        logger::log("ZIP compression: %u file(s) %s, %llu -> %llu bytes (%llu%%).",
+                    m_Totals[i].FileCount,
+                    METHOD_NAMES[i],
+                    m_Totals[i].Size,
+                    m_Totals[i].CompressedSize,
+                    m_Totals[i].Size > 0 ? (m_Totals[i].CompressedSize * 100) / m_Totals[i].Size : 100);
+    }
+}
@@ -0,0 +1,113 @@
+#include "FS/DirectoryWalker.hpp"
+
+#include "logging/logger.hpp"
+
+#include <algorithm>
+
+// Rough cost of a queued directory. It's only used to keep the queue under its limit.
+static inline size_t GetQueueCost(size_t PathLength, size_t NameLength = 0)
+{
+    return sizeof(std::u16string) * 2 + sizeof(uint32_t) + (PathLength + NameLength) * 2;
+}
+
+FS::DirectoryWalker::DirectoryWalker(const fslib::Path &Root, size_t QueueLimit)
+    : m_Current(Root)
+    , m_QueueLimit(QueueLimit)
+{
+    DirectoryWalker::OpenListing(std::u16string_view(Root.full_path(), Root.get_length()), std::u16string_view(), 0);
+}
+
+bool FS::DirectoryWalker::Next()
+{
+    if (m_WalkCurrent)
+    {
+        m_WalkCurrent = false;
+
+        const fslib::Path &CurrentPath = m_Current.GetPath();
+        std::u16string_view CurrentView(CurrentPath.full_path(), CurrentPath.get_length());
+        if (m_QueueSize + GetQueueCost(CurrentView.length()) <= m_QueueLimit)
+        {
+            DirectoryWalker::Push(CurrentView, std::u16string_view(), 0);
+        }
+        else
+        {
+            // Queue is full. Remember where this listing was and walk the directory now. The caller can delete entries from
+            // the listing while it's walked, so where to resume is remembered by the directory's name too.
+            DirectoryWalker::Push(std::u16string_view(m_ListingPath.full_path(), m_ListingPath.get_length()),
+                                  m_Listing[m_Index - 1].get_filename(),
+                                  m_Index);
+            DirectoryWalker::OpenListing(CurrentView, std::u16string_view(), 0);
+        }
+    }
+
+    while (!m_Listing.is_open() || m_Index >= m_Listing.get_count())
+    {
+        if (m_Queue.empty())
+        {
+            m_Listing.close();
+            return false;
+        }
+
+        QueuedDirectory NextDirectory = std::move(m_Queue.back());
+        m_Queue.pop_back();
+        m_QueueSize -= GetQueueCost(NextDirectory.Path.length(), NextDirectory.ResumeName.length());
+
+        DirectoryWalker::OpenListing(NextDirectory.Path, NextDirectory.ResumeName, NextDirectory.ResumeIndex);
+    }
+
+    // The listing's path is still at the front of the buffer. Only the name changes.
+    const fslib::DirectoryEntry &Entry = m_Listing[m_Index++];
+    m_Current.Truncate(m_ListingLength);
+    m_Current.Append(Entry.get_filename());
+    m_WalkCurrent = Entry.is_directory();
+    return true;
+}
+
+void FS::DirectoryWalker::SkipCurrent() { m_WalkCurrent = false; }
+
+const fslib::DirectoryEntry &FS::DirectoryWalker::GetEntry() const { return m_Listing[m_Index - 1]; }
+
+const fslib::Path &FS::DirectoryWalker::GetPath() { return m_Current.GetPath(); }
+
+std::u16string_view FS::DirectoryWalker::GetRelativePath() const { return m_Current.GetRelativePath(); }
+
+const char *FS::DirectoryWalker::GetUTF8() { return m_Current.GetUTF8(); }
+
+size_t FS::DirectoryWalker::GetPeakQueueSize() const { return m_PeakQueueSize; }
+
+void FS::DirectoryWalker::Push(std::u16string_view Path, std::u16string_view ResumeName, uint32_t ResumeIndex)
+{
+    m_Queue.push_back(
+        {.Path = std::u16string(Path), .ResumeName = std::u16string(ResumeName), .ResumeIndex = ResumeIndex});
+    m_QueueSize += GetQueueCost(Path.length(), ResumeName.length());
+    m_PeakQueueSize = std::max(m_PeakQueueSize, m_QueueSize);
+}
+
+void FS::DirectoryWalker::OpenListing(std::u16string_view Path, std::u16string_view ResumeName, uint32_t Index)
+{
+    // Path can point into the current entry's buffer, so it's copied to the listing's path before the buffer changes.
+    m_ListingPath   = Path;
+    m_ListingLength = m_ListingPath.get_length();
+    m_Index         = Index;
+    m_Current.Assign(std::u16string_view(m_ListingPath.full_path(), m_ListingLength));
+
+    m_Listing.close();
+    m_Listing.open(m_ListingPath);
+    if (!m_Listing.is_open())
+    {
+        logger::log("Error opening directory: %s", fslib::error::get_string());
+        return;
+    }
+
+    // Entries deleted before the one the walk left from shift it towards the front, so it's looked for from where it was
+    // back. Nothing else can move it and the walk went into it, so it's still there.
+    if (ResumeName.empty()) { return; }
+    for (uint32_t i = std::min(Index, m_Listing.get_count()); i > 0; i--)
+    {
+        if (ResumeName == m_Listing[i - 1].get_filename())
+        {
+            m_Index = i;
+            return;
+        }
+    }
+}
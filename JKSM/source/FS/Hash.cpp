@@ -0,0 +1,146 @@
+#include "FS/Hash.hpp"
+
+#include <cstring>
+
+namespace
+{
+    // xxHash64 primes.
+    constexpr uint64_t PRIME_1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t PRIME_3 = 0x165667B19E3779F9ULL;
+    constexpr uint64_t PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+    constexpr uint64_t PRIME_5 = 0x27D4EB2F165667C5ULL;
+} // namespace
+
+static inline uint64_t RotateLeft(uint64_t Value, int Count) { return (Value << Count) | (Value >> (64 - Count)); }
+
+// The 3DS and any host this is built on are little endian, so these are plain loads.
+static inline uint64_t Read64(const unsigned char *Data)
+{
+    uint64_t Value;
+    std::memcpy(&Value, Data, sizeof(uint64_t));
+    return Value;
+}
+
+static inline uint32_t Read32(const unsigned char *Data)
+{
+    uint32_t Value;
+    std::memcpy(&Value, Data, sizeof(uint32_t));
+    return Value;
+}
+
+static inline uint64_t Round(uint64_t Accumulator, uint64_t Input)
+{
+    Accumulator += Input * PRIME_2;
+    Accumulator = RotateLeft(Accumulator, 31);
+    return Accumulator * PRIME_1;
+}
+
+static inline uint64_t MergeRound(uint64_t Hash, uint64_t Accumulator)
+{
+    Hash ^= Round(0, Accumulator);
+    return Hash * PRIME_1 + PRIME_4;
+}
+
+FS::Hash64::Hash64(uint64_t Seed)
+    : m_Accumulators{Seed + PRIME_1 + PRIME_2, Seed + PRIME_2, Seed, Seed - PRIME_1}
+    , m_Seed(Seed) {};
+
+void FS::Hash64::Update(const void *Data, size_t Length)
+{
+    const unsigned char *Input = static_cast<const unsigned char *>(Data);
+    m_TotalLength += Length;
+
+    // Finish off the partial stripe from the last call first.
+    if (m_StripeLength > 0)
+    {
+        size_t Needed = 32 - m_StripeLength;
+        if (Length < Needed)
+        {
+            std::memcpy(&m_Stripe[m_StripeLength], Input, Length);
+            m_StripeLength += Length;
+            return;
+        }
+        std::memcpy(&m_Stripe[m_StripeLength], Input, Needed);
+        for (int i = 0; i < 4; i++) { m_Accumulators[i] = Round(m_Accumulators[i], Read64(&m_Stripe[i * 8])); }
+        Input += Needed;
+        Length -= Needed;
+        m_StripeLength = 0;
+    }
+
+    // Main loop. Locals so the compiler can keep these in registers.
+    uint64_t Accumulator1 = m_Accumulators[0];
+    uint64_t Accumulator2 = m_Accumulators[1];
+    uint64_t Accumulator3 = m_Accumulators[2];
+    uint64_t Accumulator4 = m_Accumulators[3];
+    for (; Length >= 32; Input += 32, Length -= 32)
+    {
+        Accumulator1 = Round(Accumulator1, Read64(Input));
+        Accumulator2 = Round(Accumulator2, Read64(Input + 8));
+        Accumulator3 = Round(Accumulator3, Read64(Input + 16));
+        Accumulator4 = Round(Accumulator4, Read64(Input + 24));
+    }
+    m_Accumulators[0] = Accumulator1;
+    m_Accumulators[1] = Accumulator2;
+    m_Accumulators[2] = Accumulator3;
+    m_Accumulators[3] = Accumulator4;
+
+    // Save whatever is left for next time.
+    if (Length > 0)
+    {
+        std::memcpy(m_Stripe, Input, Length);
+        m_StripeLength = Length;
+    }
+}
+
+uint64_t FS::Hash64::Finish() const
+{
+    uint64_t Hash = 0;
+    if (m_TotalLength >= 32)
+    {
+        Hash = RotateLeft(m_Accumulators[0], 1) + RotateLeft(m_Accumulators[1], 7) + RotateLeft(m_Accumulators[2], 12) +
+               RotateLeft(m_Accumulators[3], 18);
+        for (int i = 0; i < 4; i++) { Hash = MergeRound(Hash, m_Accumulators[i]); }
+    }
+    else { Hash = m_Seed + PRIME_5; }
+
+    Hash += m_TotalLength;
+
+    // Tail.
+    const unsigned char *Input = m_Stripe;
+    size_t Length              = m_StripeLength;
+    for (; Length >= 8; Input += 8, Length -= 8)
+    {
+        Hash ^= Round(0, Read64(Input));
+        Hash = RotateLeft(Hash, 27) * PRIME_1 + PRIME_4;
+    }
+
+    if (Length >= 4)
+    {
+        Hash ^= static_cast<uint64_t>(Read32(Input)) * PRIME_1;
+        Hash = RotateLeft(Hash, 23) * PRIME_2 + PRIME_3;
+        Input += 4;
+        Length -= 4;
+    }
+
+    for (; Length > 0; Input++, Length--)
+    {
+        Hash ^= (*Input) * PRIME_5;
+        Hash = RotateLeft(Hash, 11) * PRIME_1;
+    }
+
+    // Avalanche.
+    Hash ^= Hash >> 33;
+    Hash *= PRIME_2;
+    Hash ^= Hash >> 29;
+    Hash *= PRIME_3;
+    Hash ^= Hash >> 32;
+    return Hash;
+}
+
+uint64_t FS::Hash64::Get(const void *Data, size_t Length, uint64_t Seed)
+{
+    FS::Hash64 Hash(Seed);
+    Hash.Update(Data, Length);
+    return Hash.Finish();
+}
@@ -1,337 +1,1912 @@
 #include "FS/IO.hpp"
 
-#include "FS/SaveMount.hpp"
+#include "FS/BlockDeflater.hpp"
+#include "FS/CompressionPolicy.hpp"
+#include "FS/DirectoryWalker.hpp"
+#include "FS/Hash.hpp"
+#include "FS/PathBuilder.hpp"
 #include "StringUtil.hpp"
 #include "Strings.hpp"
+#include "System/ThreadPool.hpp"
 #include "logging/logger.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <condition_variable>
 #include <cstring>
 #include <ctime>
 #include <memory>
 #include <mutex>
+#include <unordered_map>
 #include <vector>
 
 namespace
 {
     // Buffer size used for reading and writing files.
     constexpr size_t FILE_BUFFER_SIZE = 0x10000;
-    // This is the struct the threads share so they can coordinate with eachother.
+    // Number of buffers in the copy ring. This is how many chunks the read job can get ahead of the writes.
+    constexpr size_t FILE_BUFFER_COUNT = 4;
+    // Bytes of a large file copied between journal progress records.
+    constexpr uint64_t JOURNAL_PROGRESS_INTERVAL = 0x400000;
+    // Files this size or smaller are read in one call and written in batches instead of going through the ring.
+    constexpr size_t SMALL_FILE_LIMIT = 0x4000;
+    // Size of the buffer small files are batched in.
+    constexpr size_t SMALL_FILE_BATCH_SIZE = 0x40000;
+    // Most large files copied at the same time and the most memory their rings can use combined.
+    constexpr size_t MAX_COPY_WORKERS   = 4;
+    constexpr size_t COPY_MEMORY_BUDGET = 0x100000;
+    // Blocks of zeros this size are left out of large files copied to backups. Blocks are counted from the start of the file.
+    constexpr size_t ZERO_BLOCK_SIZE = 0x4000;
+
+    // Number of large files directory copies write at once.
+    size_t s_CopyWorkerCount = 1;
+    // Whether small files are batched.
+    bool s_SmallFileBatching = true;
+    // Zero runs are written back from this. It's never written to.
+    unsigned char s_ZeroBuffer[FILE_BUFFER_SIZE] = {0};
+
+    // Runs of zeros left out of a stored file.
+    typedef std::vector<FS::Manifest::ZeroRun> ZeroRunList;
+
+    // A small file waiting in the batch buffer to be written. Its path relative to the destination is stored in the batch's
+    // path buffer.
+    typedef struct
+    {
+            size_t PathOffset;
+            size_t PathLength;
+            size_t Offset;
+            size_t Size;
+            uint64_t Hash;
+    } BatchedFile;
+
+    // Number of times something was timed, the total and the worst. Times are in microseconds.
+    typedef struct
+    {
+            uint64_t Count;
+            uint64_t Total;
+            uint64_t Max;
+    } Timing;
+
+    // What a copy did and where it spent its time. It's logged once the operation is finished.
+    typedef struct
+    {
+            std::chrono::steady_clock::time_point StartTime;
+            uint32_t FilesWritten;
+            uint64_t BytesWritten;
+            Timing Opens;
+            Timing Closes;
+            // Most memory the directory walker's queue used.
+            size_t PeakQueueSize;
+            // Zeros left out of stored files or written back from zero runs instead of being copied.
+            uint64_t ZeroBytes;
+            // Transaction's totals when the copy started.
+            uint32_t CommitCount;
+            uint64_t CommitTime;
+    } CopyStatistics;
+
+    // A large file being copied by one of the parallel copy workers. Every slot has its own ring.
     typedef struct
     {
-            // Protect buffer from corruption.
-            std::mutex BufferMutex;
-            std::condition_variable BufferCondition;
-            bool BufferIsFull = false;
-            // This is the buffer read into.
-            std::unique_ptr<unsigned char[]> SharedBuffer;
-            // The main thread needs to know these to write.
-            size_t BytesRead = 0;
-    } SharedThreadData;
+            FS::BufferRing Ring;
+            fslib::File SourceFile;
+            fslib::Path Source;
+            fslib::Path Destination;
+            ZeroRunList ZeroRuns;
+    } CopySlot;
+
+    // Large files being copied at the same time. Lock guards the free slots and everything in CopyState the workers share.
+    // Every slot has to be free again before this is freed.
+    typedef struct
+    {
+            std::vector<std::unique_ptr<CopySlot>> Slots;
+            std::vector<CopySlot *> FreeSlots;
+            std::mutex Lock;
+            std::condition_variable SlotFreed;
+    } ParallelCopy;
+
+    // Everything a directory to directory copy needs that's shared across the whole tree.
+    typedef struct
+    {
+            System::ProgressTask *Task;
+            FS::Transaction *Transaction;
+            FS::BufferRing Ring;
+            // Small file batch.
+            std::unique_ptr<unsigned char[]> BatchBuffer;
+            size_t BatchUsed;
+            std::vector<BatchedFile> BatchedFiles;
+            // Relative paths of the batched files back to back and the builder their destinations are opened through when
+            // it's flushed. Both are reused so batching doesn't allocate once they're big enough.
+            std::u16string BatchPaths;
+            FS::PathBuilder BatchDestination;
+            // Manifest of the previous backup and its name. Files matching it aren't copied. nullptr for a full copy.
+            const FS::Manifest *Previous;
+            std::u16string_view PreviousName;
+            // Manifest files are recorded to. nullptr if they aren't.
+            FS::Manifest *ManifestOut;
+            // Length of the source root. Paths in manifests are relative to it.
+            size_t RootLength;
+            // Whether files already in the destination are compared before being written. CompareBuffer holds the
+            // destination's data for it.
+            bool Differential;
+            std::unique_ptr<unsigned char[]> CompareBuffer;
+            // Bytes that matched and didn't need to be written.
+            uint64_t BytesMatched;
+            // Journal finished files are recorded to so an interrupted copy can be resumed. nullptr if there isn't one.
+            FS::Journal *Journal;
+            // Manifest the data is checked against and whether written files are read back. Files checked and how many of
+            // them didn't match are counted.
+            const FS::Manifest *Expected;
+            bool ReadBack;
+            uint32_t FilesVerified;
+            uint32_t VerifyFailures;
+            CopyStatistics Statistics;
+            // Large files being copied at the same time. nullptr if files are copied one at a time.
+            std::unique_ptr<ParallelCopy> Parallel;
+            // Zero runs of the large file being copied when files are copied one at a time.
+            ZeroRunList ZeroRuns;
+            // Manifest of the backup being restored. The zero runs its files were stored without are written back. nullptr if
+            // there isn't one.
+            const FS::Manifest *Stored;
+    } CopyState;
+
+    // Entry in the ZIP a new one is replacing. Offset is where it is in the central directory.
+    typedef struct
+    {
+            uint32_t Crc;
+            uint64_t Size;
+            uint64_t Offset;
+    } PreviousZipEntry;
+
+    // ZIP a new one is replacing. Files with the same size and CRC as their entry in it are copied over without inflating or
+    // deflating them again.
+    typedef struct
+    {
+            unzFile Zip;
+            std::unordered_map<std::string, PreviousZipEntry> Entries;
+            // Compressed data is copied through this.
+            std::unique_ptr<unsigned char[]> Buffer;
+            uint32_t FilesCopied;
+            uint64_t BytesCopied;
+    } PreviousZip;
 } // namespace
 
-void ReadThreadFunction(fslib::File &SourceFile, SharedThreadData &Data)
+// Declarations. Definitions follow.
+static void CopyDirectory(CopyState &State, const fslib::Path &Source, const fslib::Path &Destination);
+static void FlushSmallFiles(CopyState &State);
+static void DeleteStaleEntries(CopyState &State,
+                               const fslib::Path &Source,
+                               const fslib::Path &Destination,
+                               const FS::Manifest *Keep,
+                               uint32_t &DeletedCount);
+static bool CopyLargeFile(CopyState &State,
+                          FS::BufferRing &Ring,
+                          fslib::File &SourceFile,
+                          const fslib::Path &FullSource,
+                          const fslib::Path &Destination,
+                          ZeroRunList &ZeroRuns,
+                          uint64_t &HashOut);
+static uint64_t HashFile(FS::BufferRing &Ring, fslib::File &SourceFile, const ZeroRunList *ZeroRuns);
+
+static bool CopyDirectoryToZipWithRing(System::ProgressTask *Task,
+                                       const fslib::Path &Source,
+                                       zipFile Destination,
+                                       FS::BufferRing &Ring,
+                                       FS::BlockDeflater &Deflater,
+                                       FS::CompressionPolicy &Policy,
+                                       PreviousZip *Previous);
+
+// This is the job sent to the I/O pool to read a file into the ring.
+static void ReadFileToRing(fslib::File &SourceFile, FS::BufferRing &Ring)
 {
-    // Record file size for loop.
-    uint64_t FileSize = SourceFile.get_size();
+    // Record what's left of the file for loop. Resumed copies don't start at the beginning.
+    uint64_t FileSize = SourceFile.get_size() - SourceFile.tell();
 
-    // Loop until entire file is read.
+    // Loop until entire file is read or the writer tells us to stop.
     for (uint64_t TotalRead = 0; TotalRead < FileSize;)
     {
-        // Read from source
-        Data.BytesRead = SourceFile.read(Data.SharedBuffer.get(), FILE_BUFFER_SIZE);
-        if (Data.BytesRead == 0)
+        FS::BufferRing::Buffer *ReadBuffer = Ring.AcquireEmpty();
+        if (!ReadBuffer) { break; }
+
+        // Read straight into the buffer. It's handed to the writer as-is.
+        ssize_t BytesRead = SourceFile.read(ReadBuffer->Data.get(), Ring.GetBufferSize());
+        if (BytesRead <= 0)
         {
             logger::log("Error reading from file: %s", fslib::error::get_string());
-            // To do: Handle this better if it occurs.
+            Ring.Release(ReadBuffer);
+            break;
+        }
+
+        // Update loop count and pass the buffer on.
+        TotalRead += BytesRead;
+        ReadBuffer->Size = static_cast<size_t>(BytesRead);
+        Ring.PushFull(ReadBuffer);
+    }
+    // Let the writer know nothing else is coming.
+    Ring.Close();
+}
+
+void FS::StartReadJob(fslib::File &SourceFile, FS::BufferRing &Ring)
+{
+    Ring.Reset();
+    System::GetIOPool().Submit([&SourceFile, &Ring]() { ReadFileToRing(SourceFile, Ring); });
+}
+
+// This is the job sent to the I/O pool to write what's pushed to the ring to a file. Hash gets everything written if it isn't
+// nullptr. FailedOut is set if a write fails.
+static void WriteRingToFile(FS::BufferRing &Ring, fslib::File &DestinationFile, FS::Hash64 *Hash, bool &FailedOut)
+{
+    for (FS::BufferRing::Buffer *WriteBuffer = Ring.AcquireFull(); WriteBuffer; WriteBuffer = Ring.AcquireFull())
+    {
+        bool Written = DestinationFile.write(WriteBuffer->Data.get(), WriteBuffer->Size) ==
+                       static_cast<ssize_t>(WriteBuffer->Size);
+        if (Written && Hash) { Hash->Update(WriteBuffer->Data.get(), WriteBuffer->Size); }
+        Ring.Release(WriteBuffer);
+        if (!Written)
+        {
+            logger::log("Error writing to file: %s", fslib::error::get_string());
+            FailedOut = true;
+            Ring.Cancel();
+            break;
+        }
+    }
+    Ring.Finish();
+}
+
+// Resets Ring and queues a job on the I/O pool that writes it to DestinationFile. The producer has to wait for the job with
+// WaitForFinish once it closes the ring.
+static void StartWriteJob(fslib::File &DestinationFile, FS::BufferRing &Ring, FS::Hash64 *Hash, bool &FailedOut)
+{
+    Ring.Reset();
+    System::GetIOPool().Submit(
+        [&DestinationFile, &Ring, Hash, &FailedOut]() { WriteRingToFile(Ring, DestinationFile, Hash, FailedOut); });
+}
+
+void FS::GetDirectoryTotals(const fslib::Path &Source, FS::DirectoryTotals &TotalsOut)
+{
+    auto ScanStart = std::chrono::steady_clock::now();
+
+    // Files the copies skip are skipped here too.
+    TotalsOut = {.FileCount = 0, .TotalSize = 0};
+    FS::DirectoryWalker Walker(Source);
+    while (Walker.Next())
+    {
+        const fslib::DirectoryEntry &Entry = Walker.GetEntry();
+        if (Entry.is_directory()) { continue; }
+        if (std::char_traits<char16_t>::compare(u"._secure_value", Entry.get_filename(), 14) == 0) { continue; }
+        if (FS::Manifest::FILE_NAME == Entry.get_filename()) { continue; }
+
+        ++TotalsOut.FileCount;
+        TotalsOut.TotalSize += Entry.get_size();
+    }
+
+    uint64_t ScanTime =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - ScanStart).count();
+    logger::log("Pre-scan found %u files totaling %llu bytes in %lluus.", TotalsOut.FileCount, TotalsOut.TotalSize, ScanTime);
+}
+
+// Returns statistics for a copy starting now.
+static CopyStatistics StartStatistics(FS::Transaction *Transaction)
+{
+    return {.StartTime     = std::chrono::steady_clock::now(),
+            .FilesWritten  = 0,
+            .BytesWritten  = 0,
+            .Opens         = {0, 0, 0},
+            .Closes        = {0, 0, 0},
+            .PeakQueueSize = 0,
+            .ZeroBytes     = 0,
+            .CommitCount   = Transaction ? Transaction->GetCommitCount() : 0,
+            .CommitTime    = Transaction ? Transaction->GetCommitTime() : 0};
+}
+
+// Locks what parallel copies share. Nothing needs to be locked when files are copied one at a time.
+static inline std::unique_lock<std::mutex> LockShared(CopyState &State)
+{
+    if (!State.Parallel) { return std::unique_lock<std::mutex>(); }
+    return std::unique_lock<std::mutex>(State.Parallel->Lock);
+}
+
+// Adds the time since Start to TimingOut.
+static void RecordTiming(CopyState &State, Timing &TimingOut, std::chrono::steady_clock::time_point Start)
+{
+    uint64_t Elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - Start).count();
+    auto SharedLock  = LockShared(State);
+    ++TimingOut.Count;
+    TimingOut.Total += Elapsed;
+    TimingOut.Max = std::max(TimingOut.Max, Elapsed);
+}
+
+// Logs what the copy did and where it spent its time. Reader waits are the read job waiting for the writer to hand back a
+// buffer. Writer waits are the writer waiting for data to be read.
+static void LogCopyStatistics(const char *Operation, CopyState &State)
+{
+    const CopyStatistics &Statistics = State.Statistics;
+    FS::BufferRing::Statistics Ring  = State.Ring.GetStatistics();
+    if (State.Parallel)
+    {
+        for (std::unique_ptr<CopySlot> &Slot : State.Parallel->Slots)
+        {
+            FS::BufferRing::Statistics SlotRing = Slot->Ring.GetStatistics();
+            Ring.ProducerWaits += SlotRing.ProducerWaits;
+            Ring.ProducerWaitTime += SlotRing.ProducerWaitTime;
+            Ring.ConsumerWaits += SlotRing.ConsumerWaits;
+            Ring.ConsumerWaitTime += SlotRing.ConsumerWaitTime;
         }
+    }
+
+    auto Elapsed         = std::chrono::steady_clock::now() - Statistics.StartTime;
+    uint64_t ElapsedTime = std::chrono::duration_cast<std::chrono::microseconds>(Elapsed).count();
+    double Rate          = ElapsedTime > 0 ? static_cast<double>(Statistics.BytesWritten) / ElapsedTime : 0;
 
-        // Update loop count
-        TotalRead += Data.BytesRead;
+    logger::log("%s: %u files, %llu bytes in %llums (%.2f MB/s). %zu large files copied at once.",
+                Operation,
+                Statistics.FilesWritten,
+                Statistics.BytesWritten,
+                ElapsedTime / 1000,
+                Rate * 1000000.0f / 1048576.0f,
+                State.Parallel ? State.Parallel->Slots.size() : 1);
+    logger::log("%s: reader waited %llu times for %lluus. Writer waited %llu times for %lluus.",
+                Operation,
+                Ring.ProducerWaits,
+                Ring.ProducerWaitTime,
+                Ring.ConsumerWaits,
+                Ring.ConsumerWaitTime);
+    logger::log("%s: opens average %lluus, worst %lluus. Closes average %lluus, worst %lluus. Directory queue peaked at %zu "
+                "bytes.",
+                Operation,
+                Statistics.Opens.Count > 0 ? Statistics.Opens.Total / Statistics.Opens.Count : 0,
+                Statistics.Opens.Max,
+                Statistics.Closes.Count > 0 ? Statistics.Closes.Total / Statistics.Closes.Count : 0,
+                Statistics.Closes.Max,
+                Statistics.PeakQueueSize);
 
-        // Signal to other thread it can copy and write the buffer.
-        Data.BufferIsFull = true;
-        Data.BufferCondition.notify_one();
+    if (Statistics.ZeroBytes > 0)
+    {
+        logger::log("%s: %llu bytes of zeros weren't copied.", Operation, Statistics.ZeroBytes);
+    }
+    if (State.FilesVerified > 0)
+    {
+        logger::log("%s: %u files verified, %u failed.", Operation, State.FilesVerified, State.VerifyFailures);
+    }
 
-        // Wait until buffer is "empty" again.
-        std::unique_lock<std::mutex> BufferLock(Data.BufferMutex);
-        Data.BufferCondition.wait(BufferLock, [&Data]() { return Data.BufferIsFull == false; });
+    if (State.Transaction)
+    {
+        logger::log("%s: %u commits took %lluus.",
+                    Operation,
+                    State.Transaction->GetCommitCount() - Statistics.CommitCount,
+                    State.Transaction->GetCommitTime() - Statistics.CommitTime);
     }
 }
 
+// Starts the I/O pool's statistics over for an operation. Only one operation runs at a time, so they're the operation's own.
+static inline void BeginPoolWait() { System::GetIOPool().ResetStatistics(); }
+
+// Logs how long this operation's jobs sat in the pool's queue.
+static void LogPoolWait(const char *Operation)
+{
+    System::ThreadPool::Statistics Statistics = System::GetIOPool().GetStatistics();
+    if (Statistics.JobCount == 0) { return; }
+
+    logger::log("%s: %llu I/O jobs, average queue wait %lluus, worst %lluus.",
+                Operation,
+                Statistics.JobCount,
+                Statistics.TotalWaitTime / Statistics.JobCount,
+                Statistics.MaxWaitTime);
+}
+
+// Returns the length of Root plus the slash following it if Root doesn't end with one. Relative paths start here.
+static inline size_t GetRootLength(const fslib::Path &Root)
+{
+    size_t RootLength = Root.get_length();
+    return Root.full_path()[RootLength - 1] == u'/' ? RootLength : RootLength + 1;
+}
+
+// Returns the pool parallel copies run on. It's created the first time it's needed and kept so every copy uses the same
+// workers. They're on the New 3DS's extra core when there is one.
+static System::ThreadPool &GetCopyPool()
+{
+    static System::ThreadPool CopyPool(MAX_COPY_WORKERS, System::GetWorkerCore());
+    return CopyPool;
+}
+
+// Sets up the slots for parallel copies if they're enabled. Save archives that need a transaction always copy one file at a
+// time since everything written to them is committed together.
+static std::unique_ptr<ParallelCopy> StartParallelCopies(FS::Transaction *Transaction)
+{
+    size_t SlotCount =
+        std::min({s_CopyWorkerCount, MAX_COPY_WORKERS, COPY_MEMORY_BUDGET / (FILE_BUFFER_COUNT * FILE_BUFFER_SIZE)});
+    if (Transaction || SlotCount < 2) { return nullptr; }
+
+    std::unique_ptr<ParallelCopy> Parallel = std::make_unique<ParallelCopy>();
+    for (size_t i = 0; i < SlotCount; i++)
+    {
+        Parallel->Slots.emplace_back(new CopySlot{.Ring        = FS::BufferRing(FILE_BUFFER_COUNT, FILE_BUFFER_SIZE),
+                                                  .SourceFile  = {},
+                                                  .Source      = {},
+                                                  .Destination = {},
+                                                  .ZeroRuns    = {}});
+        Parallel->FreeSlots.push_back(Parallel->Slots.back().get());
+    }
+    return Parallel;
+}
+
+void FS::SetCopyWorkerCount(size_t WorkerCount) { s_CopyWorkerCount = WorkerCount; }
+
+size_t FS::GetCopyWorkerCount() { return std::min(s_CopyWorkerCount, MAX_COPY_WORKERS); }
+
+void FS::SetSmallFileBatching(bool Enabled) { s_SmallFileBatching = Enabled; }
+
 void FS::CopyDirectoryToDirectory(System::ProgressTask *Task,
                                   const fslib::Path &Source,
                                   const fslib::Path &Destination,
-                                  bool Commit)
+                                  FS::Transaction *Transaction,
+                                  FS::Journal *Journal,
+                                  const FS::Manifest *Stored,
+                                  const FS::Verification *Verify)
+{
+    BeginPoolWait();
+
+    // The ring and batch buffer are allocated once and reused for every file in the tree.
+    CopyState State = {.Task             = Task,
+                       .Transaction      = Transaction,
+                       .Ring             = FS::BufferRing(FILE_BUFFER_COUNT, FILE_BUFFER_SIZE),
+                       .BatchBuffer      = std::make_unique<unsigned char[]>(SMALL_FILE_BATCH_SIZE),
+                       .BatchUsed        = 0,
+                       .BatchedFiles     = {},
+                       .BatchPaths       = {},
+                       .BatchDestination = FS::PathBuilder(Destination),
+                       .Previous         = nullptr,
+                       .PreviousName     = {},
+                       .ManifestOut      = nullptr,
+                       .RootLength       = GetRootLength(Source),
+                       .Differential     = false,
+                       .CompareBuffer    = nullptr,
+                       .BytesMatched     = 0,
+                       .Journal          = Journal,
+                       .Expected         = Verify ? Verify->Expected : nullptr,
+                       .ReadBack         = Verify && Verify->ReadBack,
+                       .FilesVerified    = 0,
+                       .VerifyFailures   = 0,
+                       .Statistics       = StartStatistics(Transaction),
+                       .Parallel         = StartParallelCopies(Transaction),
+                       .ZeroRuns         = {},
+                       .Stored           = Stored};
+    CopyDirectory(State, Source, Destination);
+    // Write whatever small files are left over.
+    FlushSmallFiles(State);
+
+    LogCopyStatistics("CopyDirectoryToDirectory", State);
+    LogPoolWait("CopyDirectoryToDirectory");
+}
+
+void FS::CopyDirectoryToBackup(System::ProgressTask *Task,
+                               const fslib::Path &Source,
+                               const fslib::Path &Destination,
+                               const FS::Manifest *Previous,
+                               std::u16string_view PreviousName,
+                               FS::Manifest &ManifestOut,
+                               FS::Journal *Journal,
+                               const FS::Verification *Verify)
+{
+    BeginPoolWait();
+
+    CopyState State = {.Task             = Task,
+                       .Transaction      = nullptr,
+                       .Ring             = FS::BufferRing(FILE_BUFFER_COUNT, FILE_BUFFER_SIZE),
+                       .BatchBuffer      = std::make_unique<unsigned char[]>(SMALL_FILE_BATCH_SIZE),
+                       .BatchUsed        = 0,
+                       .BatchedFiles     = {},
+                       .BatchPaths       = {},
+                       .BatchDestination = FS::PathBuilder(Destination),
+                       .Previous         = Previous,
+                       .PreviousName     = PreviousName,
+                       .ManifestOut      = &ManifestOut,
+                       .RootLength       = GetRootLength(Source),
+                       .Differential     = false,
+                       .CompareBuffer    = nullptr,
+                       .BytesMatched     = 0,
+                       .Journal          = Journal,
+                       .Expected         = nullptr,
+                       .ReadBack         = Verify && Verify->ReadBack,
+                       .FilesVerified    = 0,
+                       .VerifyFailures   = 0,
+                       .Statistics       = StartStatistics(nullptr),
+                       .Parallel         = StartParallelCopies(nullptr),
+                       .ZeroRuns         = {},
+                       .Stored           = nullptr};
+    CopyDirectory(State, Source, Destination);
+    FlushSmallFiles(State);
+
+    LogCopyStatistics("CopyDirectoryToBackup", State);
+    LogPoolWait("CopyDirectoryToBackup");
+}
+
+void FS::RestoreDirectoryDifferential(System::ProgressTask *Task,
+                                      const fslib::Path &Source,
+                                      const fslib::Path &Destination,
+                                      FS::Transaction *Transaction,
+                                      const FS::Manifest *Keep,
+                                      const FS::Verification *Verify)
+{
+    BeginPoolWait();
+
+    CopyState State = {.Task             = Task,
+                       .Transaction      = Transaction,
+                       .Ring             = FS::BufferRing(FILE_BUFFER_COUNT, FILE_BUFFER_SIZE),
+                       .BatchBuffer      = std::make_unique<unsigned char[]>(SMALL_FILE_BATCH_SIZE),
+                       .BatchUsed        = 0,
+                       .BatchedFiles     = {},
+                       .BatchPaths       = {},
+                       .BatchDestination = FS::PathBuilder(Destination),
+                       .Previous         = nullptr,
+                       .PreviousName     = {},
+                       .ManifestOut      = nullptr,
+                       .RootLength       = GetRootLength(Source),
+                       .Differential     = true,
+                       .CompareBuffer    = std::make_unique<unsigned char[]>(FILE_BUFFER_SIZE),
+                       .BytesMatched     = 0,
+                       .Journal          = nullptr,
+                       .Expected         = Verify ? Verify->Expected : nullptr,
+                       .ReadBack         = Verify && Verify->ReadBack,
+                       .FilesVerified    = 0,
+                       .VerifyFailures   = 0,
+                       .Statistics       = StartStatistics(Transaction),
+                       .Parallel         = StartParallelCopies(Transaction),
+                       .ZeroRuns         = {},
+                       .Stored           = Keep};
+
+    // Stale entries go first. This frees space and takes care of anything that changed from a file to a directory.
+    uint32_t DeletedCount = 0;
+    DeleteStaleEntries(State, Source, Destination, Keep, DeletedCount);
+
+    CopyDirectory(State, Source, Destination);
+    FlushSmallFiles(State);
+
+    logger::log("Differential restore: %llu bytes matched and weren't written. %u stale entries deleted.",
+                State.BytesMatched,
+                DeletedCount);
+    LogCopyStatistics("RestoreDirectoryDifferential", State);
+    LogPoolWait("RestoreDirectoryDifferential");
+}
+
+bool FS::CopyFile(System::ProgressTask *Task,
+                  const fslib::Path &Source,
+                  const fslib::Path &Destination,
+                  FS::Transaction *Transaction,
+                  const std::vector<FS::Manifest::ZeroRun> *ZeroRuns)
+{
+    fslib::File SourceFile(Source, FS_OPEN_READ);
+    if (!SourceFile.is_open())
+    {
+        logger::log("Error opening source file: %s", fslib::error::get_string());
+        return false;
+    }
+
+    // Single files always go through the ring. There's nothing to batch them with.
+    CopyState State = {.Task             = Task,
+                       .Transaction      = Transaction,
+                       .Ring             = FS::BufferRing(FILE_BUFFER_COUNT, FILE_BUFFER_SIZE),
+                       .BatchBuffer      = nullptr,
+                       .BatchUsed        = 0,
+                       .BatchedFiles     = {},
+                       .BatchPaths       = {},
+                       .BatchDestination = {},
+                       .Previous         = nullptr,
+                       .PreviousName     = {},
+                       .ManifestOut      = nullptr,
+                       .RootLength       = 0,
+                       .Differential     = false,
+                       .CompareBuffer    = nullptr,
+                       .BytesMatched     = 0,
+                       .Journal          = nullptr,
+                       .Expected         = nullptr,
+                       .ReadBack         = false,
+                       .FilesVerified    = 0,
+                       .VerifyFailures   = 0,
+                       .Statistics       = StartStatistics(Transaction),
+                       .Parallel         = nullptr,
+                       .ZeroRuns         = ZeroRuns ? *ZeroRuns : ZeroRunList(),
+                       .Stored           = nullptr};
+    uint64_t FileHash = 0;
+    return CopyLargeFile(State, State.Ring, SourceFile, Source, Destination, State.ZeroRuns, FileHash);
+}
+
+// Files are only hashed when something uses the hash.
+static inline bool NeedsHash(const CopyState &State) { return State.ManifestOut || State.Expected || State.ReadBack; }
+
+// Returns RelativePath without the compacted suffix if it's a file being restored from under it. Backups only read the save,
+// so the suffix doesn't mean anything there.
+static inline std::u16string_view GetRestoredPath(const CopyState &State, std::u16string_view RelativePath)
+{
+    if (!State.ManifestOut && RelativePath.ends_with(FS::Manifest::COMPACTED_SUFFIX))
+    {
+        RelativePath.remove_suffix(FS::Manifest::COMPACTED_SUFFIX.length());
+    }
+    return RelativePath;
+}
+
+// Counts a verified file and whether it failed.
+static void CountVerified(CopyState &State, bool Failed)
+{
+    auto SharedLock = LockShared(State);
+    ++State.FilesVerified;
+    if (Failed) { ++State.VerifyFailures; }
+}
+
+// Checks a file that was just written. Hash is what was read from the source. It's checked against the expected manifest and,
+// if read back is on, against what actually ended up in Destination. Ring is used to read it back. ZeroRuns are the runs left
+// out of Destination if it was stored without them, nullptr if it wasn't.
+static bool VerifyFile(CopyState &State,
+                       FS::BufferRing &Ring,
+                       std::u16string_view RelativePath,
+                       const fslib::Path &Destination,
+                       const ZeroRunList *ZeroRuns,
+                       uint64_t Hash)
+{
+    // Files referenced from other backups were never in this one, so there's nothing to check them against.
+    const FS::Manifest::Entry *ExpectedEntry = State.Expected ? State.Expected->FindEntry(RelativePath) : nullptr;
+    bool CheckExpected                       = ExpectedEntry && ExpectedEntry->Reference.empty();
+    if (!CheckExpected && !State.ReadBack) { return true; }
+
+    // Destination is only converted for the log if it fails.
+    char UTF8Buffer[0x301] = {0};
+    if (CheckExpected && ExpectedEntry->Hash != Hash)
+    {
+        StringUtil::ToUTF8(Destination.full_path(), UTF8Buffer, 0x301);
+        logger::log("Verification failed: %s doesn't match the backup's manifest.", UTF8Buffer);
+        CountVerified(State, true);
+        return false;
+    }
+
+    if (State.ReadBack)
+    {
+        fslib::File DestinationFile(Destination, FS_OPEN_READ);
+        if (!DestinationFile.is_open() || HashFile(Ring, DestinationFile, ZeroRuns) != Hash)
+        {
+            StringUtil::ToUTF8(Destination.full_path(), UTF8Buffer, 0x301);
+            logger::log("Verification failed: %s doesn't match what was read.", UTF8Buffer);
+            CountVerified(State, true);
+            return false;
+        }
+    }
+    CountVerified(State, false);
+    return true;
+}
+
+// Records a file was written. The journal only counts it once the data is safe. Files on the SD card are safe as soon as
+// they're closed, but save archives need a commit first. Batches pass false for Flush and flush once at the end instead.
+static void FileFinished(CopyState &State, std::u16string_view RelativePath, uint64_t Size, uint64_t Hash, bool Flush)
+{
+    auto SharedLock = LockShared(State);
+    ++State.Statistics.FilesWritten;
+    State.Statistics.BytesWritten += Size;
+
+    bool Committed = State.Transaction && State.Transaction->FileWritten(Size);
+    if (!State.Journal) { return; }
+
+    State.Journal->FileCompleted(RelativePath, Size, Hash);
+    if (Committed || (Flush && !State.Transaction)) { State.Journal->Flush(); }
+}
+
+// Writes every small file in the batch and empties it. Progress is only updated once for the whole batch.
+static void FlushSmallFiles(CopyState &State)
+{
+    if (State.BatchedFiles.empty()) { return; }
+
+    if (State.Task)
+    {
+        State.Task->SetStatus(Strings::GetStringByName(Strings::Names::CopyingSmallFiles, 0), State.BatchedFiles.size());
+        auto SharedLock = LockShared(State);
+        State.Task->Reset(static_cast<double>(State.BatchUsed));
+    }
+
+    for (BatchedFile &CurrentFile : State.BatchedFiles)
+    {
+        std::u16string_view RelativePath =
+            std::u16string_view(State.BatchPaths).substr(CurrentFile.PathOffset, CurrentFile.PathLength);
+        State.BatchDestination.SetRelative(RelativePath);
+        const fslib::Path &DestinationPath = State.BatchDestination.GetPath();
+
+        auto OpenStart = std::chrono::steady_clock::now();
+        fslib::File DestinationFile(DestinationPath, FS_OPEN_CREATE | FS_OPEN_WRITE, CurrentFile.Size);
+        RecordTiming(State, State.Statistics.Opens, OpenStart);
+        if (!DestinationFile.is_open())
+        {
+            logger::log("Error opening destination file: %s", fslib::error::get_string());
+            continue;
+        }
+
+        // Empty files only need to be created.
+        if (CurrentFile.Size > 0 && DestinationFile.write(&State.BatchBuffer[CurrentFile.Offset], CurrentFile.Size) !=
+                                        static_cast<ssize_t>(CurrentFile.Size))
+        {
+            logger::log("Error writing to file: %s", fslib::error::get_string());
+            continue;
+        }
+
+        auto CloseStart = std::chrono::steady_clock::now();
+        DestinationFile.close();
+        RecordTiming(State, State.Statistics.Closes, CloseStart);
+
+        VerifyFile(State, State.Ring, RelativePath, DestinationPath, nullptr, CurrentFile.Hash);
+        FileFinished(State, RelativePath, CurrentFile.Size, CurrentFile.Hash, false);
+    }
+
+    auto SharedLock = LockShared(State);
+    if (State.Journal && !State.Transaction) { State.Journal->Flush(); }
+
+    if (State.Task) { State.Task->SetCurrent(static_cast<double>(State.BatchUsed)); }
+
+    State.BatchUsed = 0;
+    State.BatchedFiles.clear();
+    State.BatchPaths.clear();
+}
+
+// Reads SourceFile into the batch with a single read. The batch is flushed first if the file won't fit. HashOut is only set if
+// something needs the hash.
+static bool BatchSmallFile(CopyState &State, fslib::File &SourceFile, std::u16string_view RelativePath, uint64_t &HashOut)
+{
+    size_t FileSize = static_cast<size_t>(SourceFile.get_size());
+    if (State.BatchUsed + FileSize > SMALL_FILE_BATCH_SIZE) { FlushSmallFiles(State); }
+
+    if (FileSize > 0 && SourceFile.read(&State.BatchBuffer[State.BatchUsed], FileSize) != static_cast<ssize_t>(FileSize))
+    {
+        logger::log("Error reading from file: %s", fslib::error::get_string());
+        return false;
+    }
+
+    if (NeedsHash(State)) { HashOut = FS::Hash64::Get(&State.BatchBuffer[State.BatchUsed], FileSize); }
+
+    State.BatchedFiles.push_back({.PathOffset = State.BatchPaths.length(),
+                                  .PathLength = RelativePath.length(),
+                                  .Offset     = State.BatchUsed,
+                                  .Size       = FileSize,
+                                  .Hash       = HashOut});
+    State.BatchPaths.append(RelativePath);
+    State.BatchUsed += FileSize;
+    return true;
+}
+
+// Checks whether the journal says SourceFile was already copied by an interrupted run. The destination still has to be there at
+// the right size for it to count. The save could have been played since a backup was interrupted, so files being backed up
+// also have to still hash the same. If not, SourceFile is rewound so it can be copied. The shared lock is only held to look the
+// file up and record it, never for the file I/O.
+static bool ResumeCompletedFile(CopyState &State,
+                                fslib::File &SourceFile,
+                                const fslib::Path &Destination,
+                                std::u16string_view RelativePath)
+{
+    FS::Journal::CompletedFile Completed;
+    {
+        auto SharedLock                                 = LockShared(State);
+        const FS::Journal::CompletedFile *JournalRecord = State.Journal->FindCompleted(RelativePath);
+        if (!JournalRecord) { return false; }
+        Completed = *JournalRecord;
+    }
+    if (Completed.Size != static_cast<uint64_t>(SourceFile.get_size())) { return false; }
+
+    fslib::File DestinationFile(Destination, FS_OPEN_READ);
+    if (!DestinationFile.is_open() || static_cast<uint64_t>(DestinationFile.get_size()) != Completed.Size) { return false; }
+
+    if (State.ManifestOut)
+    {
+        if (HashFile(State.Ring, SourceFile, nullptr) != Completed.Hash)
+        {
+            SourceFile.seek(0, fslib::Stream::BEGINNING);
+            return false;
+        }
+
+        auto SharedLock = LockShared(State);
+        State.ManifestOut->AddEntry({std::u16string(RelativePath), Completed.Size, Completed.Hash, std::u16string()});
+    }
+    return true;
+}
+
+// Compares SourceFile with the file already at Destination. If they're the same, nothing needs to be written. If not,
+// SourceFile is rewound so it can be copied.
+static bool FileMatches(CopyState &State, fslib::File &SourceFile, const fslib::Path &Destination)
 {
-    fslib::Directory SourceDir(Source);
-    if (!SourceDir.is_open())
+    // Both sides are read anyway, so the data is compared directly instead of hashing both.
+    fslib::File DestinationFile(Destination, FS_OPEN_READ);
+    if (!DestinationFile.is_open() || DestinationFile.get_size() != SourceFile.get_size()) { return false; }
+
+    FS::BufferRing &Ring = State.Ring;
+    FS::StartReadJob(SourceFile, Ring);
+
+    uint64_t BytesCompared = 0;
+    for (FS::BufferRing::Buffer *SourceBuffer = Ring.AcquireFull(); SourceBuffer; SourceBuffer = Ring.AcquireFull())
+    {
+        size_t BufferSize   = SourceBuffer->Size;
+        ssize_t CompareRead = DestinationFile.read(State.CompareBuffer.get(), BufferSize);
+
+        bool Matches = CompareRead == static_cast<ssize_t>(BufferSize) &&
+                       std::memcmp(State.CompareBuffer.get(), SourceBuffer->Data.get(), BufferSize) == 0;
+        Ring.Release(SourceBuffer);
+        if (!Matches)
+        {
+            Ring.Cancel();
+            break;
+        }
+        BytesCompared += BufferSize;
+    }
+    Ring.WaitForClose();
+
+    if (BytesCompared != static_cast<uint64_t>(SourceFile.get_size()))
     {
-        logger::log("Error opening directory: %s", fslib::error::get_string());
+        SourceFile.seek(0, fslib::Stream::BEGINNING);
+        return false;
+    }
+    return true;
+}
+
+// Returns whether Size bytes of Data are all zero. Size has to be a multiple of 64. Each 64 bytes are ORed together a word at
+// a time so the compiler can vectorize it. Only the check between them can stop early.
+static bool IsZeroBlock(const unsigned char *Data, size_t Size)
+{
+    for (size_t Offset = 0; Offset < Size; Offset += 64)
+    {
+        uint64_t Words[8];
+        std::memcpy(Words, &Data[Offset], 64);
+
+        uint64_t Combined = 0;
+        for (uint64_t Word : Words) { Combined |= Word; }
+        if (Combined != 0) { return false; }
+    }
+    return true;
+}
+
+// Writes Size bytes of Data to Destination, leaving out every whole zero block. Position is where Data starts in the original
+// file. Blocks left out are added to ZeroRuns, merged with the last run if they follow it.
+static bool WriteWithoutZeroBlocks(fslib::File &Destination,
+                                   const unsigned char *Data,
+                                   size_t Size,
+                                   uint64_t Position,
+                                   ZeroRunList &ZeroRuns)
+{
+    // Data between zero blocks is written in one go.
+    size_t SpanStart = 0;
+    for (size_t Offset = 0; Offset + ZERO_BLOCK_SIZE <= Size; Offset += ZERO_BLOCK_SIZE)
+    {
+        if (!IsZeroBlock(&Data[Offset], ZERO_BLOCK_SIZE)) { continue; }
+
+        size_t SpanSize = Offset - SpanStart;
+        if (SpanSize > 0 && Destination.write(&Data[SpanStart], SpanSize) != static_cast<ssize_t>(SpanSize)) { return false; }
+        SpanStart = Offset + ZERO_BLOCK_SIZE;
+
+        uint64_t BlockOffset = Position + Offset;
+        if (!ZeroRuns.empty() && ZeroRuns.back().Offset + ZeroRuns.back().Length == BlockOffset)
+        {
+            ZeroRuns.back().Length += ZERO_BLOCK_SIZE;
+        }
+        else { ZeroRuns.push_back({.Offset = BlockOffset, .Length = ZERO_BLOCK_SIZE}); }
+    }
+
+    size_t SpanSize = Size - SpanStart;
+    return SpanSize == 0 || Destination.write(&Data[SpanStart], SpanSize) == static_cast<ssize_t>(SpanSize);
+}
+
+// Walks Size bytes of a stored file's data, starting Position bytes into the original file. The data between zero runs is
+// passed to OnData and every run reached is passed to OnZeros. Position and RunIndex are moved along. Runs at the very end of
+// the file are reached by calling this with Size 0 once the data runs out.
+template <typename DataFunction, typename ZeroFunction>
+static bool ExpandZeroRuns(const ZeroRunList &ZeroRuns,
+                           size_t &RunIndex,
+                           uint64_t &Position,
+                           const unsigned char *Data,
+                           size_t Size,
+                           DataFunction OnData,
+                           ZeroFunction OnZeros)
+{
+    while (true)
+    {
+        // Runs starting here come before the data.
+        while (RunIndex < ZeroRuns.size() && ZeroRuns[RunIndex].Offset == Position)
+        {
+            if (!OnZeros(ZeroRuns[RunIndex].Length)) { return false; }
+            Position += ZeroRuns[RunIndex++].Length;
+        }
+        if (Size == 0) { return true; }
+
+        size_t PieceSize = Size;
+        if (RunIndex < ZeroRuns.size() && ZeroRuns[RunIndex].Offset > Position)
+        {
+            PieceSize = static_cast<size_t>(std::min<uint64_t>(Size, ZeroRuns[RunIndex].Offset - Position));
+        }
+        if (!OnData(Data, PieceSize)) { return false; }
+
+        Data += PieceSize;
+        Size -= PieceSize;
+        Position += PieceSize;
+    }
+}
+
+// Updates FileHash with Length bytes of zeros.
+static void HashZeros(FS::Hash64 &FileHash, uint64_t Length)
+{
+    for (uint64_t Hashed = 0; Hashed < Length;)
+    {
+        size_t ChunkSize = static_cast<size_t>(std::min<uint64_t>(Length - Hashed, FILE_BUFFER_SIZE));
+        FileHash.Update(s_ZeroBuffer, ChunkSize);
+        Hashed += ChunkSize;
+    }
+}
+
+// Writes Length bytes of zeros to Destination.
+static bool WriteZeros(fslib::File &Destination, uint64_t Length)
+{
+    for (uint64_t Written = 0; Written < Length;)
+    {
+        size_t ChunkSize = static_cast<size_t>(std::min<uint64_t>(Length - Written, FILE_BUFFER_SIZE));
+        if (Destination.write(s_ZeroBuffer, ChunkSize) != static_cast<ssize_t>(ChunkSize)) { return false; }
+        Written += ChunkSize;
+    }
+    return true;
+}
+
+// Hashes SourceFile through Ring without writing it anywhere. If SourceFile was stored without zero runs, ZeroRuns are hashed
+// back in so the hash is the original file's. ZeroRuns can be nullptr.
+static uint64_t HashFile(FS::BufferRing &Ring, fslib::File &SourceFile, const ZeroRunList *ZeroRuns)
+{
+    FS::Hash64 FileHash;
+    size_t RunIndex   = 0;
+    uint64_t Position = 0;
+    auto HashData     = [&FileHash](const unsigned char *Data, size_t Size)
+    {
+        FileHash.Update(Data, Size);
+        return true;
+    };
+    auto HashRun = [&FileHash](uint64_t Length)
+    {
+        HashZeros(FileHash, Length);
+        return true;
+    };
+
+    FS::StartReadJob(SourceFile, Ring);
+    for (FS::BufferRing::Buffer *HashBuffer = Ring.AcquireFull(); HashBuffer; HashBuffer = Ring.AcquireFull())
+    {
+        if (ZeroRuns)
+        {
+            ExpandZeroRuns(*ZeroRuns, RunIndex, Position, HashBuffer->Data.get(), HashBuffer->Size, HashData, HashRun);
+        }
+        else { FileHash.Update(HashBuffer->Data.get(), HashBuffer->Size); }
+        Ring.Release(HashBuffer);
+    }
+    Ring.WaitForClose();
+
+    if (ZeroRuns) { ExpandZeroRuns(*ZeroRuns, RunIndex, Position, nullptr, 0, HashData, HashRun); }
+    return FileHash.Finish();
+}
+
+// Checks SourceFile against the previous backup's manifest. If it's unchanged, it's recorded as a reference to the backup
+// holding the data and true is returned. If not, SourceFile is rewound so it can be copied.
+static bool SkipUnchangedFile(CopyState &State, fslib::File &SourceFile, std::u16string_view RelativePath)
+{
+    const FS::Manifest::Entry *PreviousEntry = State.Previous ? State.Previous->FindEntry(RelativePath) : nullptr;
+    // Different sizes mean there's no point in reading the file twice.
+    if (!PreviousEntry || PreviousEntry->Size != static_cast<uint64_t>(SourceFile.get_size())) { return false; }
+
+    if (HashFile(State.Ring, SourceFile, nullptr) != PreviousEntry->Hash)
+    {
+        SourceFile.seek(0, fslib::Stream::BEGINNING);
+        return false;
+    }
+
+    // Point to wherever the previous backup got it from. References never chain.
+    std::u16string Reference = PreviousEntry->Reference.empty() ? std::u16string(State.PreviousName) : PreviousEntry->Reference;
+    auto SharedLock          = LockShared(State);
+    State.ManifestOut->AddEntry({std::u16string(RelativePath),
+                                 PreviousEntry->Size,
+                                 PreviousEntry->Hash,
+                                 std::move(Reference),
+                                 PreviousEntry->ZeroRuns});
+    return true;
+}
+
+// Hashes the first Length bytes of SourceFile into FileHash. This is only needed to resume a copy that needs the whole hash.
+static bool HashFilePrefix(fslib::File &SourceFile, uint64_t Length, FS::Hash64 &FileHash)
+{
+    std::unique_ptr<unsigned char[]> HashBuffer(new unsigned char[FILE_BUFFER_SIZE]);
+    for (uint64_t TotalRead = 0; TotalRead < Length;)
+    {
+        size_t ReadSize   = static_cast<size_t>(std::min<uint64_t>(Length - TotalRead, FILE_BUFFER_SIZE));
+        ssize_t BytesRead = SourceFile.read(HashBuffer.get(), ReadSize);
+        if (BytesRead <= 0) { return false; }
+
+        FileHash.Update(HashBuffer.get(), BytesRead);
+        TotalRead += BytesRead;
+    }
+    return true;
+}
+
+// Checks whether what an interrupted run left at WritePath can be picked up at ResumeOffset. Restored files were created at
+// full size the first time. Stored files are at least as long as what was recorded. The save could have been played since a
+// backup was interrupted, so what was already stored also has to still match the start of SourceFile. FileHash gets the part
+// that's skipped if the copy needs the hash.
+static bool CanResumeFile(CopyState &State,
+                          fslib::File &SourceFile,
+                          const fslib::Path &WritePath,
+                          uint64_t ResumeOffset,
+                          uint64_t FileSize,
+                          FS::Hash64 &FileHash)
+{
+    bool Storing = State.ManifestOut != nullptr;
+    fslib::File DestinationFile(WritePath, FS_OPEN_READ);
+    uint64_t DestinationSize = DestinationFile.is_open() ? DestinationFile.get_size() : 0;
+    if (!DestinationFile.is_open() || (Storing ? DestinationSize < ResumeOffset : DestinationSize != FileSize))
+    {
+        return false;
+    }
+    if (!NeedsHash(State)) { return true; }
+
+    if (!HashFilePrefix(SourceFile, ResumeOffset, FileHash))
+    {
+        logger::log("Error reading from file: %s", fslib::error::get_string());
+        return false;
+    }
+    if (!Storing) { return true; }
+
+    FS::Hash64 StoredHash;
+    bool StoredRead = HashFilePrefix(DestinationFile, ResumeOffset, StoredHash);
+    return StoredRead && StoredHash.Finish() == FileHash.Finish();
+}
+
+// Updates the task's progress for the file being copied. Parallel copies can't share the task's current value, so they add
+// what they wrote to the operation instead. Copied is the file's total so far and Written is what was just added to it.
+static void UpdateFileProgress(CopyState &State, uint64_t Copied, uint64_t Written)
+{
+    if (!State.Task) { return; }
+
+    if (!State.Parallel)
+    {
+        State.Task->SetCurrent(static_cast<double>(Copied));
         return;
     }
 
-    for (uint32_t i = 0; i < SourceDir.get_count(); i++)
+    std::scoped_lock<std::mutex> SharedLock(State.Parallel->Lock);
+    State.Task->Skip(static_cast<double>(Written));
+}
+
+// Writes Size bytes of Data that start Position bytes into the original file. If FindZeroBlocks is true, zero blocks are left
+// out and added to ZeroRuns. Otherwise, runs in ZeroRuns that are reached are written back as zeros. WrittenOut is how much of
+// the original file that covered. FileHash is updated with the original data if it isn't nullptr.
+static bool WriteFileData(fslib::File &Destination,
+                          const unsigned char *Data,
+                          size_t Size,
+                          uint64_t Position,
+                          bool FindZeroBlocks,
+                          ZeroRunList &ZeroRuns,
+                          size_t &RunIndex,
+                          FS::Hash64 *FileHash,
+                          uint64_t &WrittenOut)
+{
+    WrittenOut = 0;
+    if (FindZeroBlocks || ZeroRuns.empty())
+    {
+        if (FileHash) { FileHash->Update(Data, Size); }
+
+        bool Written = FindZeroBlocks ? WriteWithoutZeroBlocks(Destination, Data, Size, Position, ZeroRuns)
+                                      : Destination.write(Data, Size) == static_cast<ssize_t>(Size);
+        WrittenOut   = Written ? Size : 0;
+        return Written;
+    }
+
+    uint64_t Start = Position;
+    bool Written   = ExpandZeroRuns(
+        ZeroRuns,
+        RunIndex,
+        Position,
+        Data,
+        Size,
+        [&](const unsigned char *Piece, size_t PieceSize)
+        {
+            if (FileHash) { FileHash->Update(Piece, PieceSize); }
+            return Destination.write(Piece, PieceSize) == static_cast<ssize_t>(PieceSize);
+        },
+        [&](uint64_t Length)
+        {
+            if (FileHash) { HashZeros(*FileHash, Length); }
+            return WriteZeros(Destination, Length);
+        });
+    WrittenOut = Position - Start;
+    return Written;
+}
+
+// Copies SourceFile to Destination through Ring. HashOut is only set if something needs the hash. Copies to a backup leave out
+// zero blocks and fill ZeroRuns with them. Otherwise ZeroRuns are the runs SourceFile was stored without and they're written
+// back as zeros.
+static bool CopyLargeFile(CopyState &State,
+                          FS::BufferRing &Ring,
+                          fslib::File &SourceFile,
+                          const fslib::Path &FullSource,
+                          const fslib::Path &Destination,
+                          ZeroRunList &ZeroRuns,
+                          uint64_t &HashOut)
+{
+    // Grab file size quick. Stored files are smaller than the original by their zero runs.
+    bool Storing = State.ManifestOut != nullptr;
+    if (Storing) { ZeroRuns.clear(); }
+    uint64_t FileSize = SourceFile.get_size() + FS::GetZeroRunTotal(ZeroRuns);
+
+    // Progress is only recorded where it's safe as soon as it's written. Save archives lose it without a commit. Offsets in
+    // files with zero runs don't line up on both sides. Restored ones are always copied from the start. Backed up ones are
+    // only recorded up to their first zero run, since both sides are the same until then.
+    std::u16string_view RelativePath = GetRestoredPath(State, FullSource.full_path() + State.RootLength);
+    bool RecordProgress              = State.Journal && !State.Transaction && (Storing || ZeroRuns.empty());
+    uint64_t ResumeOffset            = 0;
+    if (RecordProgress)
+    {
+        auto SharedLock = LockShared(State);
+        ResumeOffset    = State.Journal->GetResumeOffset(RelativePath);
+    }
+
+    // Stored files are written under the compacted suffix since zero blocks could be left out of them. They only get their own
+    // name once they're finished and nothing was.
+    fslib::Path WritePath = Storing ? Destination + FS::Manifest::COMPACTED_SUFFIX : Destination;
+
+    // The manifest needs the hash of the whole file, not just what's left.
+    auto OpenStart = std::chrono::steady_clock::now();
+    FS::Hash64 FileHash;
+    if (ResumeOffset >= FileSize ||
+        (ResumeOffset > 0 && !CanResumeFile(State, SourceFile, WritePath, ResumeOffset, FileSize, FileHash)))
+    {
+        ResumeOffset = 0;
+        FileHash     = FS::Hash64();
+    }
+
+    // A file being picked up is opened as-is and both sides continue where they stopped.
+    fslib::File DestinationFile;
+    if (ResumeOffset > 0) { DestinationFile.open(WritePath, FS_OPEN_WRITE); }
+
+    // Stored files grow as they're written since their size isn't known yet. An interrupted backup could have left a longer
+    // one behind, so it goes first unless it's being picked up.
+    if (ResumeOffset == 0)
+    {
+        if (Storing && State.Journal) { fslib::delete_file(WritePath); }
+        DestinationFile.open(WritePath, FS_OPEN_CREATE | FS_OPEN_WRITE, Storing ? 0 : FileSize);
+    }
+    // A resumed stored file keeps its zero blocks from here on. Leaving them out could end it before what the interrupted
+    // run already wrote, and there's no way to cut the rest off.
+    bool FindZeroBlocks = Storing && ResumeOffset == 0;
+    RecordTiming(State, State.Statistics.Opens, OpenStart);
+    if (!DestinationFile.is_open())
+    {
+        logger::log("Error opening destination file: %s", fslib::error::get_string());
+        return false;
+    }
+
+    SourceFile.seek(ResumeOffset, fslib::Stream::BEGINNING);
+    DestinationFile.seek(ResumeOffset, fslib::Stream::BEGINNING);
+
+    // Update task. The name is only converted to UTF-8 if the UI actually shows it.
+    if (State.Task)
+    {
+        State.Task->SetStatus(Strings::GetStringByName(Strings::Names::CopyingFile, 0), FullSource.full_path());
+        if (!State.Parallel) { State.Task->Reset(static_cast<double>(FileSize)); }
+        UpdateFileProgress(State, ResumeOffset, ResumeOffset);
+    }
+
+    // Start reading before anything else.
+    FS::StartReadJob(SourceFile, Ring);
+
+    // Write buffers in the order the read job filled them. Nothing is copied, the buffer just goes back when done.
+    // Counts are of the original file. The data is hashed while it's already in hand.
+    uint64_t BytesWritten = ResumeOffset;
+    uint64_t LastProgress = ResumeOffset;
+    uint64_t WriteCount   = 0;
+    size_t RunIndex       = 0;
+    FS::Hash64 *Hash      = NeedsHash(State) ? &FileHash : nullptr;
+    bool WriteFailed      = false;
+    for (FS::BufferRing::Buffer *WriteBuffer = Ring.AcquireFull(); WriteBuffer; WriteBuffer = Ring.AcquireFull())
+    {
+        WriteFailed = !WriteFileData(DestinationFile,
+                                     WriteBuffer->Data.get(),
+                                     WriteBuffer->Size,
+                                     BytesWritten,
+                                     FindZeroBlocks,
+                                     ZeroRuns,
+                                     RunIndex,
+                                     Hash,
+                                     WriteCount);
+        Ring.Release(WriteBuffer);
+        if (WriteFailed)
+        {
+            logger::log("Error writing to file: %s", fslib::error::get_string());
+            // Stop the reader. There's no point in reading what can't be written.
+            Ring.Cancel();
+            break;
+        }
+
+        // Update count
+        BytesWritten += WriteCount;
+
+        if (RecordProgress && ZeroRuns.empty() && BytesWritten - LastProgress >= JOURNAL_PROGRESS_INTERVAL)
+        {
+            auto SharedLock = LockShared(State);
+            State.Journal->FileProgress(RelativePath, BytesWritten);
+            State.Journal->Flush();
+            LastProgress = BytesWritten;
+        }
+
+        // Update progress.
+        UpdateFileProgress(State, BytesWritten, WriteCount);
+    }
+
+    // The read job is done with SourceFile once the ring is closed.
+    Ring.WaitForClose();
+
+    // Zero runs at the very end don't have any data after them.
+    if (!WriteFailed && !Storing && RunIndex < ZeroRuns.size() &&
+        WriteFileData(DestinationFile, nullptr, 0, BytesWritten, false, ZeroRuns, RunIndex, Hash, WriteCount))
+    {
+        BytesWritten += WriteCount;
+        UpdateFileProgress(State, BytesWritten, WriteCount);
+    }
+
+    if (BytesWritten != FileSize)
+    {
+        char UTF8Buffer[0x301] = {0};
+        StringUtil::ToUTF8(FullSource.full_path(), UTF8Buffer, 0x301);
+        logger::log("Error copying %s: %llu of %llu bytes written.", UTF8Buffer, BytesWritten, FileSize);
+    }
+
+    // Close the destination file before it's recorded just incase a commit is triggered.
+    auto CloseStart = std::chrono::steady_clock::now();
+    DestinationFile.close();
+    RecordTiming(State, State.Statistics.Closes, CloseStart);
+
+    HashOut = FileHash.Finish();
+    if (BytesWritten != FileSize)
+    {
+        // What was written still needs to be committed. It just can't count as finished.
+        if (State.Transaction) { State.Transaction->FileWritten(BytesWritten); }
+        return false;
+    }
+
+    if (!ZeroRuns.empty())
+    {
+        auto SharedLock = LockShared(State);
+        State.Statistics.ZeroBytes += FS::GetZeroRunTotal(ZeroRuns);
+    }
+
+    VerifyFile(State, Ring, RelativePath, WritePath, Storing ? &ZeroRuns : nullptr, HashOut);
+
+    // Whatever an interrupted backup left under the other name goes so only one copy of the file is in the backup.
+    if (Storing)
+    {
+        fslib::delete_file(Destination);
+        if (ZeroRuns.empty() && !fslib::rename_file(WritePath, Destination))
+        {
+            logger::log("Error renaming stored file: %s", fslib::error::get_string());
+            return false;
+        }
+    }
+    FileFinished(State, RelativePath, BytesWritten, HashOut, true);
+    return true;
+}
+
+// Job run on the copy workers. The file is recorded and the slot is freed once it's copied.
+static void CopySlotFile(CopyState &State, CopySlot &Slot)
+{
+    uint64_t FileHash = 0;
+    bool Copied =
+        CopyLargeFile(State, Slot.Ring, Slot.SourceFile, Slot.Source, Slot.Destination, Slot.ZeroRuns, FileHash);
+    uint64_t FileSize = Slot.SourceFile.get_size();
+    Slot.SourceFile.close();
+
+    std::scoped_lock<std::mutex> SharedLock(State.Parallel->Lock);
+    if (Copied && State.ManifestOut)
+    {
+        std::u16string RelativePath(Slot.Source.full_path() + State.RootLength);
+        State.ManifestOut->AddEntry({std::move(RelativePath), FileSize, FileHash, std::u16string(), Slot.ZeroRuns});
+    }
+    State.Parallel->FreeSlots.push_back(&Slot);
+    State.Parallel->SlotFreed.notify_all();
+}
+
+// Hands SourceFile to a copy worker. This waits for one of the copies running to finish if they're all busy. ZeroRuns are the
+// runs SourceFile was stored without, nullptr if there aren't any.
+static void StartParallelCopy(CopyState &State,
+                              fslib::File &SourceFile,
+                              const fslib::Path &Source,
+                              const fslib::Path &Destination,
+                              const ZeroRunList *ZeroRuns)
+{
+    ParallelCopy &Parallel = *State.Parallel;
+
+    CopySlot *Slot = nullptr;
+    {
+        std::unique_lock<std::mutex> SharedLock(Parallel.Lock);
+        Parallel.SlotFreed.wait(SharedLock, [&Parallel]() { return !Parallel.FreeSlots.empty(); });
+        Slot = Parallel.FreeSlots.back();
+        Parallel.FreeSlots.pop_back();
+    }
+
+    Slot->SourceFile  = std::move(SourceFile);
+    Slot->Source      = Source;
+    Slot->Destination = Destination;
+    if (ZeroRuns) { Slot->ZeroRuns = *ZeroRuns; }
+    else { Slot->ZeroRuns.clear(); }
+    GetCopyPool().Submit([&State, Slot]() { CopySlotFile(State, *Slot); });
+}
+
+// Waits for every parallel copy to finish.
+static void WaitForParallelCopies(CopyState &State)
+{
+    ParallelCopy &Parallel = *State.Parallel;
+    std::unique_lock<std::mutex> SharedLock(Parallel.Lock);
+    Parallel.SlotFreed.wait(SharedLock, [&Parallel]() { return Parallel.FreeSlots.size() == Parallel.Slots.size(); });
+}
+
+static void CopyDirectory(CopyState &State, const fslib::Path &Source, const fslib::Path &Destination)
+{
+    // Destination paths are built in one buffer alongside the walker's.
+    FS::DirectoryWalker Walker(Source);
+    FS::PathBuilder DestinationBuilder(Destination);
+    while (Walker.Next())
     {
         // Test to make sure JKSM doesn't copy the ._secure_value file to the save if it exists. This might be a little unsafe.
-        if (std::char_traits<char16_t>::compare(u"._secure_value", SourceDir[i].get_filename(), 14) == 0) { continue; }
+        const fslib::DirectoryEntry &Entry = Walker.GetEntry();
+        if (std::char_traits<char16_t>::compare(u"._secure_value", Entry.get_filename(), 14) == 0) { continue; }
+        // Manifests only belong to the backup they describe.
+        if (FS::Manifest::FILE_NAME == Entry.get_filename()) { continue; }
 
-        if (SourceDir[i].is_directory())
+        // Full paths. Files a backup stored without their zero runs are restored under their own name.
+        std::u16string_view RelativePath = GetRestoredPath(State, Walker.GetRelativePath());
+        bool Compacted                   = RelativePath.length() != Walker.GetRelativePath().length();
+        const fslib::Path &FullSource    = Walker.GetPath();
+        DestinationBuilder.SetRelative(RelativePath);
+        const fslib::Path &FullDestination = DestinationBuilder.GetPath();
+
+        if (Entry.is_directory())
         {
-            fslib::Path NewSource      = Source / SourceDir[i];
-            fslib::Path NewDestination = Destination / SourceDir[i];
             // Check to make sure it exists first...
-            if (!fslib::directory_exists(NewDestination) && !fslib::create_directory(NewDestination))
+            if (!fslib::directory_exists(FullDestination) && !fslib::create_directory(FullDestination))
             {
                 logger::log("Error creating destination directory: %s", fslib::error::get_string());
-                continue;
+                Walker.SkipCurrent();
             }
-            FS::CopyDirectoryToDirectory(Task, NewSource, NewDestination, Commit);
+            continue;
+        }
+
+        auto OpenStart = std::chrono::steady_clock::now();
+        fslib::File SourceFile(FullSource, FS_OPEN_READ);
+        RecordTiming(State, State.Statistics.Opens, OpenStart);
+        if (!SourceFile.is_open())
+        {
+            logger::log("Error opening source file: %s", fslib::error::get_string());
+            continue;
+        }
+
+        // Files a backup stored without their zero runs can't be compared or batched as they are. Anything else in a backup is
+        // stored as it is. Without their runs from the manifest, compacted files can't be restored at all.
+        const FS::Manifest::Entry *StoredEntry = Compacted && State.Stored ? State.Stored->FindEntry(RelativePath) : nullptr;
+        const ZeroRunList *ZeroRuns = StoredEntry && !StoredEntry->ZeroRuns.empty() ? &StoredEntry->ZeroRuns : nullptr;
+        if (Compacted && !ZeroRuns)
+        {
+            logger::log("Error restoring %s: The backup's manifest doesn't have its zero runs.", Walker.GetUTF8());
+            continue;
+        }
+
+        // Files that don't need to be written still count towards the operation's progress.
+        bool Skipped = (State.Journal && ResumeCompletedFile(State, SourceFile, FullDestination, RelativePath)) ||
+                       (State.ManifestOut && SkipUnchangedFile(State, SourceFile, RelativePath));
+        if (!Skipped && !ZeroRuns && State.Differential && FileMatches(State, SourceFile, FullDestination))
+        {
+            State.BytesMatched += SourceFile.get_size();
+            Skipped = true;
+        }
+
+        if (Skipped)
+        {
+            auto SharedLock = LockShared(State);
+            if (State.Task) { State.Task->Skip(static_cast<double>(SourceFile.get_size())); }
+            continue;
+        }
+
+        // Only large files copied here have zero runs.
+        bool Copied       = false;
+        uint64_t FileHash = 0;
+        State.ZeroRuns.clear();
+        if (s_SmallFileBatching && !ZeroRuns && SourceFile.get_size() <= static_cast<int64_t>(SMALL_FILE_LIMIT))
+        {
+            Copied = BatchSmallFile(State, SourceFile, RelativePath, FileHash);
+        }
+        else if (State.Parallel)
+        {
+            // The worker records the file itself once it's copied.
+            StartParallelCopy(State, SourceFile, FullSource, FullDestination, ZeroRuns);
+            continue;
         }
         else
         {
-            // Full paths.
-            fslib::Path FullSource      = Source / SourceDir[i];
-            fslib::Path FullDestination = Destination / SourceDir[i];
+            if (ZeroRuns) { State.ZeroRuns = *ZeroRuns; }
+            Copied = CopyLargeFile(State, State.Ring, SourceFile, FullSource, FullDestination, State.ZeroRuns, FileHash);
+        }
+
+        // Files that failed aren't recorded so the next backup doesn't reference them.
+        if (Copied && State.ManifestOut)
+        {
+            auto SharedLock = LockShared(State);
+            State.ManifestOut->AddEntry({std::u16string(RelativePath),
+                                         static_cast<uint64_t>(SourceFile.get_size()),
+                                         FileHash,
+                                         std::u16string(),
+                                         State.ZeroRuns});
+        }
+    }
+    if (State.Parallel) { WaitForParallelCopies(State); }
+    State.Statistics.PeakQueueSize = Walker.GetPeakQueueSize();
+}
+
+// Deletes everything in Destination that isn't in Source or listed in Keep.
+static void DeleteStaleEntries(CopyState &State,
+                               const fslib::Path &Source,
+                               const fslib::Path &Destination,
+                               const FS::Manifest *Keep,
+                               uint32_t &DeletedCount)
+{
+    FS::DirectoryWalker Walker(Destination);
+    FS::PathBuilder SourceBuilder(Source);
+    while (Walker.Next())
+    {
+        std::u16string_view RelativePath   = Walker.GetRelativePath();
+        const fslib::Path &FullDestination = Walker.GetPath();
+        SourceBuilder.SetRelative(RelativePath);
+        const fslib::Path &FullSource = SourceBuilder.GetPath();
 
-            // Files
-            fslib::File SourceFile(FullSource, FS_OPEN_READ);
-            fslib::File DestinationFile(FullDestination, FS_OPEN_CREATE | FS_OPEN_WRITE, SourceFile.get_size());
+        if (Walker.GetEntry().is_directory())
+        {
+            // Directories the backup has are walked like normal.
+            if (fslib::directory_exists(FullSource)) { continue; }
 
-            // Check
-            if (!SourceFile.is_open() || !DestinationFile.is_open())
+            Walker.SkipCurrent();
+            if (!fslib::delete_directory_recursively(FullDestination))
             {
-                logger::log("Error opening one of the files: %s", fslib::error::get_string());
+                logger::log("Error deleting stale directory: %s", fslib::error::get_string());
                 continue;
             }
+        }
+        else
+        {
+            if (fslib::file_exists(FullSource) || (Keep && Keep->FindEntry(RelativePath))) { continue; }
 
-            // Get FullSource as UTF8 and update task
-            char UTF8Buffer[0x301] = {0};
-            StringUtil::ToUTF8(FullSource.full_path(), UTF8Buffer, 0x301);
-            if (Task)
+            if (!fslib::delete_file(FullDestination))
             {
-                Task->SetStatus(Strings::GetStringByName(Strings::Names::CopyingFile, 0), UTF8Buffer);
-                Task->Reset(static_cast<double>(SourceFile.get_size()));
+                logger::log("Error deleting stale file: %s", fslib::error::get_string());
+                continue;
             }
+        }
 
-            // Create shared data for threads and allocate the buffer.
-            SharedThreadData Data;
-            Data.SharedBuffer = std::make_unique<unsigned char[]>(FILE_BUFFER_SIZE);
+        // Deletions need to be committed too.
+        if (State.Transaction) { State.Transaction->FileWritten(0); }
+        ++DeletedCount;
+    }
+}
 
-            // Grab file size quick.
-            uint64_t FileSize = SourceFile.get_size();
-            // Spawn read thread early.
-            std::thread ReadThread(ReadThreadFunction, std::ref(SourceFile), std::ref(Data));
+// Reads the central directory of Zip into PreviousOut.
+static void LoadPreviousZip(unzFile Zip, PreviousZip &PreviousOut)
+{
+    PreviousOut.Zip         = Zip;
+    PreviousOut.Buffer      = std::unique_ptr<unsigned char[]>(new unsigned char[FILE_BUFFER_SIZE]);
+    PreviousOut.FilesCopied = 0;
+    PreviousOut.BytesCopied = 0;
 
-            // LocalBuffer to copy bytes read to so we don't hold up the read thread.
-            std::unique_ptr<unsigned char[]> LocalBuffer(new unsigned char[FILE_BUFFER_SIZE]);
-            for (uint64_t BytesWritten = 0; BytesWritten < FileSize;)
-            {
-                // Need to save this for the end of the loop.
-                uint32_t BytesRead = 0;
-
-                // Scoped so the lock is released earlier.
-                {
-                    // Wait for signal buffer is full.
-                    std::unique_lock<std::mutex> BufferLock(Data.BufferMutex);
-                    Data.BufferCondition.wait(BufferLock, [&Data]() { return Data.BufferIsFull; });
-
-                    // Record number of bytes read thread read and copy sharedbuffer contents to localbuffer.
-                    BytesRead = Data.BytesRead;
-                    std::memcpy(LocalBuffer.get(), Data.SharedBuffer.get(), BytesRead);
-
-                    // Signal to other thread it can continue reading
-                    Data.BufferIsFull = false;
-                    Data.BufferCondition.notify_one();
-                }
-
-                // Write data to destination
-                size_t WriteCount = DestinationFile.write(LocalBuffer.get(), BytesRead);
-                if (WriteCount <= 0)
-                {
-                    logger::log("Error writing to file: %s", fslib::error::get_string());
-                    // To do: Handle this somehow.
-                }
-
-                // Update count
-                BytesWritten += WriteCount;
-
-                // Update progress.
-                if (Task) { Task->SetCurrent(static_cast<double>(BytesWritten)); }
-            }
+    for (int UnzError = unzGoToFirstFile(Zip); UnzError == UNZ_OK; UnzError = unzGoToNextFile(Zip))
+    {
+        unz_file_info64 FileInfo           = {0};
+        char FileNameUTF8[fslib::MAX_PATH] = {0};
+        if (unzGetCurrentFileInfo64(Zip, &FileInfo, FileNameUTF8, fslib::MAX_PATH, NULL, 0, NULL, 0) != UNZ_OK) { continue; }
 
-            // Join read thread
-            ReadThread.join();
+        PreviousOut.Entries[FileNameUTF8] = {.Crc    = static_cast<uint32_t>(FileInfo.crc),
+                                             .Size   = FileInfo.uncompressed_size,
+                                             .Offset = unzGetOffset64(Zip)};
+    }
+}
 
-            // Close the destination file early just incase commit is required.
-            DestinationFile.close();
+// Returns the CRC32 of SourceFile. The file is left at the beginning.
+static uint32_t GetFileCrc(FS::BufferRing &Ring, fslib::File &SourceFile)
+{
+    uint32_t Crc = crc32(0, Z_NULL, 0);
+    FS::StartReadJob(SourceFile, Ring);
+    for (FS::BufferRing::Buffer *CrcBuffer = Ring.AcquireFull(); CrcBuffer; CrcBuffer = Ring.AcquireFull())
+    {
+        Crc = crc32(Crc, CrcBuffer->Data.get(), CrcBuffer->Size);
+        Ring.Release(CrcBuffer);
+    }
+    Ring.WaitForClose();
+    SourceFile.seek(0, fslib::Stream::BEGINNING);
+    return Crc;
+}
 
-            if (Commit && !fslib::control_device(FS::SAVE_MOUNT))
-            {
-                logger::log("Error committing save to device: %s", fslib::error::get_string());
-            }
+// Copies FileName's entry from the previous ZIP to Destination without inflating it if SourceFile still matches it. Returns
+// false if the file has to be compressed again. FailedOut is set if the entry was started but couldn't be finished.
+static bool CopyUnchangedEntry(PreviousZip &Previous,
+                               FS::BufferRing &Ring,
+                               fslib::File &SourceFile,
+                               zipFile Destination,
+                               const char *FileName,
+                               const zip_fileinfo &FileInfo,
+                               bool &FailedOut)
+{
+    FailedOut  = false;
+    auto Found = Previous.Entries.find(FileName);
+    if (Found == Previous.Entries.end() || Found->second.Size != static_cast<uint64_t>(SourceFile.get_size()) ||
+        Found->second.Crc != GetFileCrc(Ring, SourceFile))
+    {
+        return false;
+    }
+
+    int Method = 0, Level = 0;
+    if (unzSetOffset64(Previous.Zip, Found->second.Offset) != UNZ_OK ||
+        unzOpenCurrentFile2(Previous.Zip, &Method, &Level, 1) != UNZ_OK)
+    {
+        return false;
+    }
+    if (zipOpenNewFileInZip2(Destination, FileName, &FileInfo, NULL, 0, NULL, 0, NULL, Method, Level, 1) != ZIP_OK)
+    {
+        unzCloseCurrentFile(Previous.Zip);
+        return false;
+    }
+
+    // Nothing can fall back once the entry is open, so a failure from here on leaves it broken and the whole ZIP fails.
+    int ReadCount = 0;
+    while ((ReadCount = unzReadCurrentFile(Previous.Zip, Previous.Buffer.get(), FILE_BUFFER_SIZE)) > 0)
+    {
+        if (zipWriteInFileInZip(Destination, Previous.Buffer.get(), ReadCount) != ZIP_OK)
+        {
+            ReadCount = -1;
+            break;
         }
     }
+    unzCloseCurrentFile(Previous.Zip);
+    if (zipCloseFileInZipRaw(Destination, Found->second.Size, Found->second.Crc) != ZIP_OK || ReadCount < 0)
+    {
+        logger::log("Error copying %s from the previous ZIP.", FileName);
+        FailedOut = true;
+        return true;
+    }
+
+    ++Previous.FilesCopied;
+    Previous.BytesCopied += Found->second.Size;
+    return true;
 }
 
-void FS::CopyDirectoryToZip(System::ProgressTask *Task, const fslib::Path &Source, zipFile Destination)
+bool FS::CopyDirectoryToZip(System::ProgressTask *Task,
+                            const fslib::Path &Source,
+                            zipFile Destination,
+                            FS::CompressionPreference Preference,
+                            unzFile PreviousBackup)
 {
-    fslib::Directory SourceDir(Source);
-    if (!SourceDir.is_open())
+    BeginPoolWait();
+
+    PreviousZip Previous = {};
+    if (PreviousBackup) { LoadPreviousZip(PreviousBackup, Previous); }
+
+    // Entries are deflated on as many threads as large files are copied with.
+    FS::BufferRing Ring(FILE_BUFFER_COUNT, FILE_BUFFER_SIZE);
+    FS::BlockDeflater Deflater(FS::GetCopyWorkerCount());
+    FS::CompressionPolicy Policy(Preference);
+    bool Copied = CopyDirectoryToZipWithRing(Task,
+                                             Source,
+                                             Destination,
+                                             Ring,
+                                             Deflater,
+                                             Policy,
+                                             PreviousBackup ? &Previous : nullptr);
+
+    Policy.LogTotals();
+    if (PreviousBackup)
     {
-        logger::log("Error opening source directory: %s", fslib::error::get_string());
-        return;
+        logger::log("CopyDirectoryToZip: %u unchanged files (%llu bytes) copied from the previous ZIP.",
+                    Previous.FilesCopied,
+                    Previous.BytesCopied);
     }
+    LogPoolWait("CopyDirectoryToZip");
+    return Copied;
+}
 
-    for (uint32_t i = 0; i < SourceDir.get_count(); i++)
+static bool CopyDirectoryToZipWithRing(System::ProgressTask *Task,
+                                       const fslib::Path &Source,
+                                       zipFile Destination,
+                                       FS::BufferRing &Ring,
+                                       FS::BlockDeflater &Deflater,
+                                       FS::CompressionPolicy &Policy,
+                                       PreviousZip *Previous)
+{
+    FS::DirectoryWalker Walker(Source);
+    while (Walker.Next())
     {
-        if (SourceDir[i].is_directory())
+        // Directories aren't stored in the ZIP. They're created from the file paths when it's extracted.
+        if (Walker.GetEntry().is_directory()) { continue; }
+
+        // A ZIP missing a file can't stand in for the save, so any file that can't be added fails the whole thing.
+        fslib::File SourceFile(Walker.GetPath(), FS_OPEN_READ);
+        if (!SourceFile.is_open())
         {
-            fslib::Path NewSource = Source / SourceDir[i];
-            FS::CopyDirectoryToZip(Task, NewSource, Destination);
+            logger::log("Error opening source file for ZIP: %s", fslib::error::get_string());
+            return false;
         }
-        else
+
+        // Get time using C standard stuff cause I don't feel like doing it with ctrulib
+        std::time_t Timer;
+        std::time(&Timer);
+        std::tm *LocalTime = localtime(&Timer);
+
+        zip_fileinfo FileInfo = {.tmz_date    = {.tm_sec  = LocalTime->tm_sec,
+                                                 .tm_min  = LocalTime->tm_min,
+                                                 .tm_hour = LocalTime->tm_hour,
+                                                 .tm_mday = LocalTime->tm_mday,
+                                                 .tm_mon  = LocalTime->tm_mon,
+                                                 .tm_year = 1900 + LocalTime->tm_year},
+                                 .dosDate     = 0,
+                                 .internal_fa = 0,
+                                 .external_fa = 0};
+
+        // We need to convert the UTF16 to UTF for the zip. This is a pain thanks to 3DS needing UTF-16 paths, but here we
+        // go. Full path.
+        const fslib::Path &ZipFileName = Walker.GetPath();
+        // Get pointer to C string.
+        const char16_t *PathPointer = ZipFileName.full_path();
+        // Find where the path begins...
+        const char16_t *PathBegin = std::char_traits<char16_t>::find(PathPointer, ZipFileName.get_length(), u'/') + 1;
+        // Covert to UTF-8
+        char UTF8Buffer[fslib::MAX_PATH] = {0};
+        utf16_to_utf8(reinterpret_cast<uint8_t *>(UTF8Buffer),
+                      reinterpret_cast<const uint16_t *>(PathBegin),
+                      fslib::MAX_PATH);
+        // That should do it.
+
+        // Set task stuff.
+        uint64_t FileSize = SourceFile.get_size();
+        if (Task)
         {
-            fslib::Path FullSource = Source / SourceDir[i];
-            fslib::File SourceFile(FullSource, FS_OPEN_READ);
-            if (!SourceFile.is_open())
-            {
-                logger::log("Error opening source file for ZIP: %s", fslib::error::get_string());
-                continue;
-            }
+            Task->SetStatus(Strings::GetStringByName(Strings::Names::AddingToZip, 0), UTF8Buffer);
+            Task->Reset(static_cast<double>(FileSize));
+        }
 
-            // Get time using C standard stuff cause I don't feel like doing it with ctrulib
-            std::time_t Timer;
-            std::time(&Timer);
-            std::tm *LocalTime = localtime(&Timer);
-
-            zip_fileinfo FileInfo = {.tmz_date    = {.tm_sec  = LocalTime->tm_sec,
-                                                     .tm_min  = LocalTime->tm_min,
-                                                     .tm_hour = LocalTime->tm_hour,
-                                                     .tm_mday = LocalTime->tm_mday,
-                                                     .tm_mon  = LocalTime->tm_mon,
-                                                     .tm_year = 1900 + LocalTime->tm_year},
-                                     .dosDate     = 0,
-                                     .internal_fa = 0,
-                                     .external_fa = 0};
-
-            // We need to convert the UTF16 to UTF for the zip. This is a pain thanks to 3DS needing UTF-16 paths, but here we
-            // go. Full path.
-            fslib::Path ZipFileName = Source / SourceDir[i];
-            // Get pointer to C string.
-            const char16_t *PathPointer = ZipFileName.full_path();
-            // Find where the path begins...
-            const char16_t *PathBegin = std::char_traits<char16_t>::find(PathPointer, ZipFileName.get_length(), u'/') + 1;
-            // Covert to UTF-8
-            char UTF8Buffer[fslib::MAX_PATH] = {0};
-            utf16_to_utf8(reinterpret_cast<uint8_t *>(UTF8Buffer),
-                          reinterpret_cast<const uint16_t *>(PathBegin),
-                          fslib::MAX_PATH);
-            // That should do it.
-
-            int ZipError = zipOpenNewFileInZip(Destination, UTF8Buffer, &FileInfo, NULL, 0, NULL, 0, NULL, Z_DEFLATED, 1);
-            if (ZipError != Z_OK)
-            {
-                logger::log("Error opening file in ZIP: %i", ZipError);
-                continue;
-            }
+        bool CopyFailed = false;
+        if (Previous && CopyUnchangedEntry(*Previous, Ring, SourceFile, Destination, UTF8Buffer, FileInfo, CopyFailed))
+        {
+            if (CopyFailed) { return false; }
+            if (Task) { Task->SetCurrent(static_cast<double>(FileSize)); }
+            continue;
+        }
 
-            // Set task stuff.
-            if (Task)
+        // The read job fills the ring while this thread hands blocks to the deflater and writes what it finishes.
+        FS::StartReadJob(SourceFile, Ring);
+
+        // How the file is compressed is picked from its first buffer, so the entry can't be opened until that's read.
+        // Deflated entries are opened raw since they're deflated in blocks here instead of by minizip.
+        FS::BufferRing::Buffer *ZipBuffer = Ring.AcquireFull();
+        FS::CompressionPolicy::Method Choice =
+            Policy.Choose(ZipBuffer ? ZipBuffer->Data.get() : nullptr, ZipBuffer ? ZipBuffer->Size : 0, FileSize);
+        bool Stored  = Choice == FS::CompressionPolicy::Method::Store;
+        int Level    = FS::CompressionPolicy::GetLevel(Choice);
+        int ZipError = zipOpenNewFileInZip2(Destination,
+                                            UTF8Buffer,
+                                            &FileInfo,
+                                            NULL,
+                                            0,
+                                            NULL,
+                                            0,
+                                            NULL,
+                                            Stored ? 0 : Z_DEFLATED,
+                                            Level,
+                                            Stored ? 0 : 1);
+        if (ZipError != ZIP_OK)
+        {
+            logger::log("Error opening file in ZIP: %i", ZipError);
+            if (ZipBuffer) { Ring.Release(ZipBuffer); }
+            Ring.Cancel();
+            Ring.WaitForClose();
+            return false;
+        }
+        if (!Stored) { Deflater.Begin(Destination, Level); }
+
+        uint64_t TotalCopied = 0;
+        bool WriteFailed     = false;
+        for (; ZipBuffer; ZipBuffer = Ring.AcquireFull())
+        {
+            size_t BufferSize = ZipBuffer->Size;
+            WriteFailed       = Stored ? zipWriteInFileInZip(Destination, ZipBuffer->Data.get(), BufferSize) != ZIP_OK
+                                       : !Deflater.Update(ZipBuffer->Data.get(), BufferSize);
+            Ring.Release(ZipBuffer);
+            if (WriteFailed)
             {
-                Task->SetStatus(Strings::GetStringByName(Strings::Names::AddingToZip, 0), UTF8Buffer);
-                Task->Reset(static_cast<double>(SourceFile.get_size()));
+                Ring.Cancel();
+                break;
             }
+            TotalCopied += BufferSize;
 
-            uint32_t TotalCopied = 0;
-            std::unique_ptr<unsigned char[]> FileBuffer(new unsigned char[FILE_BUFFER_SIZE]);
-            while (TotalCopied < SourceFile.get_size())
-            {
-                uint32_t BytesRead = SourceFile.read(FileBuffer.get(), FILE_BUFFER_SIZE);
+            if (Task) { Task->SetCurrent(static_cast<double>(TotalCopied)); }
+        }
+        Ring.WaitForClose();
 
-                ZipError = zipWriteInFileInZip(Destination, FileBuffer.get(), BytesRead);
-                if (ZipError == Z_OK) { logger::log("%s", fslib::error::get_string()); }
-                TotalCopied += BytesRead;
+        // The entry is only closed if all of the file made it in. Closing it otherwise would give a short entry a CRC that
+        // matches. The blocks still with the deflater are waited for, but nothing more is written.
+        uint32_t Crc              = 0;
+        uint64_t UncompressedSize = TotalCopied, CompressedSize = TotalCopied;
+        bool Finished             = !WriteFailed && TotalCopied == FileSize;
+        if (!Stored && !Deflater.Finish(Crc, UncompressedSize, CompressedSize)) { Finished = false; }
+        if (!Finished)
+        {
+            logger::log("Error adding %s to ZIP: %llu of %llu bytes added.", UTF8Buffer, TotalCopied, FileSize);
+            return false;
+        }
 
-                if (Task) { Task->SetCurrent(TotalCopied); }
-            }
-            zipCloseFileInZip(Destination);
+        // Stored entries are finished by minizip itself.
+        ZipError = Stored ? zipCloseFileInZip(Destination) : zipCloseFileInZipRaw(Destination, UncompressedSize, Crc);
+        if (ZipError != ZIP_OK)
+        {
+            logger::log("Error closing %s in ZIP: %i", UTF8Buffer, ZipError);
+            return false;
         }
+        Policy.Record(UTF8Buffer, Choice, UncompressedSize, CompressedSize);
     }
+    return true;
 }
 
-void FS::CopyZipToDirectory(System::ProgressTask *Task, unzFile Source, const fslib::Path &Destination, bool Commit)
+// Returns what every entry in Source inflates to. Only the central directory is read.
+static uint64_t GetZipTotalSize(unzFile Source)
 {
-    logger::log("CopyZipToDir");
+    uint64_t TotalSize = 0;
+    for (int UnzError = unzGoToFirstFile(Source); UnzError == UNZ_OK; UnzError = unzGoToNextFile(Source))
+    {
+        unz_file_info64 FileInfo = {0};
+        if (unzGetCurrentFileInfo64(Source, &FileInfo, NULL, 0, NULL, 0, NULL, 0) == UNZ_OK)
+        {
+            TotalSize += FileInfo.uncompressed_size;
+        }
+    }
+    return TotalSize;
+}
+
+void FS::CopyZipToDirectory(System::ProgressTask *Task,
+                            unzFile Source,
+                            const fslib::Path &Destination,
+                            FS::Transaction *Transaction,
+                            const FS::Verification *Verify)
+{
+    // Only needed to read files back.
+    bool ReadBack = Verify && Verify->ReadBack;
+    std::unique_ptr<FS::BufferRing> VerifyRing;
+    if (ReadBack) { VerifyRing = std::make_unique<FS::BufferRing>(FILE_BUFFER_COUNT, FILE_BUFFER_SIZE); }
+    uint32_t FilesVerified = 0, VerifyFailures = 0;
+
+    // Entries are inflated into this here while a job on the I/O pool writes what's already inflated. Minizip stays on this
+    // thread since pool threads don't have the stack for it.
+    FS::BufferRing WriteRing(FILE_BUFFER_COUNT, FILE_BUFFER_SIZE);
+
+    // Progress and the rate are for the whole archive instead of starting over with every entry.
+    if (Task) { Task->SetOperationTotal(static_cast<double>(GetZipTotalSize(Source))); }
+    auto StartTime         = std::chrono::steady_clock::now();
+    uint32_t FilesRestored = 0;
+    uint64_t BytesRestored = 0;
 
     int UnzError = unzGoToFirstFile(Source);
     if (UnzError != UNZ_OK)
     {
         logger::log("Error opening file in zip for restore.");
-        Task->Finish();
+        if (Task) { Task->Finish(); }
         return;
     }
 
     do {
-        if (unzOpenCurrentFile(Source) != UNZ_OK)
-        {
-            logger::log("Error opening file in zip!");
-            continue;
-        }
-        logger::log("unzOpenCurrent");
-        // This really is all needed.
-        unz_file_info FileInfo                  = {0};
+        // This really is all needed. The entry is only opened once nothing else can skip it.
+        unz_file_info64 FileInfo                = {0};
         char FileNameUTF8[fslib::MAX_PATH]      = {0};
         char16_t FileNameUTF16[fslib::MAX_PATH] = {0};
-        if (unzGetCurrentFileInfo(Source, &FileInfo, FileNameUTF8, fslib::MAX_PATH, NULL, 0, NULL, 0) != UNZ_OK)
+        if (unzGetCurrentFileInfo64(Source, &FileInfo, FileNameUTF8, fslib::MAX_PATH, NULL, 0, NULL, 0) != UNZ_OK)
         {
             logger::log("Error reading file info from zip!");
             continue;
         }
-        logger::log("unzGetCurrentInfo");
+
+        // The secure value is restored separately. Same as folder backups, it doesn't belong in the save.
+        if (std::strcmp(FileNameUTF8, "._secure_value") == 0)
+        {
+            if (Task) { Task->Skip(static_cast<double>(FileInfo.uncompressed_size)); }
+            continue;
+        }
 
         // Convert to UTF-16 for Path
         StringUtil::ToUTF16(FileNameUTF8, FileNameUTF16, fslib::MAX_PATH);
         fslib::Path DestinationPath = Destination / FileNameUTF16;
-        logger::log("UTF-8 -> UTF-16");
 
         // Make sure we create entire path before file name.
         fslib::Path TargetDir = DestinationPath.sub_path(DestinationPath.find_last_of(u'/'));
 
-        char DirBuffer[0x40] = {0};
-        StringUtil::ToUTF8(TargetDir.full_path(), DirBuffer, 0x40);
-        logger::log("TargetDir: %s", DirBuffer);
-
         // Check to make sure it isn't the root, it doesn't exist already and if it was created.
         if (!(std::char_traits<char16_t>::compare(TargetDir.full_path(), u"save:", 6) == 0) &&
             !fslib::directory_exists(TargetDir) && !fslib::create_directory_recursively(TargetDir))
         {
             logger::log("Error creating target directory for restore: %s", fslib::error::get_string());
+            if (Task) { Task->Skip(static_cast<double>(FileInfo.uncompressed_size)); }
             continue;
         }
-        logger::log("Create target dir.");
 
+        if (unzOpenCurrentFile(Source) != UNZ_OK)
+        {
+            logger::log("Error opening file in zip!");
+            if (Task) { Task->Skip(static_cast<double>(FileInfo.uncompressed_size)); }
+            continue;
+        }
+
+        // Every path from here on closes the entry.
         fslib::File DestinationFile(DestinationPath, FS_OPEN_CREATE | FS_OPEN_WRITE, FileInfo.uncompressed_size);
         if (!DestinationFile.is_open())
         {
             logger::log("Error opening destination file for writing: %s", fslib::error::get_string());
+            unzCloseCurrentFile(Source);
+            if (Task) { Task->Skip(static_cast<double>(FileInfo.uncompressed_size)); }
             continue;
         }
-        logger::log("Destination file.");
 
-        int ReadCount = 0, TotalCount = 0;
-        std::unique_ptr<unsigned char[]> ReadBuffer(new unsigned char[FILE_BUFFER_SIZE]);
-        Task->SetStatus(Strings::GetStringByName(Strings::Names::CopyingFile, 0), FileNameUTF8);
-        while ((ReadCount = unzReadCurrentFile(Source, ReadBuffer.get(), FILE_BUFFER_SIZE)) > 0)
+        FS::Hash64 FileHash;
+        bool WriteFailed = false;
+        StartWriteJob(DestinationFile, WriteRing, ReadBack ? &FileHash : nullptr, WriteFailed);
+
+        uint64_t TotalCount = 0;
+        if (Task)
+        {
+            Task->SetStatus(Strings::GetStringByName(Strings::Names::CopyingFile, 0), FileNameUTF8);
+            Task->Reset(static_cast<double>(FileInfo.uncompressed_size));
+        }
+        for (FS::BufferRing::Buffer *InflateBuffer = WriteRing.AcquireEmpty(); InflateBuffer;
+             InflateBuffer = WriteRing.AcquireEmpty())
+        {
+            int ReadCount = unzReadCurrentFile(Source, InflateBuffer->Data.get(), FILE_BUFFER_SIZE);
+            if (ReadCount <= 0)
+            {
+                if (ReadCount < 0) { logger::log("Error inflating %s from ZIP.", FileNameUTF8); }
+                WriteRing.Release(InflateBuffer);
+                break;
+            }
+
+            InflateBuffer->Size = static_cast<size_t>(ReadCount);
+            WriteRing.PushFull(InflateBuffer);
+            TotalCount += ReadCount;
+            if (Task) { Task->SetCurrent(static_cast<double>(TotalCount)); }
+        }
+        // The file can't be closed until the job is done with it.
+        WriteRing.Close();
+        WriteRing.WaitForFinish();
+        DestinationFile.close();
+        if (WriteFailed) { logger::log("Error restoring %s from ZIP.", FileNameUTF8); }
+        ++FilesRestored;
+        BytesRestored += TotalCount;
+
+        // Minizip checks the entry's CRC32 against what it decompressed when it's closed.
+        if (unzCloseCurrentFile(Source) == UNZ_CRCERROR)
         {
-            DestinationFile.write(ReadBuffer.get(), static_cast<size_t>(ReadCount));
-            Task->SetCurrent((TotalCount += ReadCount));
+            logger::log("Verification failed: %s doesn't match the CRC stored in the ZIP.", FileNameUTF8);
+            ++VerifyFailures;
         }
 
-        if (Commit)
+        if (ReadBack)
         {
-            DestinationFile.close();
-            fslib::control_device(FS::SAVE_MOUNT);
+            ++FilesVerified;
+            fslib::File WrittenFile(DestinationPath, FS_OPEN_READ);
+            if (!WrittenFile.is_open() || HashFile(*VerifyRing, WrittenFile, nullptr) != FileHash.Finish())
+            {
+                logger::log("Verification failed: %s doesn't match what was read.", FileNameUTF8);
+                ++VerifyFailures;
+            }
         }
+
+        if (Transaction) { Transaction->FileWritten(FileInfo.uncompressed_size); }
     } while (unzGoToNextFile(Source) != UNZ_END_OF_LIST_OF_FILE);
+
+    auto Elapsed         = std::chrono::steady_clock::now() - StartTime;
+    uint64_t ElapsedTime = std::chrono::duration_cast<std::chrono::microseconds>(Elapsed).count();
+    double Rate          = ElapsedTime > 0 ? static_cast<double>(BytesRestored) / ElapsedTime : 0;
+    logger::log("CopyZipToDirectory: %u files, %llu bytes in %llums (%.2f MB/s).",
+                FilesRestored,
+                BytesRestored,
+                ElapsedTime / 1000,
+                Rate * 1000000.0f / 1048576.0f);
+
+    if (FilesVerified > 0 || VerifyFailures > 0)
+    {
+        logger::log("CopyZipToDirectory: %u files verified, %u failed.", FilesVerified, VerifyFailures);
+    }
 }
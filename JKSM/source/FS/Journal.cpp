@@ -0,0 +1,178 @@
+#include "FS/Journal.hpp"
+
+#include "logging/logger.hpp"
+
+#include <cstring>
+#include <memory>
+
+namespace
+{
+    // JKJN
+    constexpr uint32_t JOURNAL_MAGIC = 0x4E4A4B4A;
+    // Current revision of the journal format.
+    constexpr uint8_t JOURNAL_REVISION = 0x01;
+
+    // Record types.
+    enum
+    {
+        RECORD_COMPLETED,
+        RECORD_PROGRESS
+    };
+
+    // Header at the beginning of the journal. It's followed by the source and destination paths.
+    typedef struct
+    {
+            uint32_t Magic;
+            uint8_t Revision;
+            uint16_t SourceLength;
+            uint16_t DestinationLength;
+    } __attribute__((packed)) JournalHeader;
+
+    // Each record is this followed by PathLength UTF-16 characters. Size is the offset for progress records.
+    typedef struct
+    {
+            uint8_t Type;
+            uint64_t Size;
+            uint64_t Hash;
+            uint16_t PathLength;
+    } __attribute__((packed)) JournalRecord;
+} // namespace
+
+// Appends Size bytes of Data to Buffer.
+static inline void AppendBytes(std::vector<unsigned char> &Buffer, const void *Data, size_t Size)
+{
+    const unsigned char *Bytes = static_cast<const unsigned char *>(Data);
+    Buffer.insert(Buffer.end(), Bytes, Bytes + Size);
+}
+
+FS::Journal::Journal(const fslib::Path &JournalPath)
+    : m_JournalPath(JournalPath) {};
+
+bool FS::Journal::Begin(const fslib::Path &Source, const fslib::Path &Destination)
+{
+    m_Completed.clear();
+    m_PartialPath.clear();
+    m_PartialOffset = 0;
+    m_Pending.clear();
+
+    // This is what the journal's header should look like for this copy.
+    std::vector<unsigned char> Header;
+    JournalHeader HeaderData = {.Magic             = JOURNAL_MAGIC,
+                                .Revision          = JOURNAL_REVISION,
+                                .SourceLength      = static_cast<uint16_t>(Source.get_length()),
+                                .DestinationLength = static_cast<uint16_t>(Destination.get_length())};
+    AppendBytes(Header, &HeaderData, sizeof(JournalHeader));
+    AppendBytes(Header, Source.full_path(), Source.get_length() * sizeof(char16_t));
+    AppendBytes(Header, Destination.full_path(), Destination.get_length() * sizeof(char16_t));
+
+    {
+        fslib::File JournalFile(m_JournalPath, FS_OPEN_READ);
+        size_t JournalSize = JournalFile.is_open() ? static_cast<size_t>(JournalFile.get_size()) : 0;
+        if (JournalSize >= Header.size())
+        {
+            std::unique_ptr<unsigned char[]> Data(new unsigned char[JournalSize]);
+            if (JournalFile.read(Data.get(), JournalSize) == static_cast<ssize_t>(JournalSize) &&
+                std::memcmp(Data.get(), Header.data(), Header.size()) == 0)
+            {
+                // A journal with nothing in it yet has nothing to resume.
+                Journal::LoadRecords(&Data[Header.size()], JournalSize - Header.size());
+                if (m_Completed.empty() && m_PartialPath.empty()) { return false; }
+
+                logger::log("Resuming interrupted copy. %zu file(s) already done.", m_Completed.size());
+                return true;
+            }
+        }
+    }
+
+    // Different or no copy. Start over.
+    fslib::File JournalFile(m_JournalPath, FS_OPEN_CREATE | FS_OPEN_WRITE, Header.size());
+    if (!JournalFile.is_open() || JournalFile.write(Header.data(), Header.size()) != static_cast<ssize_t>(Header.size()))
+    {
+        logger::log("Error creating copy journal: %s", fslib::error::get_string());
+    }
+    return false;
+}
+
+const FS::Journal::CompletedFile *FS::Journal::FindCompleted(std::u16string_view RelativePath) const
+{
+    auto FindFile = m_Completed.find(std::u16string(RelativePath));
+    if (FindFile == m_Completed.end()) { return nullptr; }
+    return &FindFile->second;
+}
+
+uint64_t FS::Journal::GetResumeOffset(std::u16string_view RelativePath) const
+{
+    return RelativePath == m_PartialPath ? m_PartialOffset : 0;
+}
+
+void FS::Journal::FileCompleted(std::u16string_view RelativePath, uint64_t Size, uint64_t Hash)
+{
+    Journal::AddRecord(RECORD_COMPLETED, RelativePath, Size, Hash);
+}
+
+void FS::Journal::FileProgress(std::u16string_view RelativePath, uint64_t Offset)
+{
+    Journal::AddRecord(RECORD_PROGRESS, RelativePath, Offset, 0);
+}
+
+void FS::Journal::Flush()
+{
+    if (m_Pending.empty()) { return; }
+
+    fslib::File JournalFile(m_JournalPath, FS_OPEN_WRITE | FS_OPEN_APPEND);
+    ssize_t PendingSize = static_cast<ssize_t>(m_Pending.size());
+    if (!JournalFile.is_open() || JournalFile.write(m_Pending.data(), m_Pending.size()) != PendingSize)
+    {
+        logger::log("Error writing to copy journal: %s", fslib::error::get_string());
+    }
+    m_Pending.clear();
+}
+
+void FS::Journal::Finish()
+{
+    m_Pending.clear();
+    if (fslib::file_exists(m_JournalPath) && !fslib::delete_file(m_JournalPath))
+    {
+        logger::log("Error deleting copy journal: %s", fslib::error::get_string());
+    }
+}
+
+void FS::Journal::AddRecord(uint8_t Type, std::u16string_view RelativePath, uint64_t Size, uint64_t Hash)
+{
+    JournalRecord Record = {.Type       = Type,
+                            .Size       = Size,
+                            .Hash       = Hash,
+                            .PathLength = static_cast<uint16_t>(RelativePath.length())};
+    AppendBytes(m_Pending, &Record, sizeof(JournalRecord));
+    AppendBytes(m_Pending, RelativePath.data(), RelativePath.length() * sizeof(char16_t));
+}
+
+void FS::Journal::LoadRecords(const unsigned char *Data, size_t DataSize)
+{
+    // A record cut off by the interruption just ends the loop.
+    size_t Offset = 0;
+    while (Offset + sizeof(JournalRecord) <= DataSize)
+    {
+        JournalRecord Record;
+        std::memcpy(&Record, &Data[Offset], sizeof(JournalRecord));
+        Offset += sizeof(JournalRecord);
+
+        size_t PathBytes = Record.PathLength * sizeof(char16_t);
+        if (Offset + PathBytes > DataSize) { break; }
+
+        std::u16string RecordPath(Record.PathLength, u'\0');
+        std::memcpy(RecordPath.data(), &Data[Offset], PathBytes);
+        Offset += PathBytes;
+
+        if (Record.Type == RECORD_COMPLETED)
+        {
+            if (RecordPath == m_PartialPath) { m_PartialPath.clear(); }
+            m_Completed[std::move(RecordPath)] = {Record.Size, Record.Hash};
+        }
+        else
+        {
+            m_PartialPath   = std::move(RecordPath);
+            m_PartialOffset = Record.Size;
+        }
+    }
+}
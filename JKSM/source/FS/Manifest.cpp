@@ -0,0 +1,365 @@
+#include "FS/Manifest.hpp"
+
+#include "FS/DirectoryWalker.hpp"
+#include "FS/Hash.hpp"
+#include "FS/IO.hpp"
+#include "logging/logger.hpp"
+
+#include <cstring>
+#include <memory>
+
+namespace
+{
+    // JKMF
+    constexpr uint32_t MANIFEST_MAGIC = 0x464D4B4A;
+    // Current revision of the format. Revision 1 doesn't have zero runs.
+    constexpr uint8_t MANIFEST_REVISION = 0x02;
+    // Size of the buffer used to hash files already in the destination.
+    constexpr size_t HASH_BUFFER_SIZE = 0x10000;
+
+    // Header at the beginning of the file.
+    typedef struct
+    {
+            uint32_t Magic;
+            uint8_t Revision;
+            uint32_t Generation;
+            uint32_t EntryCount;
+    } __attribute__((packed)) ManifestHeader;
+
+    // Each entry is this followed by PathLength and ReferenceLength UTF-16 characters. From revision 2 on those are followed
+    // by a uint32_t count and that many zero runs.
+    typedef struct
+    {
+            uint64_t Size;
+            uint64_t Hash;
+            uint16_t PathLength;
+            uint16_t ReferenceLength;
+    } __attribute__((packed)) ManifestEntry;
+} // namespace
+
+// Appends Size bytes of Data to Buffer.
+static inline void AppendBytes(std::vector<unsigned char> &Buffer, const void *Data, size_t Size)
+{
+    const unsigned char *Bytes = static_cast<const unsigned char *>(Data);
+    Buffer.insert(Buffer.end(), Bytes, Bytes + Size);
+}
+
+// Reads and validates the header of the manifest in BackupPath.
+static bool ReadHeader(fslib::File &ManifestFile, ManifestHeader &HeaderOut)
+{
+    if (!ManifestFile.is_open() || ManifestFile.read(&HeaderOut, sizeof(ManifestHeader)) != sizeof(ManifestHeader))
+    {
+        return false;
+    }
+    return HeaderOut.Magic == MANIFEST_MAGIC && HeaderOut.Revision >= 0x01 && HeaderOut.Revision <= MANIFEST_REVISION;
+}
+
+bool FS::Manifest::Load(const fslib::Path &BackupPath)
+{
+    fslib::File ManifestFile(BackupPath / FILE_NAME, FS_OPEN_READ);
+
+    ManifestHeader Header;
+    if (!ReadHeader(ManifestFile, Header)) { return false; }
+
+    // Read the rest in one go and parse it from memory.
+    size_t DataSize = static_cast<size_t>(ManifestFile.get_size()) - sizeof(ManifestHeader);
+    std::unique_ptr<unsigned char[]> Data(new unsigned char[DataSize]);
+    if (ManifestFile.read(Data.get(), DataSize) != static_cast<ssize_t>(DataSize))
+    {
+        logger::log("Error reading backup manifest: %s", fslib::error::get_string());
+        return false;
+    }
+
+    m_Entries.clear();
+    m_EntryMap.clear();
+    m_Generation = Header.Generation;
+
+    size_t Offset = 0;
+    for (uint32_t i = 0; i < Header.EntryCount; i++)
+    {
+        ManifestEntry CurrentEntry;
+        if (Offset + sizeof(ManifestEntry) > DataSize) { return false; }
+        std::memcpy(&CurrentEntry, &Data[Offset], sizeof(ManifestEntry));
+        Offset += sizeof(ManifestEntry);
+
+        size_t StringBytes = (CurrentEntry.PathLength + CurrentEntry.ReferenceLength) * sizeof(char16_t);
+        if (Offset + StringBytes > DataSize) { return false; }
+
+        const char16_t *Path      = reinterpret_cast<const char16_t *>(&Data[Offset]);
+        const char16_t *Reference = Path + CurrentEntry.PathLength;
+        Entry NewEntry            = {.Path      = std::u16string(Path, CurrentEntry.PathLength),
+                                     .Size      = CurrentEntry.Size,
+                                     .Hash      = CurrentEntry.Hash,
+                                     .Reference = std::u16string(Reference, CurrentEntry.ReferenceLength),
+                                     .ZeroRuns  = {}};
+        Offset += StringBytes;
+
+        if (Header.Revision >= 0x02)
+        {
+            uint32_t ZeroRunCount = 0;
+            if (Offset + sizeof(uint32_t) > DataSize) { return false; }
+            std::memcpy(&ZeroRunCount, &Data[Offset], sizeof(uint32_t));
+            Offset += sizeof(uint32_t);
+
+            size_t ZeroRunBytes = ZeroRunCount * sizeof(Manifest::ZeroRun);
+            if (Offset + ZeroRunBytes > DataSize) { return false; }
+            NewEntry.ZeroRuns.resize(ZeroRunCount);
+            std::memcpy(NewEntry.ZeroRuns.data(), &Data[Offset], ZeroRunBytes);
+            Offset += ZeroRunBytes;
+        }
+
+        Manifest::AddEntry(std::move(NewEntry));
+    }
+    return true;
+}
+
+bool FS::Manifest::Save(const fslib::Path &BackupPath) const
+{
+    // Build the whole thing in memory so it's a single write.
+    std::vector<unsigned char> Buffer;
+    ManifestHeader Header = {.Magic      = MANIFEST_MAGIC,
+                             .Revision   = MANIFEST_REVISION,
+                             .Generation = m_Generation,
+                             .EntryCount = static_cast<uint32_t>(m_Entries.size())};
+    AppendBytes(Buffer, &Header, sizeof(ManifestHeader));
+
+    for (const Entry &CurrentEntry : m_Entries)
+    {
+        ManifestEntry OutEntry = {.Size            = CurrentEntry.Size,
+                                  .Hash            = CurrentEntry.Hash,
+                                  .PathLength      = static_cast<uint16_t>(CurrentEntry.Path.length()),
+                                  .ReferenceLength = static_cast<uint16_t>(CurrentEntry.Reference.length())};
+        AppendBytes(Buffer, &OutEntry, sizeof(ManifestEntry));
+        AppendBytes(Buffer, CurrentEntry.Path.data(), CurrentEntry.Path.length() * sizeof(char16_t));
+        AppendBytes(Buffer, CurrentEntry.Reference.data(), CurrentEntry.Reference.length() * sizeof(char16_t));
+
+        uint32_t ZeroRunCount = static_cast<uint32_t>(CurrentEntry.ZeroRuns.size());
+        AppendBytes(Buffer, &ZeroRunCount, sizeof(uint32_t));
+        AppendBytes(Buffer, CurrentEntry.ZeroRuns.data(), ZeroRunCount * sizeof(Manifest::ZeroRun));
+    }
+
+    fslib::File ManifestFile(BackupPath / FILE_NAME, FS_OPEN_CREATE | FS_OPEN_WRITE, Buffer.size());
+    if (!ManifestFile.is_open() || ManifestFile.write(Buffer.data(), Buffer.size()) != static_cast<ssize_t>(Buffer.size()))
+    {
+        logger::log("Error writing backup manifest: %s", fslib::error::get_string());
+        return false;
+    }
+    return true;
+}
+
+void FS::Manifest::AddEntry(Entry NewEntry)
+{
+    m_EntryMap[NewEntry.Path] = m_Entries.size();
+    m_Entries.push_back(std::move(NewEntry));
+}
+
+const FS::Manifest::Entry *FS::Manifest::FindEntry(std::u16string_view Path) const
+{
+    auto FindEntry = m_EntryMap.find(std::u16string(Path));
+    if (FindEntry == m_EntryMap.end()) { return nullptr; }
+    return &m_Entries[FindEntry->second];
+}
+
+std::vector<FS::Manifest::Entry> &FS::Manifest::GetEntries() { return m_Entries; }
+
+const std::vector<FS::Manifest::Entry> &FS::Manifest::GetEntries() const { return m_Entries; }
+
+uint32_t FS::Manifest::GetGeneration() const { return m_Generation; }
+
+void FS::Manifest::SetGeneration(uint32_t Generation) { m_Generation = Generation; }
+
+bool FS::Manifest::ReadGeneration(const fslib::Path &BackupPath, uint32_t &GenerationOut)
+{
+    fslib::File ManifestFile(BackupPath / FILE_NAME, FS_OPEN_READ);
+
+    ManifestHeader Header;
+    if (!ReadHeader(ManifestFile, Header)) { return false; }
+
+    GenerationOut = Header.Generation;
+    return true;
+}
+
+uint64_t FS::GetZeroRunTotal(const std::vector<FS::Manifest::ZeroRun> &ZeroRuns)
+{
+    uint64_t Total = 0;
+    for (const FS::Manifest::ZeroRun &CurrentRun : ZeroRuns) { Total += CurrentRun.Length; }
+    return Total;
+}
+
+std::u16string FS::GetStoredPath(const FS::Manifest::Entry &Entry)
+{
+    if (Entry.ZeroRuns.empty()) { return Entry.Path; }
+    return Entry.Path + std::u16string(FS::Manifest::COMPACTED_SUFFIX);
+}
+
+bool FS::HasCompactedFiles(const fslib::Path &BackupPath)
+{
+    FS::DirectoryWalker Walker(BackupPath);
+    while (Walker.Next())
+    {
+        if (!Walker.GetEntry().is_directory() && Walker.GetRelativePath().ends_with(FS::Manifest::COMPACTED_SUFFIX))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FS::LoadLatestManifest(const fslib::Path &TitlePath,
+                            std::u16string_view Exclude,
+                            FS::Manifest &ManifestOut,
+                            std::u16string &NameOut)
+{
+    fslib::Directory TitleDir(TitlePath);
+    if (!TitleDir.is_open()) { return false; }
+
+    // Only the headers are read to find the newest.
+    bool Found                 = false;
+    uint32_t HighestGeneration = 0;
+    for (uint32_t i = 0; i < TitleDir.get_count(); i++)
+    {
+        uint32_t Generation = 0;
+        if (!TitleDir[i].is_directory() || Exclude == TitleDir[i].get_filename() ||
+            !FS::Manifest::ReadGeneration(TitlePath / TitleDir[i], Generation) || (Found && Generation <= HighestGeneration))
+        {
+            continue;
+        }
+        Found             = true;
+        HighestGeneration = Generation;
+        NameOut           = TitleDir[i].get_filename();
+    }
+
+    return Found && ManifestOut.Load(TitlePath / NameOut);
+}
+
+// Makes sure the directory FilePath is in exists.
+static bool CreateParentDirectory(const fslib::Path &FilePath)
+{
+    fslib::Path ParentDir = FilePath.sub_path(FilePath.find_last_of(u'/'));
+    // The root of a device always exists.
+    if (ParentDir.find_first_of(u'/') == fslib::Path::npos) { return true; }
+    return fslib::directory_exists(ParentDir) || fslib::create_directory_recursively(ParentDir);
+}
+
+// Returns whether the file at FilePath has the size and hash passed. Buffer is used for reading.
+static bool FileHashMatches(const fslib::Path &FilePath, uint64_t Size, uint64_t Hash, unsigned char *Buffer, size_t BufferSize)
+{
+    fslib::File CurrentFile(FilePath, FS_OPEN_READ);
+    if (!CurrentFile.is_open() || static_cast<uint64_t>(CurrentFile.get_size()) != Size) { return false; }
+
+    FS::Hash64 FileHash;
+    for (uint64_t TotalRead = 0; TotalRead < Size;)
+    {
+        ssize_t BytesRead = CurrentFile.read(Buffer, BufferSize);
+        if (BytesRead <= 0) { return false; }
+
+        FileHash.Update(Buffer, BytesRead);
+        TotalRead += BytesRead;
+    }
+    return FileHash.Finish() == Hash;
+}
+
+void FS::RestoreManifestReferences(System::ProgressTask *Task,
+                                   const fslib::Path &TitlePath,
+                                   const fslib::Path &BackupPath,
+                                   const fslib::Path &Destination,
+                                   FS::Transaction *Transaction,
+                                   bool Differential)
+{
+    FS::Manifest BackupManifest;
+    if (!BackupManifest.Load(BackupPath)) { return; }
+
+    // Only needed to hash what's already there.
+    std::unique_ptr<unsigned char[]> HashBuffer;
+    if (Differential) { HashBuffer = std::make_unique<unsigned char[]>(HASH_BUFFER_SIZE); }
+
+    uint64_t BytesMatched = 0;
+    for (const FS::Manifest::Entry &CurrentEntry : BackupManifest.GetEntries())
+    {
+        if (CurrentEntry.Reference.empty()) { continue; }
+
+        fslib::Path Source          = TitlePath / CurrentEntry.Reference / FS::GetStoredPath(CurrentEntry);
+        fslib::Path FullDestination = Destination / CurrentEntry.Path;
+        if (Differential &&
+            FileHashMatches(FullDestination, CurrentEntry.Size, CurrentEntry.Hash, HashBuffer.get(), HASH_BUFFER_SIZE))
+        {
+            BytesMatched += CurrentEntry.Size;
+            continue;
+        }
+
+        if (!CreateParentDirectory(FullDestination))
+        {
+            logger::log("Error creating directory for referenced file: %s", fslib::error::get_string());
+            continue;
+        }
+        // Zero runs the other backup left out are written back as it's copied.
+        FS::CopyFile(Task, Source, FullDestination, Transaction, &CurrentEntry.ZeroRuns);
+    }
+
+    if (Differential) { logger::log("Referenced files: %llu bytes matched and weren't written.", BytesMatched); }
+}
+
+bool FS::ReleaseManifestReferences(System::ProgressTask *Task, const fslib::Path &TitlePath, std::u16string_view BackupName)
+{
+    fslib::Directory TitleDir(TitlePath);
+    if (!TitleDir.is_open())
+    {
+        logger::log("Error opening title directory to release references: %s", fslib::error::get_string());
+        return false;
+    }
+
+    // Path -> Backup that now holds the data. The first backup that needs a file gets the copy and the rest point to it.
+    std::unordered_map<std::u16string, std::u16string> NewHolders;
+    bool Released = true;
+    for (uint32_t i = 0; i < TitleDir.get_count(); i++)
+    {
+        if (!TitleDir[i].is_directory() || BackupName == TitleDir[i].get_filename()) { continue; }
+
+        fslib::Path SiblingPath = TitlePath / TitleDir[i];
+        FS::Manifest SiblingManifest;
+        if (!SiblingManifest.Load(SiblingPath)) { continue; }
+
+        bool Changed = false;
+        for (FS::Manifest::Entry &CurrentEntry : SiblingManifest.GetEntries())
+        {
+            if (CurrentEntry.Reference != BackupName) { continue; }
+
+            auto FindHolder = NewHolders.find(CurrentEntry.Path);
+            if (FindHolder != NewHolders.end())
+            {
+                CurrentEntry.Reference = FindHolder->second;
+                Changed                = true;
+                continue;
+            }
+
+            // The file is stored the same way in both backups.
+            std::u16string StoredPath   = FS::GetStoredPath(CurrentEntry);
+            fslib::Path Source          = TitlePath / BackupName / StoredPath;
+            fslib::Path FullDestination = SiblingPath / StoredPath;
+            if (!CreateParentDirectory(FullDestination))
+            {
+                logger::log("Error creating directory for released file: %s", fslib::error::get_string());
+                Released = false;
+                continue;
+            }
+            // The file is moved as it's stored. The entry already has its zero runs. If the copy fails, the entry keeps
+            // pointing at BackupName so the data isn't lost.
+            if (!FS::CopyFile(Task, Source, FullDestination, nullptr, nullptr))
+            {
+                Released = false;
+                continue;
+            }
+
+            NewHolders[CurrentEntry.Path] = TitleDir[i].get_filename();
+            CurrentEntry.Reference.clear();
+            Changed = true;
+        }
+
+        if (Changed && !SiblingManifest.Save(SiblingPath))
+        {
+            logger::log("Error saving manifest after releasing references.");
+            Released = false;
+        }
+    }
+    return Released;
+}
@@ -0,0 +1,91 @@
+#include "FS/PathBuilder.hpp"
+
+#include <3ds.h>
+#include <algorithm>
+
+FS::PathBuilder::PathBuilder(const fslib::Path &Root)
+{
+    // Saves a few reallocations when the walk starts.
+    m_Buffer.reserve(fslib::MAX_PATH);
+    PathBuilder::SetRoot(std::u16string_view(Root.full_path(), Root.get_length()));
+}
+
+void FS::PathBuilder::SetRoot(std::u16string_view Root)
+{
+    m_Buffer.assign(Root);
+    // Relative paths start after the slash following the root.
+    m_RootLength = m_Buffer.length();
+    if (m_RootLength > 0 && m_Buffer.back() != u'/') { ++m_RootLength; }
+
+    m_PathCurrent = false;
+    m_UTF8Current = false;
+}
+
+void FS::PathBuilder::Assign(std::u16string_view Path)
+{
+    m_Buffer.assign(Path);
+
+    m_PathCurrent = false;
+    m_UTF8Current = false;
+}
+
+void FS::PathBuilder::Append(std::u16string_view Name)
+{
+    if (!m_Buffer.empty() && m_Buffer.back() != u'/') { m_Buffer += u'/'; }
+    m_Buffer.append(Name);
+
+    m_PathCurrent = false;
+    m_UTF8Current = false;
+}
+
+void FS::PathBuilder::Truncate(size_t Length)
+{
+    if (Length >= m_Buffer.length()) { return; }
+    m_Buffer.resize(Length);
+
+    m_PathCurrent = false;
+    m_UTF8Current = false;
+}
+
+void FS::PathBuilder::SetRelative(std::u16string_view RelativePath)
+{
+    // Anything longer than the root is cut back to the slash after it. The root alone might not have one yet.
+    if (m_Buffer.length() >= m_RootLength) { m_Buffer.resize(m_RootLength); }
+    else { m_Buffer += u'/'; }
+    m_Buffer.append(RelativePath);
+
+    m_PathCurrent = false;
+    m_UTF8Current = false;
+}
+
+size_t FS::PathBuilder::GetLength() const { return m_Buffer.length(); }
+
+const fslib::Path &FS::PathBuilder::GetPath()
+{
+    if (!m_PathCurrent)
+    {
+        m_Path        = std::u16string_view(m_Buffer);
+        m_PathCurrent = true;
+    }
+    return m_Path;
+}
+
+std::u16string_view FS::PathBuilder::GetRelativePath() const
+{
+    if (m_RootLength >= m_Buffer.length()) { return std::u16string_view(); }
+    return std::u16string_view(m_Buffer).substr(m_RootLength);
+}
+
+const char *FS::PathBuilder::GetUTF8()
+{
+    if (!m_UTF8Current)
+    {
+        // The conversion doesn't terminate the string itself.
+        ssize_t Length = utf16_to_utf8(reinterpret_cast<uint8_t *>(m_UTF8),
+                                       reinterpret_cast<const uint16_t *>(m_Buffer.c_str()),
+                                       fslib::MAX_PATH - 1);
+        m_UTF8[Length < 0 ? 0 : std::min<size_t>(Length, fslib::MAX_PATH - 1)] = '\0';
+        m_UTF8Current                                                        = true;
+    }
+    return m_UTF8;
+}
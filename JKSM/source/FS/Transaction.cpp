@@ -0,0 +1,48 @@
+#include "FS/Transaction.hpp"
+
+#include "fslib.hpp"
+#include "logging/logger.hpp"
+
+#include <chrono>
+
+FS::Transaction::Transaction(std::u16string_view Device, uint64_t CommitInterval)
+    : m_Device(Device)
+    , m_CommitInterval(CommitInterval) {};
+
+bool FS::Transaction::FileWritten(uint64_t Size)
+{
+    m_PendingBytes += Size;
+    m_HasPendingWrites = true;
+    if (m_CommitInterval == 0 || m_PendingBytes < m_CommitInterval) { return false; }
+
+    Transaction::Commit();
+    return true;
+}
+
+bool FS::Transaction::Finish()
+{
+    if (m_HasPendingWrites) { Transaction::Commit(); }
+
+    logger::log("Transaction finished: %u commit(s) taking %llums total.", m_CommitCount, m_CommitTime / 1000);
+    return !m_CommitFailed;
+}
+
+uint32_t FS::Transaction::GetCommitCount() const { return m_CommitCount; }
+
+uint64_t FS::Transaction::GetCommitTime() const { return m_CommitTime; }
+
+void FS::Transaction::Commit()
+{
+    auto CommitStart = std::chrono::steady_clock::now();
+    if (!fslib::control_device(m_Device))
+    {
+        logger::log("Error committing save to device: %s", fslib::error::get_string());
+        m_CommitFailed = true;
+    }
+    m_CommitTime +=
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - CommitStart).count();
+
+    m_CommitCount++;
+    m_PendingBytes     = 0;
+    m_HasPendingWrites = false;
+}
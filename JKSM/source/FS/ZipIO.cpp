@@ -0,0 +1,212 @@
+#include "FS/ZipIO.hpp"
+
+#include "logging/logger.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace
+{
+    // Size of the buffer writes are gathered in and reads are served from.
+    constexpr size_t ZIP_BUFFER_SIZE = 0x20000;
+} // namespace
+
+// This is what minizip gets instead of a FILE. The buffer either holds writes that haven't reached the file yet or data that
+// was read ahead. Either way it covers BufferSize bytes of the file starting at BufferOffset.
+typedef struct
+{
+        fslib::File File;
+        std::unique_ptr<unsigned char[]> Buffer;
+        uint64_t BufferOffset;
+        size_t BufferSize;
+        // Whether the buffer holds writes.
+        bool Writing;
+        // Where minizip is in the file.
+        uint64_t Position;
+        // Set when a write fails. Minizip checks it when the archive is closed.
+        bool Error;
+} ZipStream;
+
+// Writes whatever is waiting in the buffer to the file and empties it.
+static void FlushStream(ZipStream *Stream)
+{
+    if (Stream->Writing && Stream->BufferSize > 0)
+    {
+        Stream->File.seek(Stream->BufferOffset, fslib::Stream::BEGINNING);
+        if (Stream->File.write(Stream->Buffer.get(), Stream->BufferSize) != static_cast<ssize_t>(Stream->BufferSize))
+        {
+            logger::log("Error writing ZIP: %s", fslib::error::get_string());
+            Stream->Error = true;
+        }
+    }
+    Stream->BufferSize = 0;
+    Stream->Writing    = false;
+}
+
+static voidpf ZCALLBACK OpenStream(voidpf Opaque, const void *FileName, int Mode)
+{
+    const fslib::Path *ZipPath = reinterpret_cast<const fslib::Path *>(FileName);
+
+    // New archives replace what's there. Archives opened to be added to need to be read too.
+    uint32_t OpenFlags = FS_OPEN_READ;
+    if (Mode & ZLIB_FILEFUNC_MODE_CREATE) { OpenFlags = FS_OPEN_CREATE | FS_OPEN_WRITE; }
+    else if (Mode & ZLIB_FILEFUNC_MODE_WRITE) { OpenFlags = FS_OPEN_READ | FS_OPEN_WRITE; }
+
+    std::unique_ptr<ZipStream> Stream(new ZipStream());
+    Stream->File.open(*ZipPath, OpenFlags);
+    if (!Stream->File.is_open())
+    {
+        logger::log("Error opening ZIP: %s", fslib::error::get_string());
+        return nullptr;
+    }
+    Stream->Buffer = std::unique_ptr<unsigned char[]>(new unsigned char[ZIP_BUFFER_SIZE]);
+    return Stream.release();
+}
+
+static uLong ZCALLBACK ReadStream(voidpf Opaque, voidpf StreamPointer, void *Buffer, uLong Size)
+{
+    ZipStream *Stream = reinterpret_cast<ZipStream *>(StreamPointer);
+    // Anything waiting to be written has to be in the file before it can be read back.
+    if (Stream->Writing) { FlushStream(Stream); }
+
+    unsigned char *Destination = reinterpret_cast<unsigned char *>(Buffer);
+    uLong TotalRead            = 0;
+    while (TotalRead < Size)
+    {
+        uLong Remaining = Size - TotalRead;
+        if (Stream->Position >= Stream->BufferOffset && Stream->Position < Stream->BufferOffset + Stream->BufferSize)
+        {
+            size_t BufferPosition = Stream->Position - Stream->BufferOffset;
+            size_t CopySize       = std::min<size_t>(Remaining, Stream->BufferSize - BufferPosition);
+            std::memcpy(&Destination[TotalRead], &Stream->Buffer[BufferPosition], CopySize);
+            Stream->Position += CopySize;
+            TotalRead += CopySize;
+            continue;
+        }
+
+        // Reads as large as the buffer skip it. Anything smaller refills it from where minizip is.
+        Stream->File.seek(Stream->Position, fslib::Stream::BEGINNING);
+        if (Remaining >= ZIP_BUFFER_SIZE)
+        {
+            ssize_t BytesRead = Stream->File.read(&Destination[TotalRead], Remaining);
+            if (BytesRead <= 0) { break; }
+            Stream->Position += BytesRead;
+            TotalRead += BytesRead;
+            continue;
+        }
+
+        ssize_t BytesRead    = Stream->File.read(Stream->Buffer.get(), ZIP_BUFFER_SIZE);
+        Stream->BufferOffset = Stream->Position;
+        Stream->BufferSize   = BytesRead > 0 ? BytesRead : 0;
+        if (BytesRead <= 0) { break; }
+    }
+    return TotalRead;
+}
+
+static uLong ZCALLBACK WriteStream(voidpf Opaque, voidpf StreamPointer, const void *Buffer, uLong Size)
+{
+    ZipStream *Stream = reinterpret_cast<ZipStream *>(StreamPointer);
+
+    // Writes land in the buffer as long as they start inside or right after what's in it and fit. That covers minizip
+    // appending and going back to fill in a header it wrote a moment ago.
+    bool FitsBuffer = Stream->Writing && Stream->Position >= Stream->BufferOffset &&
+                      Stream->Position <= Stream->BufferOffset + Stream->BufferSize &&
+                      Stream->Position + Size <= Stream->BufferOffset + ZIP_BUFFER_SIZE;
+    if (!FitsBuffer)
+    {
+        FlushStream(Stream);
+
+        // Anything too large for the buffer goes straight to the file.
+        if (Size >= ZIP_BUFFER_SIZE)
+        {
+            Stream->File.seek(Stream->Position, fslib::Stream::BEGINNING);
+            ssize_t BytesWritten = Stream->File.write(Buffer, Size);
+            if (BytesWritten != static_cast<ssize_t>(Size))
+            {
+                logger::log("Error writing ZIP: %s", fslib::error::get_string());
+                Stream->Error = true;
+                return 0;
+            }
+            Stream->Position += Size;
+            return Size;
+        }
+
+        Stream->BufferOffset = Stream->Position;
+        Stream->Writing      = true;
+    }
+
+    size_t BufferPosition = Stream->Position - Stream->BufferOffset;
+    std::memcpy(&Stream->Buffer[BufferPosition], Buffer, Size);
+    Stream->BufferSize = std::max<size_t>(Stream->BufferSize, BufferPosition + Size);
+    Stream->Position += Size;
+    return Size;
+}
+
+static ZPOS64_T ZCALLBACK TellStream(voidpf Opaque, voidpf StreamPointer)
+{
+    return reinterpret_cast<ZipStream *>(StreamPointer)->Position;
+}
+
+static long ZCALLBACK SeekStream(voidpf Opaque, voidpf StreamPointer, ZPOS64_T Offset, int Origin)
+{
+    ZipStream *Stream = reinterpret_cast<ZipStream *>(StreamPointer);
+    switch (Origin)
+    {
+        case ZLIB_FILEFUNC_SEEK_SET:
+        {
+            Stream->Position = Offset;
+        }
+        break;
+
+        case ZLIB_FILEFUNC_SEEK_CUR:
+        {
+            Stream->Position += Offset;
+        }
+        break;
+
+        case ZLIB_FILEFUNC_SEEK_END:
+        {
+            // The end isn't known until the buffer is in the file.
+            FlushStream(Stream);
+            Stream->Position = Stream->File.get_size() + Offset;
+        }
+        break;
+
+        default:
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int ZCALLBACK CloseStream(voidpf Opaque, voidpf StreamPointer)
+{
+    std::unique_ptr<ZipStream> Stream(reinterpret_cast<ZipStream *>(StreamPointer));
+    FlushStream(Stream.get());
+    Stream->File.close();
+    return Stream->Error ? -1 : 0;
+}
+
+static int ZCALLBACK TestStreamError(voidpf Opaque, voidpf StreamPointer)
+{
+    return reinterpret_cast<ZipStream *>(StreamPointer)->Error ? 1 : 0;
+}
+
+// Functions minizip is given to get to the archive.
+static zlib_filefunc64_def s_ZipFunctions = {.zopen64_file = OpenStream,
+                                             .zread_file   = ReadStream,
+                                             .zwrite_file  = WriteStream,
+                                             .ztell64_file = TellStream,
+                                             .zseek64_file = SeekStream,
+                                             .zclose_file  = CloseStream,
+                                             .zerror_file  = TestStreamError,
+                                             .opaque       = nullptr};
+
+zipFile FS::OpenZipForWriting(const fslib::Path &ZipPath)
+{
+    return zipOpen2_64(&ZipPath, APPEND_STATUS_CREATE, nullptr, &s_ZipFunctions);
+}
+
+unzFile FS::OpenZipForReading(const fslib::Path &ZipPath) { return unzOpen2_64(&ZipPath, &s_ZipFunctions); }
@@ -0,0 +1,654 @@
+#include "FS/ZstdArchive.hpp"
+
+#include "FS/DirectoryWalker.hpp"
+#include "FS/Hash.hpp"
+#include "FS/IO.hpp"
+#include "StringUtil.hpp"
+#include "Strings.hpp"
+#include "logging/logger.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace
+{
+    // Largest a frame can get compressed. Every ring buffer is this size so a whole frame always fits in one.
+    constexpr size_t FRAME_BOUND = ZSTD_COMPRESSBOUND(FS::ZstdArchive::FRAME_SIZE);
+    // Number of buffers the read jobs can get ahead.
+    constexpr size_t ARCHIVE_BUFFER_COUNT = 4;
+
+    // JKSM
+    constexpr uint32_t ARCHIVE_MAGIC = 0x4D534B4A;
+    // Current revision of the format.
+    constexpr uint8_t ARCHIVE_REVISION = 0x01;
+
+    // Header at the beginning of archives. The frames follow it.
+    typedef struct
+    {
+            uint32_t Magic;
+            uint8_t Revision;
+            uint32_t FrameSize;
+    } __attribute__((packed)) ArchiveHeader;
+
+    // The index is EntryCount of these, each followed by PathLength UTF-16 characters, and then FrameCount frame entries.
+    typedef struct
+    {
+            uint8_t IsDirectory;
+            uint64_t Offset;
+            uint64_t Size;
+            uint64_t Hash;
+            uint16_t PathLength;
+    } __attribute__((packed)) ArchiveEntry;
+
+    typedef struct
+    {
+            uint64_t Offset;
+            uint32_t CompressedSize;
+            uint32_t Size;
+    } __attribute__((packed)) ArchiveFrame;
+
+    // Footer at the very end of archives. An archive that was cut off doesn't have one.
+    typedef struct
+    {
+            uint64_t IndexOffset;
+            uint64_t IndexHash;
+            uint32_t EntryCount;
+            uint32_t FrameCount;
+            uint32_t Magic;
+    } __attribute__((packed)) ArchiveFooter;
+
+    // Where a restore is in the entries. Current is the file being written, nullptr between files.
+    typedef struct
+    {
+            const std::vector<FS::ZstdArchive::IndexEntry> *Entries;
+            size_t NextEntry;
+            const fslib::Path *Destination;
+            FS::Transaction *Transaction;
+            const FS::ZstdArchive::IndexEntry *Current;
+            fslib::File File;
+            uint64_t Written;
+            FS::Hash64 Hash;
+            // Set if any file didn't match its hash or a directory couldn't be created.
+            bool Failed;
+    } RestoreState;
+} // namespace
+
+// Appends Size bytes of Data to Buffer.
+static inline void AppendBytes(std::vector<unsigned char> &Buffer, const void *Data, size_t Size)
+{
+    const unsigned char *Bytes = static_cast<const unsigned char *>(Data);
+    Buffer.insert(Buffer.end(), Bytes, Bytes + Size);
+}
+
+// Reads and checks the index at the end of ArchiveFile. Entries have to cover the stream in order and frames have to cover
+// the archive in order, so nothing the restore trusts can point outside of either.
+static bool LoadIndex(fslib::File &ArchiveFile,
+                      std::vector<FS::ZstdArchive::IndexEntry> &EntriesOut,
+                      std::vector<FS::ZstdArchive::FrameEntry> &FramesOut)
+{
+    if (!ArchiveFile.is_open())
+    {
+        logger::log("Error opening backup archive: %s", fslib::error::get_string());
+        return false;
+    }
+
+    ArchiveHeader Header;
+    ArchiveFooter Footer;
+    uint64_t ArchiveSize = static_cast<uint64_t>(ArchiveFile.get_size());
+    if (ArchiveSize < sizeof(ArchiveHeader) + sizeof(ArchiveFooter))
+    {
+        logger::log("Backup archive is too small to be one.");
+        return false;
+    }
+
+    ArchiveFile.seek(ArchiveSize - sizeof(ArchiveFooter), fslib::Stream::BEGINNING);
+    bool FooterRead = ArchiveFile.read(&Footer, sizeof(ArchiveFooter)) == sizeof(ArchiveFooter);
+    ArchiveFile.seek(0, fslib::Stream::BEGINNING);
+    if (!FooterRead || ArchiveFile.read(&Header, sizeof(ArchiveHeader)) != sizeof(ArchiveHeader))
+    {
+        logger::log("Error reading backup archive: %s", fslib::error::get_string());
+        return false;
+    }
+
+    uint64_t IndexEnd = ArchiveSize - sizeof(ArchiveFooter);
+    if (Header.Magic != ARCHIVE_MAGIC || Header.Revision != ARCHIVE_REVISION ||
+        Header.FrameSize != FS::ZstdArchive::FRAME_SIZE || Footer.Magic != ARCHIVE_MAGIC ||
+        Footer.IndexOffset < sizeof(ArchiveHeader) || Footer.IndexOffset > IndexEnd)
+    {
+        logger::log("Backup archive is invalid, incomplete or from an unsupported version.");
+        return false;
+    }
+
+    // Read the whole index and parse it from memory.
+    size_t IndexSize = static_cast<size_t>(IndexEnd - Footer.IndexOffset);
+    std::unique_ptr<unsigned char[]> Data(new unsigned char[IndexSize]);
+    ArchiveFile.seek(Footer.IndexOffset, fslib::Stream::BEGINNING);
+    if (ArchiveFile.read(Data.get(), IndexSize) != static_cast<ssize_t>(IndexSize))
+    {
+        logger::log("Error reading backup archive index: %s", fslib::error::get_string());
+        return false;
+    }
+    if (FS::Hash64::Get(Data.get(), IndexSize) != Footer.IndexHash)
+    {
+        logger::log("Backup archive index is damaged.");
+        return false;
+    }
+
+    size_t Offset         = 0;
+    uint64_t StreamOffset = 0;
+    EntriesOut.clear();
+    EntriesOut.reserve(Footer.EntryCount);
+    for (uint32_t i = 0; i < Footer.EntryCount; i++)
+    {
+        ArchiveEntry Entry;
+        if (Offset + sizeof(ArchiveEntry) > IndexSize) { return false; }
+        std::memcpy(&Entry, &Data[Offset], sizeof(ArchiveEntry));
+        Offset += sizeof(ArchiveEntry);
+
+        size_t PathBytes = Entry.PathLength * sizeof(char16_t);
+        if (Offset + PathBytes > IndexSize || (!Entry.IsDirectory && Entry.Offset != StreamOffset))
+        {
+            logger::log("Backup archive index is invalid.");
+            return false;
+        }
+
+        FS::ZstdArchive::IndexEntry NewEntry = {.IsDirectory = Entry.IsDirectory != 0,
+                                                .Offset      = Entry.Offset,
+                                                .Size        = Entry.IsDirectory ? 0 : Entry.Size,
+                                                .Hash        = Entry.Hash,
+                                                .Path        = std::u16string(Entry.PathLength, u'\0')};
+        std::memcpy(NewEntry.Path.data(), &Data[Offset], PathBytes);
+        Offset += PathBytes;
+        StreamOffset += NewEntry.Size;
+
+        EntriesOut.push_back(std::move(NewEntry));
+    }
+
+    uint64_t FrameOffset = sizeof(ArchiveHeader);
+    uint64_t StreamSize  = 0;
+    if (Offset + static_cast<uint64_t>(Footer.FrameCount) * sizeof(ArchiveFrame) != IndexSize)
+    {
+        logger::log("Backup archive index is invalid.");
+        return false;
+    }
+    FramesOut.resize(Footer.FrameCount);
+    for (uint32_t i = 0; i < Footer.FrameCount; i++)
+    {
+        ArchiveFrame Frame;
+        std::memcpy(&Frame, &Data[Offset], sizeof(ArchiveFrame));
+        Offset += sizeof(ArchiveFrame);
+
+        if (Frame.Offset != FrameOffset || Frame.CompressedSize > FRAME_BOUND || Frame.Size > FS::ZstdArchive::FRAME_SIZE ||
+            Frame.Offset + Frame.CompressedSize > Footer.IndexOffset)
+        {
+            logger::log("Backup archive index is invalid.");
+            return false;
+        }
+        FramesOut[i] = {.Offset = Frame.Offset, .CompressedSize = Frame.CompressedSize, .Size = Frame.Size};
+        FrameOffset += Frame.CompressedSize;
+        StreamSize += Frame.Size;
+    }
+
+    if (StreamSize != StreamOffset)
+    {
+        logger::log("Backup archive index is invalid.");
+        return false;
+    }
+    return true;
+}
+
+// This is the pool job that reads Frames into Ring. Every buffer is one whole frame.
+static void ReadFramesToRing(fslib::File &ArchiveFile,
+                             const std::vector<FS::ZstdArchive::FrameEntry> &Frames,
+                             FS::BufferRing &Ring)
+{
+    for (const FS::ZstdArchive::FrameEntry &Frame : Frames)
+    {
+        FS::BufferRing::Buffer *FrameBuffer = Ring.AcquireEmpty();
+        if (!FrameBuffer) { break; }
+
+        ArchiveFile.seek(Frame.Offset, fslib::Stream::BEGINNING);
+        if (ArchiveFile.read(FrameBuffer->Data.get(), Frame.CompressedSize) != static_cast<ssize_t>(Frame.CompressedSize))
+        {
+            logger::log("Error reading backup archive: %s", fslib::error::get_string());
+            Ring.Release(FrameBuffer);
+            break;
+        }
+
+        FrameBuffer->Size = Frame.CompressedSize;
+        Ring.PushFull(FrameBuffer);
+    }
+    Ring.Close();
+}
+
+// Closes the file being restored and checks it against its hash.
+static void FinishFile(RestoreState &State)
+{
+    State.File.close();
+    if (State.Transaction) { State.Transaction->FileWritten(State.Written); }
+
+    if (State.Hash.Finish() != State.Current->Hash)
+    {
+        char UTF8Buffer[0x301] = {0};
+        StringUtil::ToUTF8(State.Current->Path.c_str(), UTF8Buffer, 0x301);
+        logger::log("Verification failed for %s. It doesn't match the hash in the archive.", UTF8Buffer);
+        State.Failed = true;
+    }
+    State.Current = nullptr;
+}
+
+// Moves on to the next entry. Directories are created on the spot. Files are opened and become Current.
+static bool OpenNextEntry(System::ProgressTask *Task, RestoreState &State)
+{
+    const FS::ZstdArchive::IndexEntry &Entry = (*State.Entries)[State.NextEntry++];
+    fslib::Path FullDestination              = *State.Destination / Entry.Path;
+    if (Entry.IsDirectory)
+    {
+        if (!fslib::directory_exists(FullDestination) && !fslib::create_directory(FullDestination))
+        {
+            logger::log("Error creating destination directory: %s", fslib::error::get_string());
+            State.Failed = true;
+        }
+        return true;
+    }
+
+    State.File.open(FullDestination, FS_OPEN_CREATE | FS_OPEN_WRITE, Entry.Size);
+    if (!State.File.is_open())
+    {
+        logger::log("Error opening destination file: %s", fslib::error::get_string());
+        return false;
+    }
+
+    if (Task)
+    {
+        Task->SetStatus(Strings::GetStringByName(Strings::Names::CopyingFile, 0), FullDestination.full_path());
+        Task->Reset(static_cast<double>(Entry.Size));
+    }
+
+    State.Current = &Entry;
+    State.Written = 0;
+    State.Hash    = FS::Hash64();
+    return true;
+}
+
+// Writes Size bytes of the stream to the entries it belongs to. Passing nothing finishes whatever's left once the stream
+// has ended, which is only directories and empty files.
+static bool WriteToEntries(System::ProgressTask *Task, RestoreState &State, const unsigned char *Data, size_t Size)
+{
+    size_t Used = 0;
+    while (true)
+    {
+        if (State.Current && State.Written == State.Current->Size) { FinishFile(State); }
+        if (!State.Current)
+        {
+            if (State.NextEntry == State.Entries->size()) { break; }
+            if (!OpenNextEntry(Task, State)) { return false; }
+            continue;
+        }
+        if (Used == Size) { break; }
+
+        size_t WriteSize = static_cast<size_t>(std::min<uint64_t>(Size - Used, State.Current->Size - State.Written));
+        if (State.File.write(&Data[Used], WriteSize) != static_cast<ssize_t>(WriteSize))
+        {
+            logger::log("Error writing to file: %s", fslib::error::get_string());
+            State.File.close();
+            return false;
+        }
+        State.Hash.Update(&Data[Used], WriteSize);
+        State.Written += WriteSize;
+        Used += WriteSize;
+        if (Task) { Task->SetCurrent(static_cast<double>(State.Written)); }
+    }
+    return Used == Size;
+}
+
+FS::ZstdArchive::ZstdArchive(size_t WorkerCount)
+    : m_WorkerCount(std::max<size_t>(WorkerCount, 1))
+    , m_Ring(ARCHIVE_BUFFER_COUNT, FRAME_BOUND)
+{
+}
+
+FS::ZstdArchive::~ZstdArchive()
+{
+    // Nothing can still be compressing once the workers are joined.
+    m_Workers.reset();
+    for (std::unique_ptr<FrameSlot> &CurrentSlot : m_Slots) { ZSTD_freeCCtx(CurrentSlot->Context); }
+}
+
+bool FS::ZstdArchive::Backup(System::ProgressTask *Task, const fslib::Path &Source, const fslib::Path &ArchivePath)
+{
+    if (!ZstdArchive::Prepare()) { return false; }
+
+    ArchiveHeader Header = {.Magic = ARCHIVE_MAGIC, .Revision = ARCHIVE_REVISION, .FrameSize = FRAME_SIZE};
+    m_Archive.open(ArchivePath, FS_OPEN_CREATE | FS_OPEN_WRITE);
+    if (!m_Archive.is_open() || m_Archive.write(&Header, sizeof(ArchiveHeader)) != sizeof(ArchiveHeader))
+    {
+        logger::log("Error creating backup archive: %s", fslib::error::get_string());
+        m_Archive.close();
+        return false;
+    }
+    m_ArchiveOffset = sizeof(ArchiveHeader);
+    m_Frames.clear();
+    m_Failed = false;
+
+    std::vector<IndexEntry> Entries;
+    uint64_t StreamSize = 0;
+    ZstdArchive::BackupDirectory(Task, Source, Entries, StreamSize);
+
+    // The last frame is usually short.
+    if (m_Slots[m_Filling]->InputSize > 0) { ZstdArchive::SubmitFrame(); }
+    while (m_Pending > 0) { ZstdArchive::WriteOldestFrame(); }
+    if (m_Failed)
+    {
+        m_Archive.close();
+        return false;
+    }
+
+    // The index and footer are built in memory so they're a single write.
+    std::vector<unsigned char> Buffer;
+    for (const IndexEntry &CurrentEntry : Entries)
+    {
+        ArchiveEntry OutEntry = {.IsDirectory = CurrentEntry.IsDirectory,
+                                 .Offset      = CurrentEntry.Offset,
+                                 .Size        = CurrentEntry.Size,
+                                 .Hash        = CurrentEntry.Hash,
+                                 .PathLength  = static_cast<uint16_t>(CurrentEntry.Path.length())};
+        AppendBytes(Buffer, &OutEntry, sizeof(ArchiveEntry));
+        AppendBytes(Buffer, CurrentEntry.Path.data(), CurrentEntry.Path.length() * sizeof(char16_t));
+    }
+    for (const FrameEntry &CurrentFrame : m_Frames)
+    {
+        ArchiveFrame OutFrame = {.Offset         = CurrentFrame.Offset,
+                                 .CompressedSize = CurrentFrame.CompressedSize,
+                                 .Size           = CurrentFrame.Size};
+        AppendBytes(Buffer, &OutFrame, sizeof(ArchiveFrame));
+    }
+
+    ArchiveFooter Footer = {.IndexOffset = m_ArchiveOffset,
+                            .IndexHash   = FS::Hash64::Get(Buffer.data(), Buffer.size()),
+                            .EntryCount  = static_cast<uint32_t>(Entries.size()),
+                            .FrameCount  = static_cast<uint32_t>(m_Frames.size()),
+                            .Magic       = ARCHIVE_MAGIC};
+    AppendBytes(Buffer, &Footer, sizeof(ArchiveFooter));
+
+    bool Written = m_Archive.write(Buffer.data(), Buffer.size()) == static_cast<ssize_t>(Buffer.size());
+    if (!Written) { logger::log("Error writing backup archive index: %s", fslib::error::get_string()); }
+    m_Archive.close();
+
+    logger::log("Backup archive: %zu entries in %zu frame(s), %llu bytes compressed to %llu.",
+                Entries.size(),
+                m_Frames.size(),
+                StreamSize,
+                m_ArchiveOffset + Buffer.size());
+    return Written;
+}
+
+bool FS::ZstdArchive::ReadIndex(const fslib::Path &ArchivePath,
+                                std::vector<IndexEntry> &EntriesOut,
+                                std::vector<FrameEntry> &FramesOut)
+{
+    fslib::File ArchiveFile(ArchivePath, FS_OPEN_READ);
+    return LoadIndex(ArchiveFile, EntriesOut, FramesOut);
+}
+
+bool FS::ZstdArchive::Restore(System::ProgressTask *Task,
+                              const fslib::Path &ArchivePath,
+                              const fslib::Path &Destination,
+                              FS::Transaction *Transaction)
+{
+    fslib::File ArchiveFile(ArchivePath, FS_OPEN_READ);
+    std::vector<IndexEntry> Entries;
+    std::vector<FrameEntry> Frames;
+    if (!LoadIndex(ArchiveFile, Entries, Frames)) { return false; }
+
+    // The index already has every file's size, so the whole restore's total is free.
+    if (Task)
+    {
+        uint64_t TotalSize = 0;
+        for (const IndexEntry &CurrentEntry : Entries) { TotalSize += CurrentEntry.Size; }
+        Task->SetOperationTotal(static_cast<double>(TotalSize));
+    }
+
+    ZSTD_DCtx *Context = ZSTD_createDCtx();
+    if (!Context)
+    {
+        logger::log("Error creating zstd decompression context.");
+        return false;
+    }
+    std::unique_ptr<unsigned char[]> Output(new unsigned char[FRAME_SIZE]);
+
+    RestoreState State = {.Entries     = &Entries,
+                          .NextEntry   = 0,
+                          .Destination = &Destination,
+                          .Transaction = Transaction,
+                          .Current     = nullptr,
+                          .File        = {},
+                          .Written     = 0,
+                          .Hash        = {},
+                          .Failed      = false};
+
+    // Frames are read ahead on the I/O pool while the one before is decompressed and written.
+    m_Ring.Reset();
+    System::GetIOPool().Submit([this, &ArchiveFile, &Frames]() { ReadFramesToRing(ArchiveFile, Frames, m_Ring); });
+
+    bool Success      = true;
+    size_t FrameIndex = 0;
+    for (FS::BufferRing::Buffer *FrameBuffer = m_Ring.AcquireFull(); FrameBuffer; FrameBuffer = m_Ring.AcquireFull())
+    {
+        size_t OutputSize =
+            ZSTD_decompressDCtx(Context, Output.get(), FRAME_SIZE, FrameBuffer->Data.get(), FrameBuffer->Size);
+        m_Ring.Release(FrameBuffer);
+        if (ZSTD_isError(OutputSize) || OutputSize != Frames[FrameIndex++].Size)
+        {
+            logger::log("Error decompressing backup archive frame %zu.", FrameIndex - 1);
+            Success = false;
+        }
+        else { Success = WriteToEntries(Task, State, Output.get(), OutputSize); }
+
+        if (!Success)
+        {
+            m_Ring.Cancel();
+            break;
+        }
+    }
+    m_Ring.WaitForClose();
+    ZSTD_freeDCtx(Context);
+
+    // Anything after the last byte of the stream is directories and empty files.
+    if (Success && FrameIndex != Frames.size()) { Success = false; }
+    if (Success) { Success = WriteToEntries(Task, State, nullptr, 0) && !State.Current; }
+    return Success && !State.Failed;
+}
+
+void FS::ZstdArchive::BackupDirectory(System::ProgressTask *Task,
+                                      const fslib::Path &Source,
+                                      std::vector<IndexEntry> &EntriesOut,
+                                      uint64_t &StreamOffset)
+{
+    // The walker returns directories before what's in them, so entries end up parents first.
+    FS::DirectoryWalker Walker(Source);
+    while (Walker.Next() && !m_Failed)
+    {
+        // Same as regular copies.
+        const fslib::DirectoryEntry &Entry = Walker.GetEntry();
+        if (std::char_traits<char16_t>::compare(u"._secure_value", Entry.get_filename(), 14) == 0) { continue; }
+
+        IndexEntry NewEntry = {.IsDirectory = Entry.is_directory(),
+                               .Offset      = StreamOffset,
+                               .Size        = 0,
+                               .Hash        = 0,
+                               .Path        = std::u16string(Walker.GetRelativePath())};
+
+        if (NewEntry.IsDirectory) { EntriesOut.push_back(std::move(NewEntry)); }
+        else if (ZstdArchive::BackupFile(Task, Walker.GetPath(), NewEntry))
+        {
+            StreamOffset += NewEntry.Size;
+            EntriesOut.push_back(std::move(NewEntry));
+        }
+    }
+}
+
+bool FS::ZstdArchive::BackupFile(System::ProgressTask *Task, const fslib::Path &Source, IndexEntry &EntryOut)
+{
+    // A file left out would just be missing when the archive is restored, so this fails the whole archive too.
+    fslib::File SourceFile(Source, FS_OPEN_READ);
+    if (!SourceFile.is_open())
+    {
+        logger::log("Error opening source file: %s", fslib::error::get_string());
+        m_Failed = true;
+        return false;
+    }
+    EntryOut.Size = SourceFile.get_size();
+
+    if (Task)
+    {
+        Task->SetStatus(Strings::GetStringByName(Strings::Names::CopyingFile, 0), Source.full_path());
+        Task->Reset(static_cast<double>(EntryOut.Size));
+    }
+
+    FS::StartReadJob(SourceFile, m_Ring);
+
+    FS::Hash64 FileHash;
+    uint64_t BytesAdded = 0;
+    for (FS::BufferRing::Buffer *ReadBuffer = m_Ring.AcquireFull(); ReadBuffer; ReadBuffer = m_Ring.AcquireFull())
+    {
+        FileHash.Update(ReadBuffer->Data.get(), ReadBuffer->Size);
+        ZstdArchive::AddToStream(ReadBuffer->Data.get(), ReadBuffer->Size);
+        BytesAdded += ReadBuffer->Size;
+        m_Ring.Release(ReadBuffer);
+        if (m_Failed)
+        {
+            m_Ring.Cancel();
+            break;
+        }
+
+        if (Task) { Task->SetCurrent(static_cast<double>(BytesAdded)); }
+    }
+    m_Ring.WaitForClose();
+
+    // What was added is already in the stream, so the index can't be made to match it anymore.
+    if (BytesAdded != EntryOut.Size)
+    {
+        char UTF8Buffer[0x301] = {0};
+        StringUtil::ToUTF8(Source.full_path(), UTF8Buffer, 0x301);
+        logger::log("Error archiving %s: %llu of %llu bytes read.", UTF8Buffer, BytesAdded, EntryOut.Size);
+        m_Failed = true;
+    }
+    EntryOut.Hash = FileHash.Finish();
+    return !m_Failed;
+}
+
+void FS::ZstdArchive::AddToStream(const unsigned char *Data, size_t Size)
+{
+    while (Size > 0)
+    {
+        FrameSlot &Filling = *m_Slots[m_Filling];
+        size_t CopySize    = std::min(Size, FRAME_SIZE - Filling.InputSize);
+        std::memcpy(&Filling.Input[Filling.InputSize], Data, CopySize);
+        Filling.InputSize += CopySize;
+        Data += CopySize;
+        Size -= CopySize;
+
+        if (Filling.InputSize == FRAME_SIZE) { ZstdArchive::SubmitFrame(); }
+    }
+}
+
+void FS::ZstdArchive::SubmitFrame()
+{
+    FrameSlot *Submitted = m_Slots[m_Filling].get();
+    {
+        std::scoped_lock<std::mutex> SlotLock(m_SlotLock);
+        Submitted->Done   = false;
+        Submitted->Failed = false;
+    }
+    m_Workers->Submit([this, Submitted]() { ZstdArchive::CompressFrame(Submitted); });
+    ++m_Pending;
+
+    // The next slot can only be filled once its frame has been written.
+    m_Filling = (m_Filling + 1) % m_Slots.size();
+    if (m_Pending == m_Slots.size()) { ZstdArchive::WriteOldestFrame(); }
+    m_Slots[m_Filling]->InputSize = 0;
+}
+
+void FS::ZstdArchive::WriteOldestFrame()
+{
+    FrameSlot &Oldest = *m_Slots[m_Oldest];
+    {
+        std::unique_lock<std::mutex> SlotLock(m_SlotLock);
+        m_SlotDone.wait(SlotLock, [&Oldest]() { return Oldest.Done; });
+    }
+
+    if (Oldest.Failed) { m_Failed = true; }
+    else if (!m_Failed &&
+             m_Archive.write(Oldest.Output.get(), Oldest.OutputSize) != static_cast<ssize_t>(Oldest.OutputSize))
+    {
+        logger::log("Error writing backup archive: %s", fslib::error::get_string());
+        m_Failed = true;
+    }
+
+    if (!m_Failed)
+    {
+        m_Frames.push_back({.Offset         = m_ArchiveOffset,
+                            .CompressedSize = static_cast<uint32_t>(Oldest.OutputSize),
+                            .Size           = static_cast<uint32_t>(Oldest.InputSize)});
+        m_ArchiveOffset += Oldest.OutputSize;
+    }
+    m_Oldest = (m_Oldest + 1) % m_Slots.size();
+    --m_Pending;
+}
+
+void FS::ZstdArchive::CompressFrame(FrameSlot *Target)
+{
+    // Parameters stick to the context, so every frame gets the level and checksum set in Prepare.
+    size_t Result =
+        ZSTD_compress2(Target->Context, Target->Output.get(), FRAME_BOUND, Target->Input.get(), Target->InputSize);
+    bool Compressed = !ZSTD_isError(Result);
+    if (!Compressed) { logger::log("Error compressing backup archive frame: %s", ZSTD_getErrorName(Result)); }
+
+    {
+        std::scoped_lock<std::mutex> SlotLock(m_SlotLock);
+        Target->OutputSize = Compressed ? Result : 0;
+        Target->Done       = true;
+        Target->Failed     = !Compressed;
+    }
+    m_SlotDone.notify_all();
+}
+
+bool FS::ZstdArchive::Prepare()
+{
+    m_Filling = 0;
+    m_Oldest  = 0;
+    m_Pending = 0;
+    if (m_Workers)
+    {
+        m_Slots[m_Filling]->InputSize = 0;
+        return true;
+    }
+
+    // One more slot than there are workers so the next frame can be filled while they're all busy.
+    for (size_t i = 0; i < m_WorkerCount + 1; i++)
+    {
+        // Everything else starts zeroed. Slots are done until they're submitted.
+        std::unique_ptr<FrameSlot> NewSlot(new FrameSlot());
+        NewSlot->Input   = std::unique_ptr<unsigned char[]>(new unsigned char[FRAME_SIZE]);
+        NewSlot->Output  = std::unique_ptr<unsigned char[]>(new unsigned char[FRAME_BOUND]);
+        NewSlot->Context = ZSTD_createCCtx();
+        NewSlot->Done    = true;
+
+        // Every frame carries its own checksum so a damaged one is caught when it's decompressed.
+        bool Ready = NewSlot->Context &&
+                     !ZSTD_isError(ZSTD_CCtx_setParameter(NewSlot->Context, ZSTD_c_compressionLevel, COMPRESSION_LEVEL)) &&
+                     !ZSTD_isError(ZSTD_CCtx_setParameter(NewSlot->Context, ZSTD_c_checksumFlag, 1));
+        m_Slots.push_back(std::move(NewSlot));
+        if (!Ready)
+        {
+            logger::log("Error creating zstd compression context.");
+            for (std::unique_ptr<FrameSlot> &CurrentSlot : m_Slots) { ZSTD_freeCCtx(CurrentSlot->Context); }
+            m_Slots.clear();
+            return false;
+        }
+    }
+    m_Workers = std::make_unique<System::ThreadPool>(m_WorkerCount);
+    return true;
+}
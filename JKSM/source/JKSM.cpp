@@ -4,6 +4,7 @@
 #include "Config.hpp"
 #include "Data/Data.hpp"
 #include "FS/FS.hpp"
+#include "FS/IO.hpp"
 #include "Keyboard.hpp"
 #include "SDL/SDL.hpp"
 #include "StringUtil.hpp"
@@ -80,6 +81,10 @@ JKSM::JKSM()
     // Config
     Config::Initialize();
 
+    // Large files are copied in parallel on New 3DS unless the config says otherwise.
+    int8_t ParallelCopies = Config::GetByKey(Config::Keys::ParallelCopies);
+    FS::SetCopyWorkerCount(ParallelCopies > 0 ? ParallelCopies : (New3DS ? 4 : 1));
+
     // Loads UI strings from json in RomFs.
     Strings::Intialize();
 
@@ -0,0 +1,119 @@
+#include "System/ThreadPool.hpp"
+#include "logging/logger.hpp"
+
+namespace
+{
+    // Number of workers in the I/O pool. Jobs on it mostly sit waiting on the card or archive, so this doesn't need to match
+    // the core count. There's one for each of the four large files a parallel copy can have going plus one for the task's own
+    // reads so none of them wait on each other.
+    constexpr size_t IO_POOL_WORKER_COUNT = 5;
+    // Stack size of every worker.
+    constexpr size_t WORKER_STACK_SIZE = 0x10000;
+    // Core only the New 3DS has. Apps can use it without giving up any time on the system core.
+    constexpr int NEW_3DS_EXTRA_CORE = 2;
+    // Default core for the app's threads.
+    constexpr int DEFAULT_CORE = -2;
+} // namespace
+
+System::ThreadPool::ThreadPool(size_t WorkerCount, int CPUCore)
+{
+    // Workers run at the same priority as whatever is creating them so they're not starved by it or starving it.
+    s32 Priority = 0x30;
+    svcGetThreadPriority(&Priority, CUR_THREAD_HANDLE);
+
+    for (size_t i = 0; i < WorkerCount; i++)
+    {
+        Thread Worker = threadCreate(WorkerEntry, this, WORKER_STACK_SIZE, Priority, CPUCore, false);
+        // Fall back to the default core instead of having a pool without workers.
+        if (!Worker && CPUCore != DEFAULT_CORE)
+        {
+            logger::log("Error starting worker on core %i. Using the default core instead.", CPUCore);
+            Worker = threadCreate(WorkerEntry, this, WORKER_STACK_SIZE, Priority, DEFAULT_CORE, false);
+        }
+
+        if (!Worker)
+        {
+            logger::log("Error starting thread pool worker.");
+            continue;
+        }
+        m_Workers.push_back(Worker);
+    }
+}
+
+System::ThreadPool::~ThreadPool()
+{
+    {
+        std::scoped_lock<std::mutex> QueueLock(m_QueueLock);
+        m_Exiting = true;
+    }
+    m_QueueCondition.notify_all();
+
+    for (Thread Worker : m_Workers)
+    {
+        threadJoin(Worker, U64_MAX);
+        threadFree(Worker);
+    }
+}
+
+void System::ThreadPool::Submit(std::function<void()> Job)
+{
+    {
+        std::scoped_lock<std::mutex> QueueLock(m_QueueLock);
+        m_Queue.push_back({std::move(Job), std::chrono::steady_clock::now()});
+    }
+    m_QueueCondition.notify_one();
+}
+
+size_t System::ThreadPool::GetWorkerCount() const { return m_Workers.size(); }
+
+System::ThreadPool::Statistics System::ThreadPool::GetStatistics()
+{
+    std::scoped_lock<std::mutex> QueueLock(m_QueueLock);
+    return m_Statistics;
+}
+
+void System::ThreadPool::ResetStatistics()
+{
+    std::scoped_lock<std::mutex> QueueLock(m_QueueLock);
+    m_Statistics = {};
+}
+
+void System::ThreadPool::WorkerFunction()
+{
+    while (true)
+    {
+        std::function<void()> Job;
+        {
+            std::unique_lock<std::mutex> QueueLock(m_QueueLock);
+            m_QueueCondition.wait(QueueLock, [this]() { return m_Exiting || !m_Queue.empty(); });
+            if (m_Queue.empty()) { return; }
+
+            // Record how long this sat before being picked up.
+            uint64_t WaitTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                                      m_Queue.front().QueuedAt)
+                                    .count();
+            m_Statistics.JobCount++;
+            m_Statistics.TotalWaitTime += WaitTime;
+            if (WaitTime > m_Statistics.MaxWaitTime) { m_Statistics.MaxWaitTime = WaitTime; }
+
+            Job = std::move(m_Queue.front().Job);
+            m_Queue.pop_front();
+        }
+        Job();
+    }
+}
+
+void System::ThreadPool::WorkerEntry(void *Pool) { static_cast<ThreadPool *>(Pool)->WorkerFunction(); }
+
+System::ThreadPool &System::GetIOPool()
+{
+    static System::ThreadPool IOPool(IO_POOL_WORKER_COUNT);
+    return IOPool;
+}
+
+int System::GetWorkerCore()
+{
+    bool New3DS     = false;
+    Result AptError = APT_CheckNew3DS(&New3DS);
+    return R_SUCCEEDED(AptError) && New3DS ? NEW_3DS_EXTRA_CORE : DEFAULT_CORE;
+}
@@ -0,0 +1,96 @@
+#pragma once
+// Host stand-in for the small slice of libctru the core code uses. Only what is needed to build and run the non-UI core on
+// Linux is declared here. Services are stubbed to succeed with sane defaults.
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef s32 Result;
+typedef u32 Handle;
+
+#define U64_MAX UINT64_MAX
+
+#define R_SUCCEEDED(res) ((res) >= 0)
+#define R_FAILED(res)    ((res) < 0)
+
+// File open flags.
+#define FS_OPEN_READ   (1 << 0)
+#define FS_OPEN_WRITE  (1 << 1)
+#define FS_OPEN_CREATE (1 << 2)
+
+// Threads. Cores and priorities are accepted and ignored. Every thread is a host thread.
+#define CUR_THREAD_HANDLE 0xFFFF8000
+
+typedef struct Thread_tag *Thread;
+typedef void (*ThreadFunc)(void *);
+
+typedef enum
+{
+    MEDIATYPE_NAND      = 0,
+    MEDIATYPE_SD        = 1,
+    MEDIATYPE_GAME_CARD = 2,
+} FS_MediaType;
+
+typedef enum
+{
+    SECUREVALUE_SLOT_SD = 0x1000,
+} FS_SecureValueSlot;
+
+typedef enum
+{
+    SECURESAVE_ACTION_DELETE = 0,
+    SECURESAVE_ACTION_FORMAT = 1,
+} FS_SecureSaveAction;
+
+typedef enum
+{
+    CFG_LANGUAGE_JP = 0,
+    CFG_LANGUAGE_EN = 1,
+    CFG_LANGUAGE_FR = 2,
+    CFG_LANGUAGE_DE = 3,
+    CFG_LANGUAGE_IT = 4,
+    CFG_LANGUAGE_ES = 5,
+    CFG_LANGUAGE_ZH = 6,
+    CFG_LANGUAGE_KO = 7,
+    CFG_LANGUAGE_NL = 8,
+    CFG_LANGUAGE_PT = 9,
+    CFG_LANGUAGE_RU = 10,
+    CFG_LANGUAGE_TW = 11,
+} CFG_Language;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    ssize_t decode_utf8(uint32_t *out, const uint8_t *in);
+    ssize_t encode_utf8(uint8_t *out, uint32_t in);
+    ssize_t decode_utf16(uint32_t *out, const uint16_t *in);
+    ssize_t encode_utf16(uint16_t *out, uint32_t in);
+    ssize_t utf8_to_utf16(uint16_t *out, const uint8_t *in, size_t len);
+    ssize_t utf16_to_utf8(uint8_t *out, const uint16_t *in, size_t len);
+
+    // The stand-in has no titles installed and no secure values to control.
+    Result AM_GetTitleCount(FS_MediaType mediaType, u32 *count);
+    Result AM_GetTitleList(u32 *titlesRead, FS_MediaType mediaType, u32 titleCount, u64 *titleIds);
+    Result AM_GetTitleProductCode(FS_MediaType mediaType, u64 titleId, char *productCode);
+    Result FSUSER_ControlSecureSave(FS_SecureSaveAction action, void *input, u32 inputSize, void *output, u32 outputSize);
+
+    Thread threadCreate(ThreadFunc entrypoint, void *arg, size_t stack_size, int prio, int core_id, bool detached);
+    Result threadJoin(Thread thread, u64 timeout_ns);
+    void threadFree(Thread thread);
+    Result svcGetThreadPriority(s32 *out, Handle handle);
+
+    Result CFGU_GetSystemLanguage(u8 *language);
+    Result APT_CheckNew3DS(bool *out);
+    void osSetSpeedupEnable(bool enable);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,223 @@
+#pragma once
+// Host stand-in for FsLib. This mirrors the parts of the 3DS FsLib API JKSM's core uses, but every device is backed by a
+// plain POSIX directory on the host. Devices are mapped with fslib::host::map_device before use. sdmc is mapped to
+// $JKSM_HOST_SDMC (or ./sdmc) by fslib::initialize.
+#include <3ds.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// FsLib's own open flag. Writes always go to the end of the file.
+static constexpr uint32_t FS_OPEN_APPEND = 1 << 3;
+
+namespace fslib
+{
+    /// @brief Maximum path length FsLib allows.
+    static constexpr size_t MAX_PATH = 0x301;
+
+    /// @brief Single entry of a directory listing.
+    class DirectoryEntry
+    {
+        public:
+            DirectoryEntry(std::u16string_view filename, bool isDirectory, uint64_t size);
+
+            /// @brief Returns the file name of the entry.
+            const char16_t *get_filename() const;
+
+            /// @brief Returns whether or not the entry is a directory.
+            bool is_directory() const;
+
+            /// @brief Returns the size recorded in the directory metadata.
+            uint64_t get_size() const;
+
+        private:
+            std::u16string m_filename{};
+            bool m_isDirectory{};
+            uint64_t m_size{};
+    };
+
+    /// @brief UTF-16 path in the form of device:/path/to/thing.
+    class Path
+    {
+        public:
+            static constexpr size_t npos = static_cast<size_t>(-1);
+
+            Path() = default;
+            Path(const char16_t *path);
+            Path(std::u16string_view path);
+            Path(const std::u16string &path);
+
+            /// @brief Returns whether or not the path contains a device and a valid path.
+            bool is_valid() const;
+
+            /// @brief Returns a new path containing the first pathLength characters.
+            Path sub_path(size_t pathLength) const;
+
+            /// @brief Finds the first occurrence of character.
+            size_t find_first_of(char16_t character) const;
+
+            /// @brief Finds the first occurrence of character starting at begin.
+            size_t find_first_of(char16_t character, size_t begin) const;
+
+            /// @brief Finds the last occurrence of character.
+            size_t find_last_of(char16_t character) const;
+
+            /// @brief Finds the last occurrence of character before begin.
+            size_t find_last_of(char16_t character, size_t begin) const;
+
+            /// @brief Returns the full path.
+            const char16_t *full_path() const;
+
+            /// @brief Returns the device name.
+            std::u16string_view get_device_name() const;
+
+            /// @brief Returns the file name at the end of the path.
+            const char16_t *get_filename() const;
+
+            /// @brief Returns the extension of the path without the dot.
+            std::u16string_view get_extension() const;
+
+            /// @brief Returns the length of the path.
+            size_t get_length() const;
+
+            Path &operator=(const char16_t *path);
+            Path &operator=(std::u16string_view path);
+            Path &operator/=(const char16_t *path);
+            Path &operator/=(std::u16string_view path);
+            Path &operator/=(const DirectoryEntry &entry);
+            Path &operator+=(const char16_t *path);
+            Path &operator+=(std::u16string_view path);
+
+        private:
+            std::u16string m_path{};
+    };
+
+    Path operator/(const Path &pathA, const char16_t *pathB);
+    Path operator/(const Path &pathA, std::u16string_view pathB);
+    Path operator/(const Path &pathA, const DirectoryEntry &entry);
+    Path operator+(const Path &pathA, const char16_t *pathB);
+    Path operator+(const Path &pathA, std::u16string_view pathB);
+
+    /// @brief Base stream. Tracks offset and size.
+    class Stream
+    {
+        public:
+            static constexpr uint8_t BEGINNING = 0;
+            static constexpr uint8_t CURRENT   = 1;
+            static constexpr uint8_t END       = 2;
+
+            int64_t tell() const;
+            int64_t get_size() const;
+            bool end_of_file() const;
+            void seek(int64_t offset, uint8_t origin);
+
+        protected:
+            int64_t m_offset{};
+            int64_t m_streamSize{};
+            bool m_isOpen{};
+    };
+
+    /// @brief File backed by a host file.
+    class File : public Stream
+    {
+        public:
+            File() = default;
+            File(const Path &filePath, uint32_t openFlags, uint64_t fileSize = 0);
+            File(File &&file);
+            File &operator=(File &&file);
+            File(const File &)            = delete;
+            File &operator=(const File &) = delete;
+            ~File();
+
+            void open(const Path &filePath, uint32_t openFlags, uint64_t fileSize = 0);
+            void close();
+            bool is_open() const;
+            ssize_t read(void *buffer, size_t bufferSize);
+            ssize_t write(const void *buffer, size_t bufferSize);
+            bool flush();
+            File &operator<<(const char *string);
+            File &operator<<(const std::string &string);
+
+        private:
+            int m_descriptor = -1;
+            uint32_t m_openFlags{};
+    };
+
+    /// @brief Directory listing. Directories are listed before files and each group is sorted.
+    class Directory
+    {
+        public:
+            Directory() = default;
+            Directory(const Path &directoryPath, bool sortedListing = true);
+
+            void open(const Path &directoryPath, bool sortedListing = true);
+            void close();
+            bool is_open() const;
+            uint32_t get_count() const;
+            const DirectoryEntry &operator[](int index) const;
+
+        private:
+            std::vector<DirectoryEntry> m_list{};
+            bool m_wasOpened{};
+    };
+
+    bool initialize();
+    void exit();
+
+    bool directory_exists(const Path &directoryPath);
+    bool create_directory(const Path &directoryPath);
+    bool create_directory_recursively(const Path &directoryPath);
+    bool delete_directory(const Path &directoryPath);
+    bool delete_directory_recursively(const Path &directoryPath);
+    bool rename_directory(const Path &oldPath, const Path &newPath);
+
+    bool file_exists(const Path &filePath);
+    bool create_file(const Path &filePath, int64_t fileSize = 0);
+    bool delete_file(const Path &filePath);
+    bool rename_file(const Path &oldPath, const Path &newPath);
+    bool get_file_size(const Path &filePath, uint64_t &sizeOut);
+
+    /// @brief Commits data to the device. The stand-in counts these and fsyncs nothing.
+    bool control_device(std::u16string_view device);
+    bool close_device(std::u16string_view device);
+
+    bool open_user_save_data(std::u16string_view device, FS_MediaType mediaType, uint64_t titleID);
+    bool open_system_save_data(std::u16string_view device, uint32_t uniqueID);
+    bool open_extra_data(std::u16string_view device, uint32_t extDataID);
+    bool open_shared_extra_data(std::u16string_view device, uint32_t extDataID);
+    bool open_boss_extra_data(std::u16string_view device, uint32_t extDataID);
+
+    bool get_secure_value_for_title(uint32_t uniqueID, uint64_t &valueOut);
+    bool set_secure_value_for_title(uint32_t uniqueID, uint64_t value);
+
+    namespace dev
+    {
+        bool initialize_sdmc();
+    }
+
+    namespace error
+    {
+        const char *get_string();
+    }
+
+    namespace host
+    {
+        /// @brief Maps device to the host directory passed. Mapping a device again replaces the old mapping.
+        void map_device(std::u16string_view device, std::string_view hostPath);
+
+        /// @brief Returns the host path for the fslib::Path passed. Empty if the device isn't mapped.
+        std::string to_host_path(const Path &path);
+
+        /// @brief Returns the number of times control_device has been called since the last reset.
+        uint64_t get_commit_count();
+
+        /// @brief Resets the commit counter.
+        void reset_commit_count();
+
+        /// @brief Makes every read and write take latency microseconds plus the time the transfer would take at
+        /// megabytesPerSecond. The bandwidth is shared by every thread like a real card's. This is for measuring pipelining
+        /// against something closer to the 3DS's SD card. 0 for both turns it off.
+        void set_device_speed(uint32_t latency, uint32_t megabytesPerSecond);
+    }
+}
@@ -0,0 +1,674 @@
+#include "FS/ChunkStore.hpp"
+#include "FS/DirectoryWalker.hpp"
+#include "FS/Hash.hpp"
+#include "FS/IO.hpp"
+#include "FS/PathBuilder.hpp"
+#include "FS/ZipIO.hpp"
+#include "FS/ZstdArchive.hpp"
+#include "fslib.hpp"
+#include "logging/logger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace
+{
+    // Most workers the copy benchmark is run with.
+    constexpr size_t MAX_BENCHMARK_WORKERS = 4;
+    // Size of the buffer hashed by the hash benchmark and how many times it's hashed.
+    constexpr size_t HASH_BUFFER_SIZE = 0x1000000;
+    constexpr int HASH_PASSES         = 16;
+    // Chunk size the streaming hash is fed in. This matches the copy buffers.
+    constexpr size_t HASH_CHUNK_SIZE = 0x10000;
+    // Files the small file benchmark generates by default, how many go in each directory and the range of their sizes.
+    constexpr uint32_t SMALL_FILE_COUNT          = 5000;
+    constexpr uint32_t SMALL_FILES_PER_DIRECTORY = 100;
+    constexpr size_t SMALL_FILE_MIN_SIZE         = 0x40;
+    constexpr size_t SMALL_FILE_MAX_SIZE         = 0x1000;
+
+    // Devices the benchmarks map their directories to.
+    constexpr std::u16string_view SOURCE_DEVICE      = u"src:/";
+    constexpr std::u16string_view DESTINATION_DEVICE = u"dst:/";
+
+    // Number of allocations made through operator new. The walk benchmark uses it to show what walking costs per entry.
+    std::atomic<uint64_t> s_AllocationCount = 0;
+} // namespace
+
+// Every allocation in the benchmark goes through these so they can be counted.
+void *operator new(size_t Size)
+{
+    s_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+    void *Memory = std::malloc(Size > 0 ? Size : 1);
+    if (!Memory) { std::abort(); }
+    return Memory;
+}
+
+void operator delete(void *Memory) noexcept { std::free(Memory); }
+
+void operator delete(void *Memory, size_t) noexcept { std::free(Memory); }
+
+// Returns milliseconds since Start.
+static double GetElapsed(std::chrono::steady_clock::time_point Start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+}
+
+// Hashes a whole file.
+static bool HashFile(const fslib::Path &FilePath, uint64_t &HashOut)
+{
+    fslib::File File(FilePath, FS_OPEN_READ);
+    if (!File.is_open()) { return false; }
+
+    std::unique_ptr<unsigned char[]> Buffer(new unsigned char[HASH_CHUNK_SIZE]);
+    FS::Hash64 FileHash;
+    for (ssize_t BytesRead = File.read(Buffer.get(), HASH_CHUNK_SIZE); BytesRead > 0;
+         BytesRead         = File.read(Buffer.get(), HASH_CHUNK_SIZE))
+    {
+        FileHash.Update(Buffer.get(), BytesRead);
+    }
+    HashOut = FileHash.Finish();
+    return true;
+}
+
+// Checks every file in Source made it to Destination intact. The first difference found is printed.
+static bool CompareTrees(const fslib::Path &Source, const fslib::Path &Destination)
+{
+    FS::DirectoryWalker Walker(Source);
+    while (Walker.Next())
+    {
+        if (Walker.GetEntry().is_directory()) { continue; }
+
+        uint64_t SourceHash = 0, DestinationHash = 0;
+        fslib::Path DestinationPath = Destination / Walker.GetRelativePath();
+        if (!HashFile(Walker.GetPath(), SourceHash) || !HashFile(DestinationPath, DestinationHash) ||
+            SourceHash != DestinationHash)
+        {
+            std::string Name;
+            for (char16_t Character : Walker.GetRelativePath()) { Name += static_cast<char>(Character); }
+            std::printf("Mismatch: %s\n", Name.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// Copies Source to Destination with 1 to MAX_BENCHMARK_WORKERS workers and prints the throughput of each.
+static int RunCopyBenchmark(const char *Source, const char *Destination, uint32_t Latency, uint32_t Speed)
+{
+    fslib::host::map_device(SOURCE_DEVICE.substr(0, 3), Source);
+    fslib::host::map_device(DESTINATION_DEVICE.substr(0, 3), Destination);
+    fslib::Path SourcePath(SOURCE_DEVICE), DestinationPath(DESTINATION_DEVICE);
+
+    FS::DirectoryTotals Totals;
+    FS::GetDirectoryTotals(SourcePath, Totals);
+    std::printf("%u files, %llu bytes. Device latency %uus, speed %u MB/s.\n",
+                Totals.FileCount,
+                static_cast<unsigned long long>(Totals.TotalSize),
+                Latency,
+                Speed);
+
+    bool AllMatched = true;
+    for (size_t Workers = 1; Workers <= MAX_BENCHMARK_WORKERS; Workers++)
+    {
+        fslib::delete_directory_recursively(DestinationPath);
+
+        // The simulated speed only applies to the copy itself.
+        FS::SetCopyWorkerCount(Workers);
+        fslib::host::set_device_speed(Latency, Speed);
+        auto CopyStart = std::chrono::steady_clock::now();
+        FS::CopyDirectoryToDirectory(nullptr, SourcePath, DestinationPath, nullptr, nullptr, nullptr, nullptr);
+        double CopyTime = GetElapsed(CopyStart);
+        fslib::host::set_device_speed(0, 0);
+
+        bool Matched = CompareTrees(SourcePath, DestinationPath);
+        AllMatched   = AllMatched && Matched;
+        std::printf("%zu worker(s): %.1fms, %.2f MB/s, %.0f files/s%s\n",
+                    Workers,
+                    CopyTime,
+                    CopyTime > 0 ? (Totals.TotalSize / 1048576.0) / (CopyTime / 1000.0) : 0.0,
+                    CopyTime > 0 ? Totals.FileCount / (CopyTime / 1000.0) : 0.0,
+                    Matched ? "" : ", copy doesn't match");
+    }
+    return AllMatched ? 0 : 1;
+}
+
+// Fills Root with Count small files of random sizes and contents, SMALL_FILES_PER_DIRECTORY to a directory.
+static bool GenerateSmallFiles(const fslib::Path &Root, uint32_t Count)
+{
+    std::mt19937 Random(0x4A4B534D);
+    std::uniform_int_distribution<size_t> SizeRange(SMALL_FILE_MIN_SIZE, SMALL_FILE_MAX_SIZE);
+    unsigned char Data[SMALL_FILE_MAX_SIZE];
+
+    fslib::delete_directory_recursively(Root);
+    fslib::create_directory(Root);
+    fslib::Path Directory(Root);
+    for (uint32_t i = 0; i < Count; i++)
+    {
+        if (i % SMALL_FILES_PER_DIRECTORY == 0)
+        {
+            std::u16string Name = u"d";
+            for (char Character : std::to_string(i / SMALL_FILES_PER_DIRECTORY)) { Name += static_cast<char16_t>(Character); }
+            Directory = Root / Name;
+            if (!fslib::create_directory(Directory)) { return false; }
+        }
+
+        std::u16string Name = u"f";
+        for (char Character : std::to_string(i)) { Name += static_cast<char16_t>(Character); }
+        size_t Size = SizeRange(Random);
+        for (size_t j = 0; j < Size; j++) { Data[j] = static_cast<unsigned char>(Random()); }
+
+        fslib::File File(Directory / Name, FS_OPEN_CREATE | FS_OPEN_WRITE, Size);
+        if (!File.is_open() || File.write(Data, Size) != static_cast<ssize_t>(Size)) { return false; }
+    }
+    return true;
+}
+
+// Generates Count small files in Scratch and copies them one at a time with small file batching off and then on, printing
+// files per second for both.
+static int RunSmallFileBenchmark(const char *Scratch, uint32_t Count, uint32_t Latency, uint32_t Speed)
+{
+    fslib::host::map_device(SOURCE_DEVICE.substr(0, 3), Scratch);
+    fslib::Path ScratchPath(SOURCE_DEVICE);
+    fslib::Path SourcePath = ScratchPath / u"Source", DestinationPath = ScratchPath / u"Destination";
+    if (!GenerateSmallFiles(SourcePath, Count))
+    {
+        std::printf("Couldn't generate the small files.\n");
+        return 1;
+    }
+
+    FS::DirectoryTotals Totals;
+    FS::GetDirectoryTotals(SourcePath, Totals);
+    std::printf("%u files, %llu bytes. Device latency %uus, speed %u MB/s.\n",
+                Totals.FileCount,
+                static_cast<unsigned long long>(Totals.TotalSize),
+                Latency,
+                Speed);
+
+    // Batching only changes how small files are written, so the parallel copies stay out of it.
+    bool AllMatched      = true;
+    double UnbatchedTime = 0;
+    FS::SetCopyWorkerCount(1);
+    for (bool Batching : {false, true})
+    {
+        fslib::delete_directory_recursively(DestinationPath);
+        fslib::create_directory(DestinationPath);
+        FS::SetSmallFileBatching(Batching);
+        fslib::host::set_device_speed(Latency, Speed);
+        auto CopyStart = std::chrono::steady_clock::now();
+        FS::CopyDirectoryToDirectory(nullptr, SourcePath, DestinationPath, nullptr, nullptr, nullptr, nullptr);
+        double CopyTime = GetElapsed(CopyStart);
+        fslib::host::set_device_speed(0, 0);
+        if (!Batching) { UnbatchedTime = CopyTime; }
+
+        bool Matched = CompareTrees(SourcePath, DestinationPath);
+        AllMatched   = AllMatched && Matched;
+        std::printf("%s: %.1fms, %.0f files/s, %.2f MB/s, %.2fx%s\n",
+                    Batching ? "Batched" : "Unbatched",
+                    CopyTime,
+                    CopyTime > 0 ? Totals.FileCount / (CopyTime / 1000.0) : 0.0,
+                    CopyTime > 0 ? (Totals.TotalSize / 1048576.0) / (CopyTime / 1000.0) : 0.0,
+                    CopyTime > 0 ? UnbatchedTime / CopyTime : 0.0,
+                    Matched ? "" : ", copy doesn't match");
+    }
+    FS::SetSmallFileBatching(true);
+    return AllMatched ? 0 : 1;
+}
+
+// Backs Source up to a ZIP in Scratch with 1 to MAX_BENCHMARK_WORKERS deflate workers and prints the throughput and size of
+// each. The last one is then overwritten with Source unchanged. Every ZIP is extracted again and checked against Source.
+static int RunZipBenchmark(const char *Source,
+                           const char *Scratch,
+                           uint32_t Latency,
+                           uint32_t Speed,
+                           FS::CompressionPreference Preference)
+{
+    fslib::host::map_device(SOURCE_DEVICE.substr(0, 3), Source);
+    fslib::host::map_device(DESTINATION_DEVICE.substr(0, 3), Scratch);
+    fslib::Path SourcePath(SOURCE_DEVICE), ScratchPath(DESTINATION_DEVICE);
+    fslib::Path ZipPath = ScratchPath / u"Backup.zip", ExtractPath = ScratchPath / u"Extracted";
+
+    FS::DirectoryTotals Totals;
+    FS::GetDirectoryTotals(SourcePath, Totals);
+    std::printf("%u files, %llu bytes. Device latency %uus, speed %u MB/s. Compression preference %u.\n",
+                Totals.FileCount,
+                static_cast<unsigned long long>(Totals.TotalSize),
+                Latency,
+                Speed,
+                static_cast<unsigned int>(Preference));
+
+    bool AllMatched  = true;
+    double FirstTime = 0;
+    for (size_t Workers = 1; Workers <= MAX_BENCHMARK_WORKERS; Workers++)
+    {
+        FS::SetCopyWorkerCount(Workers);
+        fslib::host::set_device_speed(Latency, Speed);
+        auto ZipStart  = std::chrono::steady_clock::now();
+        zipFile Backup = FS::OpenZipForWriting(ZipPath);
+        if (!Backup)
+        {
+            std::printf("Couldn't create the ZIP.\n");
+            return 1;
+        }
+        bool Copied    = FS::CopyDirectoryToZip(nullptr, SourcePath, Backup, Preference, nullptr);
+        bool Closed    = zipClose(Backup, NULL) == ZIP_OK && Copied;
+        double ZipTime = GetElapsed(ZipStart);
+        fslib::host::set_device_speed(0, 0);
+        if (Workers == 1) { FirstTime = ZipTime; }
+
+        uint64_t ZipSize = 0;
+        fslib::get_file_size(ZipPath, ZipSize);
+
+        fslib::delete_directory_recursively(ExtractPath);
+        fslib::create_directory(ExtractPath);
+        unzFile Extract = FS::OpenZipForReading(ZipPath);
+        if (Extract)
+        {
+            FS::CopyZipToDirectory(nullptr, Extract, ExtractPath, nullptr, nullptr);
+            unzClose(Extract);
+        }
+
+        bool Matched = Closed && Extract && CompareTrees(SourcePath, ExtractPath);
+        AllMatched   = AllMatched && Matched;
+        std::printf("%zu worker(s): %.1fms, %.2f MB/s, %.2fx, %llu bytes%s\n",
+                    Workers,
+                    ZipTime,
+                    ZipTime > 0 ? (Totals.TotalSize / 1048576.0) / (ZipTime / 1000.0) : 0.0,
+                    ZipTime > 0 ? FirstTime / ZipTime : 0.0,
+                    static_cast<unsigned long long>(ZipSize),
+                    Matched ? "" : ", ZIP doesn't match");
+    }
+
+    // Overwriting the last ZIP with nothing changed. Every entry should be copied over from it without being deflated.
+    fslib::Path UpdatePath = ScratchPath / u"Update.zip";
+    fslib::host::set_device_speed(Latency, Speed);
+    auto UpdateStart  = std::chrono::steady_clock::now();
+    unzFile Previous  = FS::OpenZipForReading(ZipPath);
+    zipFile Update    = FS::OpenZipForWriting(UpdatePath);
+    bool Updated      = Update && FS::CopyDirectoryToZip(nullptr, SourcePath, Update, Preference, Previous);
+    Updated           = Update && zipClose(Update, NULL) == ZIP_OK && Updated;
+    double UpdateTime = GetElapsed(UpdateStart);
+    fslib::host::set_device_speed(0, 0);
+    if (Previous) { unzClose(Previous); }
+
+    fslib::delete_directory_recursively(ExtractPath);
+    fslib::create_directory(ExtractPath);
+    unzFile Extract = Updated ? FS::OpenZipForReading(UpdatePath) : nullptr;
+    if (Extract)
+    {
+        FS::CopyZipToDirectory(nullptr, Extract, ExtractPath, nullptr, nullptr);
+        unzClose(Extract);
+    }
+
+    bool Matched = Extract && CompareTrees(SourcePath, ExtractPath);
+    AllMatched   = AllMatched && Matched;
+    std::printf("Unchanged overwrite: %.1fms, %.2f MB/s, %.2fx%s\n",
+                UpdateTime,
+                UpdateTime > 0 ? (Totals.TotalSize / 1048576.0) / (UpdateTime / 1000.0) : 0.0,
+                UpdateTime > 0 ? FirstTime / UpdateTime : 0.0,
+                Matched ? "" : ", ZIP doesn't match");
+    return AllMatched ? 0 : 1;
+}
+
+// Prints how long a backup and its restore took, the size of the backup and whether the restore matched.
+static void PrintArchiveResult(const char *Name,
+                               double BackupTime,
+                               double RestoreTime,
+                               uint64_t TotalSize,
+                               uint64_t BackupSize,
+                               bool Matched)
+{
+    std::printf("%s: backup %.1fms (%.2f MB/s), restore %.1fms (%.2f MB/s), %llu bytes (%.1f%%)%s\n",
+                Name,
+                BackupTime,
+                BackupTime > 0 ? (TotalSize / 1048576.0) / (BackupTime / 1000.0) : 0.0,
+                RestoreTime,
+                RestoreTime > 0 ? (TotalSize / 1048576.0) / (RestoreTime / 1000.0) : 0.0,
+                static_cast<unsigned long long>(BackupSize),
+                TotalSize > 0 ? BackupSize * 100.0 / TotalSize : 0.0,
+                Matched ? "" : ", restore doesn't match");
+}
+
+// Backs Source up to a ZIP and to a .jksm archive in Scratch with Workers workers each, restores both and prints how they
+// compare.
+static int RunArchiveBenchmark(const char *Source, const char *Scratch, uint32_t Latency, uint32_t Speed, size_t Workers)
+{
+    fslib::host::map_device(SOURCE_DEVICE.substr(0, 3), Source);
+    fslib::host::map_device(DESTINATION_DEVICE.substr(0, 3), Scratch);
+    fslib::Path SourcePath(SOURCE_DEVICE), ScratchPath(DESTINATION_DEVICE);
+    fslib::Path ZipPath     = ScratchPath / u"Backup.zip", ArchivePath = ScratchPath / u"Backup.jksm";
+    fslib::Path ExtractPath = ScratchPath / u"Extracted";
+
+    FS::DirectoryTotals Totals;
+    FS::GetDirectoryTotals(SourcePath, Totals);
+    std::printf("%u files, %llu bytes. Device latency %uus, speed %u MB/s. %zu worker(s).\n",
+                Totals.FileCount,
+                static_cast<unsigned long long>(Totals.TotalSize),
+                Latency,
+                Speed,
+                Workers);
+    FS::SetCopyWorkerCount(Workers);
+
+    // ZIP with the default preference.
+    fslib::host::set_device_speed(Latency, Speed);
+    auto BackupStart     = std::chrono::steady_clock::now();
+    zipFile Backup       = FS::OpenZipForWriting(ZipPath);
+    bool ZipWritten =
+        Backup && FS::CopyDirectoryToZip(nullptr, SourcePath, Backup, FS::CompressionPreference::Balanced, nullptr);
+    ZipWritten           = Backup && zipClose(Backup, NULL) == ZIP_OK && ZipWritten;
+    double ZipBackupTime = GetElapsed(BackupStart);
+
+    fslib::delete_directory_recursively(ExtractPath);
+    fslib::create_directory(ExtractPath);
+    auto RestoreStart = std::chrono::steady_clock::now();
+    unzFile Extract   = ZipWritten ? FS::OpenZipForReading(ZipPath) : nullptr;
+    if (Extract)
+    {
+        FS::CopyZipToDirectory(nullptr, Extract, ExtractPath, nullptr, nullptr);
+        unzClose(Extract);
+    }
+    double ZipRestoreTime = GetElapsed(RestoreStart);
+    fslib::host::set_device_speed(0, 0);
+
+    uint64_t ZipSize = 0;
+    fslib::get_file_size(ZipPath, ZipSize);
+    bool ZipMatched = Extract && CompareTrees(SourcePath, ExtractPath);
+    PrintArchiveResult("ZIP", ZipBackupTime, ZipRestoreTime, Totals.TotalSize, ZipSize, ZipMatched);
+
+    // Same thing with the archive.
+    fslib::host::set_device_speed(Latency, Speed);
+    BackupStart = std::chrono::steady_clock::now();
+    FS::ZstdArchive Archive(FS::GetCopyWorkerCount());
+    bool ArchiveWritten      = Archive.Backup(nullptr, SourcePath, ArchivePath);
+    double ArchiveBackupTime = GetElapsed(BackupStart);
+
+    fslib::delete_directory_recursively(ExtractPath);
+    fslib::create_directory(ExtractPath);
+    RestoreStart              = std::chrono::steady_clock::now();
+    bool ArchiveRestored      = ArchiveWritten && Archive.Restore(nullptr, ArchivePath, ExtractPath, nullptr);
+    double ArchiveRestoreTime = GetElapsed(RestoreStart);
+    fslib::host::set_device_speed(0, 0);
+
+    uint64_t ArchiveSize = 0;
+    fslib::get_file_size(ArchivePath, ArchiveSize);
+    bool ArchiveMatched = ArchiveRestored && CompareTrees(SourcePath, ExtractPath);
+    PrintArchiveResult("JKSM", ArchiveBackupTime, ArchiveRestoreTime, Totals.TotalSize, ArchiveSize, ArchiveMatched);
+
+    return ZipMatched && ArchiveMatched ? 0 : 1;
+}
+
+// Flips a byte in the first chunk found in StorePath so a restore that reads it has to notice. Returns false if there aren't
+// any chunks.
+static bool DamageChunk(const fslib::Path &StorePath)
+{
+    fslib::Directory StoreDir(StorePath);
+    for (uint32_t i = 0; StoreDir.is_open() && i < StoreDir.get_count(); i++)
+    {
+        if (!StoreDir[i].is_directory()) { continue; }
+
+        fslib::Path PrefixPath = StorePath / StoreDir[i];
+        fslib::Directory PrefixDir(PrefixPath);
+        if (!PrefixDir.is_open() || PrefixDir.get_count() == 0) { continue; }
+
+        fslib::File ChunkFile(PrefixPath / PrefixDir[0], FS_OPEN_READ | FS_OPEN_WRITE);
+        unsigned char Byte = 0;
+        if (!ChunkFile.is_open() || ChunkFile.read(&Byte, 1) != 1) { return false; }
+
+        Byte ^= 0xFF;
+        ChunkFile.seek(0, fslib::Stream::BEGINNING);
+        return ChunkFile.write(&Byte, 1) == 1;
+    }
+    return false;
+}
+
+// Backs Source up to a chunk store in Scratch, backs it up again unchanged so every chunk is already there and restores it.
+// A chunk is damaged at the end to make sure the restore catches it.
+static int RunChunkBenchmark(const char *Source, const char *Scratch, uint32_t Latency, uint32_t Speed)
+{
+    fslib::host::map_device(SOURCE_DEVICE.substr(0, 3), Source);
+    fslib::host::map_device(DESTINATION_DEVICE.substr(0, 3), Scratch);
+    fslib::Path SourcePath(SOURCE_DEVICE), ScratchPath(DESTINATION_DEVICE);
+    fslib::Path TitlePath  = ScratchPath / u"Title", ExtractPath = ScratchPath / u"Extracted";
+    fslib::Path FirstIndex  = TitlePath / u"First.jksi", SecondIndex = TitlePath / u"Second.jksi";
+    fslib::Path StorePath  = TitlePath / FS::ChunkStore::STORE_NAME;
+
+    FS::DirectoryTotals Totals;
+    FS::GetDirectoryTotals(SourcePath, Totals);
+    std::printf("%u files, %llu bytes. Device latency %uus, speed %u MB/s.\n",
+                Totals.FileCount,
+                static_cast<unsigned long long>(Totals.TotalSize),
+                Latency,
+                Speed);
+
+    fslib::delete_directory_recursively(TitlePath);
+    fslib::create_directory(TitlePath);
+
+    // Each backup gets its own store like it does in JKSM.
+    fslib::host::set_device_speed(Latency, Speed);
+    auto FirstStart   = std::chrono::steady_clock::now();
+    bool FirstWritten = FS::ChunkStore(TitlePath).Backup(nullptr, SourcePath, FirstIndex);
+    double FirstTime  = GetElapsed(FirstStart);
+    fslib::host::set_device_speed(0, 0);
+
+    FS::DirectoryTotals FirstStore;
+    FS::GetDirectoryTotals(StorePath, FirstStore);
+
+    fslib::host::set_device_speed(Latency, Speed);
+    auto SecondStart   = std::chrono::steady_clock::now();
+    bool SecondWritten = FirstWritten && FS::ChunkStore(TitlePath).Backup(nullptr, SourcePath, SecondIndex);
+    double SecondTime  = GetElapsed(SecondStart);
+    fslib::host::set_device_speed(0, 0);
+
+    FS::DirectoryTotals SecondStore;
+    FS::GetDirectoryTotals(StorePath, SecondStore);
+
+    fslib::delete_directory_recursively(ExtractPath);
+    fslib::create_directory(ExtractPath);
+    fslib::host::set_device_speed(Latency, Speed);
+    auto RestoreStart  = std::chrono::steady_clock::now();
+    bool Restored      = SecondWritten && FS::ChunkStore(TitlePath).Restore(nullptr, SecondIndex, ExtractPath, nullptr);
+    double RestoreTime = GetElapsed(RestoreStart);
+    fslib::host::set_device_speed(0, 0);
+
+    bool Matched = Restored && CompareTrees(SourcePath, ExtractPath);
+    PrintArchiveResult("Chunks", FirstTime, RestoreTime, Totals.TotalSize, FirstStore.TotalSize, Matched);
+    std::printf("Unchanged backup: %.1fms, %.2f MB/s, %.2fx, store grew by %llu bytes in %u chunk(s)\n",
+                SecondTime,
+                SecondTime > 0 ? (Totals.TotalSize / 1048576.0) / (SecondTime / 1000.0) : 0.0,
+                SecondTime > 0 ? FirstTime / SecondTime : 0.0,
+                static_cast<unsigned long long>(SecondStore.TotalSize - FirstStore.TotalSize),
+                SecondStore.FileCount - FirstStore.FileCount);
+
+    // The restore has to fail once a chunk no longer matches its ID.
+    fslib::delete_directory_recursively(ExtractPath);
+    fslib::create_directory(ExtractPath);
+    bool Damaged  = DamageChunk(StorePath);
+    bool Detected = Damaged && !FS::ChunkStore(TitlePath).Restore(nullptr, SecondIndex, ExtractPath, nullptr);
+    std::printf("Damaged chunk: %s\n", Detected ? "restore failed" : "not caught");
+
+    return Matched && Detected ? 0 : 1;
+}
+
+// Measures Hash64 one shot and fed in copy sized chunks.
+static int RunHashBenchmark()
+{
+    std::unique_ptr<unsigned char[]> Buffer(new unsigned char[HASH_BUFFER_SIZE]);
+    std::mt19937 Random(0x4A4B534D);
+    for (size_t i = 0; i < HASH_BUFFER_SIZE; i++) { Buffer[i] = static_cast<unsigned char>(Random()); }
+
+    double TotalMegabytes = (static_cast<double>(HASH_BUFFER_SIZE) * HASH_PASSES) / 1048576.0;
+
+    // The results are summed so the passes can't be skipped.
+    uint64_t Sum      = 0;
+    auto OneShotStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < HASH_PASSES; i++) { Sum += FS::Hash64::Get(Buffer.get(), HASH_BUFFER_SIZE, i); }
+    double OneShotTime = GetElapsed(OneShotStart);
+
+    auto StreamingStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < HASH_PASSES; i++)
+    {
+        FS::Hash64 Hash(i);
+        for (size_t Offset = 0; Offset < HASH_BUFFER_SIZE; Offset += HASH_CHUNK_SIZE)
+        {
+            Hash.Update(&Buffer[Offset], HASH_CHUNK_SIZE);
+        }
+        Sum -= Hash.Finish();
+    }
+    double StreamingTime = GetElapsed(StreamingStart);
+
+    std::printf("One shot: %.2f MB/s\n", TotalMegabytes / (OneShotTime / 1000.0));
+    std::printf("Streaming: %.2f MB/s\n", TotalMegabytes / (StreamingTime / 1000.0));
+    // Both ways have to come out the same.
+    if (Sum != 0)
+    {
+        std::printf("One shot and streaming hashes don't match.\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Builds a tree Depth directories deep with Width directories at every level, walks it and prints how much memory the
+// walker's queue needed and how many allocations it made. Files get their destination built the way copies do it. That
+// shouldn't allocate at all once the buffers have grown, so only opening directories should.
+static int RunWalkBenchmark(const char *Scratch, int Depth, int Width, size_t QueueLimit)
+{
+    fslib::host::map_device(SOURCE_DEVICE.substr(0, 3), Scratch);
+    fslib::Path Root(SOURCE_DEVICE);
+    fslib::delete_directory_recursively(Root);
+
+    // One chain Depth deep with Width directories hanging off of every level.
+    uint32_t Created = 0;
+    fslib::Path Level(Root);
+    for (int i = 0; i < Depth; i++)
+    {
+        for (int j = 0; j < Width; j++)
+        {
+            std::u16string Name = u"w";
+            for (char Character : std::to_string(j)) { Name += static_cast<char16_t>(Character); }
+            fslib::create_directory(Level / Name);
+            fslib::create_file(Level / Name / u"file");
+            Created += 2;
+        }
+        Level /= u"d";
+        fslib::create_directory(Level);
+        ++Created;
+    }
+
+    fslib::Path DestinationRoot(DESTINATION_DEVICE);
+    uint32_t Walked          = 0;
+    uint32_t FilesWalked     = 0;
+    uint64_t FileAllocations = 0;
+    uint64_t StartCount      = s_AllocationCount.load();
+    auto WalkStart           = std::chrono::steady_clock::now();
+    FS::DirectoryWalker Walker(Root, QueueLimit);
+    FS::PathBuilder DestinationBuilder(DestinationRoot);
+    while (Walker.Next())
+    {
+        ++Walked;
+        if (Walker.GetEntry().is_directory()) { continue; }
+
+        uint64_t FileStart = s_AllocationCount.load();
+        // Both paths are opened by a copy.
+        DestinationBuilder.SetRelative(Walker.GetRelativePath());
+        Walker.GetPath();
+        DestinationBuilder.GetPath();
+        FileAllocations += s_AllocationCount.load() - FileStart;
+        ++FilesWalked;
+    }
+    double WalkTime      = GetElapsed(WalkStart);
+    uint64_t Allocations = s_AllocationCount.load() - StartCount;
+    uint32_t Directories = Walked - FilesWalked + 1;
+
+    std::printf("%u of %u entries walked in %.1fms. Queue peaked at %zu bytes with a limit of %zu.\n",
+                Walked,
+                Created,
+                WalkTime,
+                Walker.GetPeakQueueSize(),
+                QueueLimit);
+    std::printf("%llu allocations: %.2f per directory opened. %llu made handling %u files.\n",
+                static_cast<unsigned long long>(Allocations),
+                static_cast<double>(Allocations - FileAllocations) / Directories,
+                static_cast<unsigned long long>(FileAllocations),
+                FilesWalked);
+    return Walked == Created ? 0 : 1;
+}
+
+static void PrintUsage()
+{
+    std::printf("Usage:\n"
+                "  jksmbench copy <source> <destination> [latency us] [MB/s]\n"
+                "  jksmbench smallfiles <scratch> [count] [latency us] [MB/s]\n"
+                "  jksmbench hash\n"
+                "  jksmbench zip <source> <scratch> [latency us] [MB/s] [0 speed|1 balanced|2 size]\n"
+                "  jksmbench archive <source> <scratch> [latency us] [MB/s] [workers]\n"
+                "  jksmbench chunks <source> <scratch> [latency us] [MB/s]\n"
+                "  jksmbench walk <scratch> [depth] [width] [queue limit]\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    // The log goes wherever JKSM_HOST_SDMC points.
+    fslib::initialize();
+    fslib::create_directory_recursively(fslib::Path(u"sdmc:/JKSM"));
+    logger::initialize();
+
+    std::string_view Command = argv[1];
+    if (Command == "copy" && argc >= 4)
+    {
+        uint32_t Latency = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 0;
+        uint32_t Speed   = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 0;
+        return RunCopyBenchmark(argv[2], argv[3], Latency, Speed);
+    }
+    else if (Command == "smallfiles" && argc >= 3)
+    {
+        uint32_t Count   = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : SMALL_FILE_COUNT;
+        uint32_t Latency = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 0;
+        uint32_t Speed   = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 0;
+        return RunSmallFileBenchmark(argv[2], Count, Latency, Speed);
+    }
+    else if (Command == "hash") { return RunHashBenchmark(); }
+    else if (Command == "zip" && argc >= 4)
+    {
+        uint32_t Latency = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 0;
+        uint32_t Speed   = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 0;
+        int Preference   = argc > 6 ? std::clamp(std::atoi(argv[6]), 0, 2) : 1;
+        return RunZipBenchmark(argv[2], argv[3], Latency, Speed, static_cast<FS::CompressionPreference>(Preference));
+    }
+    else if (Command == "archive" && argc >= 4)
+    {
+        uint32_t Latency = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 0;
+        uint32_t Speed   = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 0;
+        size_t Workers   = argc > 6 ? std::strtoul(argv[6], nullptr, 10) : MAX_BENCHMARK_WORKERS;
+        return RunArchiveBenchmark(argv[2], argv[3], Latency, Speed, Workers);
+    }
+    else if (Command == "chunks" && argc >= 4)
+    {
+        uint32_t Latency = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 0;
+        uint32_t Speed   = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 0;
+        return RunChunkBenchmark(argv[2], argv[3], Latency, Speed);
+    }
+    else if (Command == "walk" && argc >= 3)
+    {
+        int Depth         = argc > 3 ? std::atoi(argv[3]) : 64;
+        int Width         = argc > 4 ? std::atoi(argv[4]) : 64;
+        size_t QueueLimit = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : FS::DirectoryWalker::DEFAULT_QUEUE_LIMIT;
+        return RunWalkBenchmark(argv[2], Depth, Width, QueueLimit);
+    }
+
+    PrintUsage();
+    return 1;
+}
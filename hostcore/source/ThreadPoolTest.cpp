@@ -0,0 +1,154 @@
+#include "System/ThreadPool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Jobs submitted by the tests that queue a lot of them.
+    constexpr int JOB_COUNT = 1000;
+    // Workers the concurrency test runs with.
+    constexpr size_t CONCURRENT_WORKERS = 4;
+    // Longest the concurrency test waits for every worker to be busy at once.
+    constexpr auto CONCURRENT_TIMEOUT = std::chrono::seconds(5);
+
+    // Failed checks. The test fails if any do.
+    int s_FailureCount = 0;
+} // namespace
+
+// Prints Message and counts a failure if Condition is false.
+static void Check(bool Condition, const char *Message)
+{
+    if (Condition) { return; }
+    std::printf("FAILED: %s\n", Message);
+    ++s_FailureCount;
+}
+
+// Every submitted job runs exactly once.
+static void TestSubmit()
+{
+    std::atomic<int> RunCount = 0;
+    System::ThreadPool Pool(CONCURRENT_WORKERS);
+    Check(Pool.GetWorkerCount() == CONCURRENT_WORKERS, "Pool doesn't have the workers it was created with.");
+
+    for (int i = 0; i < JOB_COUNT; i++) { Pool.Submit([&RunCount]() { ++RunCount; }); }
+    // The statistics are only updated once jobs are picked up, so wait for the count to catch up.
+    auto Deadline = std::chrono::steady_clock::now() + CONCURRENT_TIMEOUT;
+    while (RunCount < JOB_COUNT && std::chrono::steady_clock::now() < Deadline) { std::this_thread::yield(); }
+    Check(RunCount == JOB_COUNT, "Not every submitted job ran.");
+}
+
+// Jobs run in the order they're submitted. With one worker, that means they finish in order too.
+static void TestOrder()
+{
+    std::vector<int> Order;
+    {
+        System::ThreadPool Pool(1);
+        for (int i = 0; i < JOB_COUNT; i++) { Pool.Submit([&Order, i]() { Order.push_back(i); }); }
+    }
+
+    bool InOrder = Order.size() == JOB_COUNT;
+    for (size_t i = 0; InOrder && i < Order.size(); i++) { InOrder = Order[i] == static_cast<int>(i); }
+    Check(InOrder, "Jobs didn't run in the order they were submitted.");
+}
+
+// Destroying the pool runs everything still queued before the workers are joined.
+static void TestDrainOnShutdown()
+{
+    std::atomic<int> RunCount = 0;
+    {
+        System::ThreadPool Pool(2);
+        for (int i = 0; i < JOB_COUNT; i++)
+        {
+            Pool.Submit(
+                [&RunCount]()
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(10));
+                    ++RunCount;
+                });
+        }
+    }
+    Check(RunCount == JOB_COUNT, "Jobs still queued when the pool was destroyed didn't run.");
+}
+
+// Every worker can be running a job at the same time.
+static void TestConcurrency()
+{
+    std::mutex BusyLock;
+    std::condition_variable BusyCondition;
+    size_t BusyCount = 0;
+    bool AllBusy     = true;
+    {
+        System::ThreadPool Pool(CONCURRENT_WORKERS);
+        for (size_t i = 0; i < CONCURRENT_WORKERS; i++)
+        {
+            Pool.Submit(
+                [&]()
+                {
+                    // Every job waits until all of them are running. That can only happen if each has its own worker.
+                    std::unique_lock<std::mutex> Lock(BusyLock);
+                    ++BusyCount;
+                    BusyCondition.notify_all();
+                    if (!BusyCondition.wait_for(Lock,
+                                                CONCURRENT_TIMEOUT,
+                                                [&BusyCount]() { return BusyCount == CONCURRENT_WORKERS; }))
+                    {
+                        AllBusy = false;
+                    }
+                });
+        }
+    }
+    Check(AllBusy, "Workers didn't run jobs at the same time.");
+}
+
+// Statistics count every job and start over when they're reset.
+static void TestStatistics()
+{
+    System::ThreadPool Pool(1);
+    std::mutex GateLock;
+    GateLock.lock();
+    // The first job holds the only worker so the rest have to wait in the queue.
+    Pool.Submit([&GateLock]() { std::scoped_lock<std::mutex> Gate(GateLock); });
+    for (int i = 0; i < 9; i++) { Pool.Submit([]() {}); }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    GateLock.unlock();
+
+    auto Deadline = std::chrono::steady_clock::now() + CONCURRENT_TIMEOUT;
+    while (Pool.GetStatistics().JobCount < 10 && std::chrono::steady_clock::now() < Deadline) { std::this_thread::yield(); }
+
+    System::ThreadPool::Statistics Statistics = Pool.GetStatistics();
+    Check(Statistics.JobCount == 10, "Statistics didn't count every job.");
+    Check(Statistics.MaxWaitTime >= 10000, "Statistics didn't record the time jobs waited behind a busy worker.");
+    Check(Statistics.TotalWaitTime >= Statistics.MaxWaitTime, "Total wait is less than the worst wait.");
+
+    Pool.ResetStatistics();
+    Pool.Submit([]() {});
+    Deadline = std::chrono::steady_clock::now() + CONCURRENT_TIMEOUT;
+    while (Pool.GetStatistics().JobCount < 1 && std::chrono::steady_clock::now() < Deadline) { std::this_thread::yield(); }
+
+    Statistics = Pool.GetStatistics();
+    Check(Statistics.JobCount == 1, "Statistics weren't reset.");
+    Check(Statistics.MaxWaitTime < 10000, "Worst wait from before the reset was kept.");
+}
+
+int main()
+{
+    TestSubmit();
+    TestOrder();
+    TestDrainOnShutdown();
+    TestConcurrency();
+    TestStatistics();
+
+    if (s_FailureCount > 0)
+    {
+        std::printf("%d check(s) failed.\n", s_FailureCount);
+        return 1;
+    }
+    std::printf("All thread pool checks passed.\n");
+    return 0;
+}
@@ -0,0 +1,244 @@
+#include <3ds.h>
+#include <limits.h>
+#include <thread>
+
+struct Thread_tag
+{
+        std::thread HostThread;
+};
+
+// These follow libctru's behavior: conversion stops at the NUL terminator, which is not written, and the number of units
+// needed is returned even if it didn't fit.
+
+ssize_t decode_utf8(uint32_t *out, const uint8_t *in)
+{
+    uint8_t code1 = in[0];
+    if (code1 < 0x80)
+    {
+        *out = code1;
+        return 1;
+    }
+    else if (code1 < 0xC2) { return -1; }
+    else if (code1 < 0xE0)
+    {
+        uint8_t code2 = in[1];
+        if ((code2 & 0xC0) != 0x80) { return -1; }
+        *out = (code1 << 6) + code2 - 0x3080;
+        return 2;
+    }
+    else if (code1 < 0xF0)
+    {
+        uint8_t code2 = in[1];
+        if ((code2 & 0xC0) != 0x80) { return -1; }
+        if (code1 == 0xE0 && code2 < 0xA0) { return -1; }
+        uint8_t code3 = in[2];
+        if ((code3 & 0xC0) != 0x80) { return -1; }
+        *out = (code1 << 12) + (code2 << 6) + code3 - 0xE2080;
+        return 3;
+    }
+    else if (code1 < 0xF5)
+    {
+        uint8_t code2 = in[1];
+        if ((code2 & 0xC0) != 0x80) { return -1; }
+        if (code1 == 0xF0 && code2 < 0x90) { return -1; }
+        if (code1 == 0xF4 && code2 >= 0x90) { return -1; }
+        uint8_t code3 = in[2];
+        if ((code3 & 0xC0) != 0x80) { return -1; }
+        uint8_t code4 = in[3];
+        if ((code4 & 0xC0) != 0x80) { return -1; }
+        *out = (code1 << 18) + (code2 << 12) + (code3 << 6) + code4 - 0x3C82080;
+        return 4;
+    }
+    return -1;
+}
+
+ssize_t encode_utf8(uint8_t *out, uint32_t in)
+{
+    if (in < 0x80)
+    {
+        if (out) { out[0] = in; }
+        return 1;
+    }
+    else if (in < 0x800)
+    {
+        if (out)
+        {
+            out[0] = (in >> 6) + 0xC0;
+            out[1] = (in & 0x3F) + 0x80;
+        }
+        return 2;
+    }
+    else if (in < 0x10000)
+    {
+        if (in >= 0xD800 && in < 0xE000) { return -1; }
+        if (out)
+        {
+            out[0] = (in >> 12) + 0xE0;
+            out[1] = ((in >> 6) & 0x3F) + 0x80;
+            out[2] = (in & 0x3F) + 0x80;
+        }
+        return 3;
+    }
+    else if (in < 0x110000)
+    {
+        if (out)
+        {
+            out[0] = (in >> 18) + 0xF0;
+            out[1] = ((in >> 12) & 0x3F) + 0x80;
+            out[2] = ((in >> 6) & 0x3F) + 0x80;
+            out[3] = (in & 0x3F) + 0x80;
+        }
+        return 4;
+    }
+    return -1;
+}
+
+ssize_t decode_utf16(uint32_t *out, const uint16_t *in)
+{
+    uint16_t code1 = in[0];
+    if (code1 >= 0xDC00 && code1 < 0xE000) { return -1; }
+    if (code1 >= 0xD800 && code1 < 0xDC00)
+    {
+        uint16_t code2 = in[1];
+        if (code2 < 0xDC00 || code2 >= 0xE000) { return -1; }
+        *out = (code1 << 10) + code2 - 0x35FDC00;
+        return 2;
+    }
+    *out = code1;
+    return 1;
+}
+
+ssize_t encode_utf16(uint16_t *out, uint32_t in)
+{
+    if (in < 0x10000)
+    {
+        if (out) { *out = in; }
+        return 1;
+    }
+    else if (in < 0x110000)
+    {
+        if (out)
+        {
+            out[0] = (in >> 10) + 0xD7C0;
+            out[1] = (in & 0x3FF) + 0xDC00;
+        }
+        return 2;
+    }
+    return -1;
+}
+
+ssize_t utf8_to_utf16(uint16_t *out, const uint8_t *in, size_t len)
+{
+    ssize_t rc = 0;
+    ssize_t units;
+    uint32_t code;
+    uint16_t encoded[2];
+
+    do {
+        units = decode_utf8(&code, in);
+        if (units == -1) { return -1; }
+
+        if (code > 0)
+        {
+            in += units;
+            units = encode_utf16(encoded, code);
+            if (units == -1) { return -1; }
+
+            if (out != nullptr && rc + units <= static_cast<ssize_t>(len))
+            {
+                *out++ = encoded[0];
+                if (units > 1) { *out++ = encoded[1]; }
+            }
+
+            if (SSIZE_MAX - units >= rc) { rc += units; }
+            else { return -1; }
+        }
+    } while (code > 0);
+
+    return rc;
+}
+
+ssize_t utf16_to_utf8(uint8_t *out, const uint16_t *in, size_t len)
+{
+    ssize_t rc = 0;
+    ssize_t units;
+    uint32_t code;
+    uint8_t encoded[4];
+
+    do {
+        units = decode_utf16(&code, in);
+        if (units == -1) { return -1; }
+
+        if (code > 0)
+        {
+            in += units;
+            units = encode_utf8(encoded, code);
+            if (units == -1) { return -1; }
+
+            if (out != nullptr && rc + units <= static_cast<ssize_t>(len))
+            {
+                for (ssize_t i = 0; i < units; i++) { *out++ = encoded[i]; }
+            }
+
+            if (SSIZE_MAX - units >= rc) { rc += units; }
+            else { return -1; }
+        }
+    } while (code > 0);
+
+    return rc;
+}
+
+Result AM_GetTitleCount(FS_MediaType, u32 *count)
+{
+    *count = 0;
+    return 0;
+}
+
+Result AM_GetTitleList(u32 *titlesRead, FS_MediaType, u32, u64 *)
+{
+    *titlesRead = 0;
+    return 0;
+}
+
+Result AM_GetTitleProductCode(FS_MediaType, u64, char *productCode)
+{
+    productCode[0] = '\0';
+    return 0;
+}
+
+Result FSUSER_ControlSecureSave(FS_SecureSaveAction, void *, u32, void *, u32) { return 0; }
+
+Thread threadCreate(ThreadFunc entrypoint, void *arg, size_t, int, int, bool detached)
+{
+    Thread NewThread = new Thread_tag{std::thread(entrypoint, arg)};
+    if (detached) { NewThread->HostThread.detach(); }
+    return NewThread;
+}
+
+Result threadJoin(Thread thread, u64)
+{
+    if (thread->HostThread.joinable()) { thread->HostThread.join(); }
+    return 0;
+}
+
+void threadFree(Thread thread) { delete thread; }
+
+Result svcGetThreadPriority(s32 *out, Handle)
+{
+    *out = 0x30;
+    return 0;
+}
+
+Result CFGU_GetSystemLanguage(u8 *language)
+{
+    *language = CFG_LANGUAGE_EN;
+    return 0;
+}
+
+Result APT_CheckNew3DS(bool *out)
+{
+    *out = true;
+    return 0;
+}
+
+void osSetSpeedupEnable(bool) {}
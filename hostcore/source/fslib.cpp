@@ -0,0 +1,625 @@
+#include "fslib.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace
+{
+    // Device name -> host directory.
+    std::unordered_map<std::u16string, std::string> s_deviceMap{};
+    std::mutex s_deviceLock{};
+
+    // Last error.
+    thread_local std::string s_errorString = "No errors encountered.";
+
+    // Count of control_device calls.
+    std::atomic<uint64_t> s_commitCount{};
+
+    // Secure values "stored" by the stand-in.
+    std::unordered_map<uint32_t, uint64_t> s_secureValues{};
+
+    // Simulated device speed. 0 is as fast as the host allows. Every transfer shares the same bandwidth, so the time the
+    // device is busy until is tracked across threads.
+    std::atomic<uint32_t> s_deviceLatency{};
+    std::atomic<uint32_t> s_deviceSpeed{};
+    std::chrono::steady_clock::time_point s_deviceBusyUntil{};
+    std::mutex s_deviceSpeedLock{};
+} // namespace
+
+// Sleeps for however long a transfer of size bytes would take on the simulated device. Latency overlaps between threads, but
+// the transfers themselves are queued one after another.
+static void simulate_transfer(size_t size)
+{
+    const uint32_t latency = s_deviceLatency.load();
+    const uint32_t speed   = s_deviceSpeed.load();
+    if (latency == 0 && speed == 0) { return; }
+
+    auto finished = std::chrono::steady_clock::now() + std::chrono::microseconds(latency);
+    if (speed > 0)
+    {
+        const uint64_t transferTime = (static_cast<uint64_t>(size) * 1000000) / (static_cast<uint64_t>(speed) << 20);
+
+        std::lock_guard speedGuard{s_deviceSpeedLock};
+        s_deviceBusyUntil = std::max(s_deviceBusyUntil, finished) + std::chrono::microseconds(transferTime);
+        finished          = s_deviceBusyUntil;
+    }
+    std::this_thread::sleep_until(finished);
+}
+
+static std::string to_utf8(std::u16string_view string)
+{
+    std::string utf8{};
+    utf8.resize(string.length() * 3 + 1);
+    std::u16string terminated{string};
+    ssize_t length = utf16_to_utf8(reinterpret_cast<uint8_t *>(utf8.data()),
+                                   reinterpret_cast<const uint16_t *>(terminated.c_str()),
+                                   utf8.size());
+    utf8.resize(length < 0 ? 0 : static_cast<size_t>(length));
+    return utf8;
+}
+
+static std::u16string to_utf16(const char *string)
+{
+    std::u16string utf16{};
+    utf16.resize(std::strlen(string) + 1);
+    ssize_t length =
+        utf8_to_utf16(reinterpret_cast<uint16_t *>(utf16.data()), reinterpret_cast<const uint8_t *>(string), utf16.size());
+    utf16.resize(length < 0 ? 0 : static_cast<size_t>(length));
+    return utf16;
+}
+
+static void set_error(const char *function)
+{
+    s_errorString = std::string(function) + ": " + std::strerror(errno);
+}
+
+static bool set_error_return(const char *function)
+{
+    set_error(function);
+    return false;
+}
+
+//                                    ---- DirectoryEntry ----
+
+fslib::DirectoryEntry::DirectoryEntry(std::u16string_view filename, bool isDirectory, uint64_t size)
+    : m_filename(filename)
+    , m_isDirectory(isDirectory)
+    , m_size(size) {};
+
+const char16_t *fslib::DirectoryEntry::get_filename() const { return m_filename.c_str(); }
+
+bool fslib::DirectoryEntry::is_directory() const { return m_isDirectory; }
+
+uint64_t fslib::DirectoryEntry::get_size() const { return m_size; }
+
+//                                    ---- Path ----
+
+fslib::Path::Path(const char16_t *path)
+    : m_path(path) {};
+
+fslib::Path::Path(std::u16string_view path)
+    : m_path(path) {};
+
+fslib::Path::Path(const std::u16string &path)
+    : m_path(path) {};
+
+bool fslib::Path::is_valid() const
+{
+    const size_t colon = m_path.find(u':');
+    return colon != std::u16string::npos && colon + 1 < m_path.length() && m_path[colon + 1] == u'/';
+}
+
+fslib::Path fslib::Path::sub_path(size_t pathLength) const
+{
+    if (pathLength == npos || pathLength > m_path.length()) { pathLength = m_path.length(); }
+    return Path{std::u16string_view{m_path}.substr(0, pathLength)};
+}
+
+size_t fslib::Path::find_first_of(char16_t character) const { return m_path.find(character); }
+
+size_t fslib::Path::find_first_of(char16_t character, size_t begin) const { return m_path.find(character, begin); }
+
+size_t fslib::Path::find_last_of(char16_t character) const { return m_path.rfind(character); }
+
+size_t fslib::Path::find_last_of(char16_t character, size_t begin) const { return m_path.rfind(character, begin); }
+
+const char16_t *fslib::Path::full_path() const { return m_path.c_str(); }
+
+std::u16string_view fslib::Path::get_device_name() const
+{
+    const size_t colon = m_path.find(u':');
+    if (colon == std::u16string::npos) { return {}; }
+    return std::u16string_view{m_path}.substr(0, colon);
+}
+
+const char16_t *fslib::Path::get_filename() const
+{
+    const size_t slash = m_path.rfind(u'/');
+    if (slash == std::u16string::npos) { return m_path.c_str(); }
+    return m_path.c_str() + slash + 1;
+}
+
+std::u16string_view fslib::Path::get_extension() const
+{
+    const std::u16string_view filename{get_filename()};
+    const size_t dot = filename.rfind(u'.');
+    if (dot == std::u16string_view::npos) { return {}; }
+    return filename.substr(dot + 1);
+}
+
+size_t fslib::Path::get_length() const { return m_path.length(); }
+
+fslib::Path &fslib::Path::operator=(const char16_t *path)
+{
+    m_path = path;
+    return *this;
+}
+
+fslib::Path &fslib::Path::operator=(std::u16string_view path)
+{
+    m_path = path;
+    return *this;
+}
+
+fslib::Path &fslib::Path::operator/=(const char16_t *path) { return *this /= std::u16string_view{path}; }
+
+fslib::Path &fslib::Path::operator/=(std::u16string_view path)
+{
+    // Trim slashes so joining never doubles them up.
+    while (!path.empty() && path.front() == u'/') { path.remove_prefix(1); }
+    while (!path.empty() && path.back() == u'/') { path.remove_suffix(1); }
+    if (path.empty()) { return *this; }
+
+    if (m_path.empty() || m_path.back() != u'/') { m_path += u'/'; }
+    m_path += path;
+    return *this;
+}
+
+fslib::Path &fslib::Path::operator/=(const DirectoryEntry &entry) { return *this /= entry.get_filename(); }
+
+fslib::Path &fslib::Path::operator+=(const char16_t *path)
+{
+    m_path += path;
+    return *this;
+}
+
+fslib::Path &fslib::Path::operator+=(std::u16string_view path)
+{
+    m_path += path;
+    return *this;
+}
+
+fslib::Path fslib::operator/(const Path &pathA, const char16_t *pathB)
+{
+    Path newPath{pathA};
+    newPath /= pathB;
+    return newPath;
+}
+
+fslib::Path fslib::operator/(const Path &pathA, std::u16string_view pathB)
+{
+    Path newPath{pathA};
+    newPath /= pathB;
+    return newPath;
+}
+
+fslib::Path fslib::operator/(const Path &pathA, const DirectoryEntry &entry)
+{
+    Path newPath{pathA};
+    newPath /= entry;
+    return newPath;
+}
+
+fslib::Path fslib::operator+(const Path &pathA, const char16_t *pathB)
+{
+    Path newPath{pathA};
+    newPath += pathB;
+    return newPath;
+}
+
+fslib::Path fslib::operator+(const Path &pathA, std::u16string_view pathB)
+{
+    Path newPath{pathA};
+    newPath += pathB;
+    return newPath;
+}
+
+//                                    ---- Stream ----
+
+int64_t fslib::Stream::tell() const { return m_offset; }
+
+int64_t fslib::Stream::get_size() const { return m_streamSize; }
+
+bool fslib::Stream::end_of_file() const { return m_offset >= m_streamSize; }
+
+void fslib::Stream::seek(int64_t offset, uint8_t origin)
+{
+    switch (origin)
+    {
+        case BEGINNING: m_offset = offset; break;
+        case CURRENT:   m_offset += offset; break;
+        case END:       m_offset = m_streamSize + offset; break;
+    }
+
+    if (m_offset < 0) { m_offset = 0; }
+    else if (m_offset > m_streamSize) { m_offset = m_streamSize; }
+}
+
+//                                    ---- File ----
+
+fslib::File::File(const Path &filePath, uint32_t openFlags, uint64_t fileSize) { File::open(filePath, openFlags, fileSize); }
+
+fslib::File::File(File &&file) { *this = std::move(file); }
+
+fslib::File &fslib::File::operator=(File &&file)
+{
+    File::close();
+    m_descriptor      = file.m_descriptor;
+    m_openFlags       = file.m_openFlags;
+    m_offset          = file.m_offset;
+    m_streamSize      = file.m_streamSize;
+    m_isOpen          = file.m_isOpen;
+    file.m_descriptor = -1;
+    file.m_isOpen     = false;
+    return *this;
+}
+
+fslib::File::~File() { File::close(); }
+
+void fslib::File::open(const Path &filePath, uint32_t openFlags, uint64_t fileSize)
+{
+    File::close();
+
+    const std::string hostPath = host::to_host_path(filePath);
+    if (hostPath.empty())
+    {
+        s_errorString = "Device not mapped.";
+        return;
+    }
+
+    int flags = 0;
+    if ((openFlags & FS_OPEN_READ) && (openFlags & (FS_OPEN_WRITE | FS_OPEN_APPEND))) { flags = O_RDWR; }
+    else if (openFlags & (FS_OPEN_WRITE | FS_OPEN_APPEND)) { flags = O_WRONLY; }
+    else { flags = O_RDONLY; }
+    // FsLib recreates the file at the size passed when FS_OPEN_CREATE is used.
+    if (openFlags & FS_OPEN_CREATE) { flags |= O_CREAT | O_TRUNC; }
+
+    m_descriptor = ::open(hostPath.c_str(), flags, 0644);
+    if (m_descriptor < 0) { return set_error("open"); }
+
+    if ((openFlags & FS_OPEN_CREATE) && fileSize > 0 && ::ftruncate(m_descriptor, static_cast<off_t>(fileSize)) != 0)
+    {
+        set_error("ftruncate");
+        File::close();
+        return;
+    }
+
+    struct stat fileStat{};
+    ::fstat(m_descriptor, &fileStat);
+    m_streamSize = fileStat.st_size;
+    m_offset     = (openFlags & FS_OPEN_APPEND) ? m_streamSize : 0;
+    m_openFlags  = openFlags;
+    m_isOpen     = true;
+}
+
+void fslib::File::close()
+{
+    if (m_descriptor >= 0) { ::close(m_descriptor); }
+    m_descriptor = -1;
+    m_isOpen     = false;
+}
+
+bool fslib::File::is_open() const { return m_isOpen; }
+
+ssize_t fslib::File::read(void *buffer, size_t bufferSize)
+{
+    const ssize_t bytesRead = ::pread(m_descriptor, buffer, bufferSize, static_cast<off_t>(m_offset));
+    if (bytesRead < 0)
+    {
+        set_error("pread");
+        return -1;
+    }
+    simulate_transfer(bytesRead);
+    m_offset += bytesRead;
+    return bytesRead;
+}
+
+ssize_t fslib::File::write(const void *buffer, size_t bufferSize)
+{
+    if (m_openFlags & FS_OPEN_APPEND) { m_offset = m_streamSize; }
+
+    const ssize_t bytesWritten = ::pwrite(m_descriptor, buffer, bufferSize, static_cast<off_t>(m_offset));
+    if (bytesWritten < 0)
+    {
+        set_error("pwrite");
+        return -1;
+    }
+    simulate_transfer(bytesWritten);
+    m_offset += bytesWritten;
+    if (m_offset > m_streamSize) { m_streamSize = m_offset; }
+    return bytesWritten;
+}
+
+bool fslib::File::flush() { return m_isOpen; }
+
+fslib::File &fslib::File::operator<<(const char *string)
+{
+    File::write(string, std::strlen(string));
+    return *this;
+}
+
+fslib::File &fslib::File::operator<<(const std::string &string)
+{
+    File::write(string.c_str(), string.length());
+    return *this;
+}
+
+//                                    ---- Directory ----
+
+fslib::Directory::Directory(const Path &directoryPath, bool sortedListing) { Directory::open(directoryPath, sortedListing); }
+
+void fslib::Directory::open(const Path &directoryPath, bool sortedListing)
+{
+    Directory::close();
+
+    const std::string hostPath = host::to_host_path(directoryPath);
+    DIR *directory             = hostPath.empty() ? nullptr : ::opendir(hostPath.c_str());
+    if (!directory)
+    {
+        set_error("opendir");
+        return;
+    }
+
+    for (dirent *entry = ::readdir(directory); entry; entry = ::readdir(directory))
+    {
+        if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0) { continue; }
+
+        struct stat entryStat{};
+        const std::string entryPath = hostPath + "/" + entry->d_name;
+        if (::stat(entryPath.c_str(), &entryStat) != 0) { continue; }
+
+        const bool isDirectory = S_ISDIR(entryStat.st_mode);
+        m_list.emplace_back(to_utf16(entry->d_name), isDirectory, isDirectory ? 0 : entryStat.st_size);
+    }
+    ::closedir(directory);
+
+    if (sortedListing)
+    {
+        std::sort(m_list.begin(), m_list.end(), [](const DirectoryEntry &entryA, const DirectoryEntry &entryB) {
+            if (entryA.is_directory() != entryB.is_directory()) { return entryA.is_directory(); }
+            return std::u16string_view{entryA.get_filename()} < std::u16string_view{entryB.get_filename()};
+        });
+    }
+    m_wasOpened = true;
+}
+
+void fslib::Directory::close()
+{
+    m_list.clear();
+    m_wasOpened = false;
+}
+
+bool fslib::Directory::is_open() const { return m_wasOpened; }
+
+uint32_t fslib::Directory::get_count() const { return static_cast<uint32_t>(m_list.size()); }
+
+const fslib::DirectoryEntry &fslib::Directory::operator[](int index) const { return m_list.at(index); }
+
+//                                    ---- Functions ----
+
+bool fslib::initialize()
+{
+    const char *sdmcRoot = std::getenv("JKSM_HOST_SDMC");
+    host::map_device(u"sdmc", sdmcRoot ? sdmcRoot : "./sdmc");
+    return true;
+}
+
+void fslib::exit()
+{
+    std::lock_guard deviceGuard{s_deviceLock};
+    s_deviceMap.clear();
+}
+
+bool fslib::directory_exists(const Path &directoryPath)
+{
+    struct stat pathStat{};
+    const std::string hostPath = host::to_host_path(directoryPath);
+    return !hostPath.empty() && ::stat(hostPath.c_str(), &pathStat) == 0 && S_ISDIR(pathStat.st_mode);
+}
+
+bool fslib::create_directory(const Path &directoryPath)
+{
+    const std::string hostPath = host::to_host_path(directoryPath);
+    if (hostPath.empty() || ::mkdir(hostPath.c_str(), 0755) != 0) { return set_error_return("mkdir"); }
+    return true;
+}
+
+bool fslib::create_directory_recursively(const Path &directoryPath)
+{
+    const std::string hostPath = host::to_host_path(directoryPath);
+    if (hostPath.empty()) { return set_error_return("mkdir"); }
+
+    for (size_t slash = hostPath.find('/', 1); slash != std::string::npos; slash = hostPath.find('/', slash + 1))
+    {
+        const std::string parent = hostPath.substr(0, slash);
+        if (::mkdir(parent.c_str(), 0755) != 0 && errno != EEXIST) { return set_error_return("mkdir"); }
+    }
+
+    if (::mkdir(hostPath.c_str(), 0755) != 0 && errno != EEXIST) { return set_error_return("mkdir"); }
+    return true;
+}
+
+bool fslib::delete_directory(const Path &directoryPath)
+{
+    const std::string hostPath = host::to_host_path(directoryPath);
+    if (hostPath.empty() || ::rmdir(hostPath.c_str()) != 0) { return set_error_return("rmdir"); }
+    return true;
+}
+
+bool fslib::delete_directory_recursively(const Path &directoryPath)
+{
+    Directory listing{directoryPath, false};
+    if (!listing.is_open()) { return false; }
+
+    for (uint32_t i = 0; i < listing.get_count(); i++)
+    {
+        const Path entryPath = directoryPath / listing[i];
+        if (listing[i].is_directory() && !fslib::delete_directory_recursively(entryPath)) { return false; }
+        else if (!listing[i].is_directory() && !fslib::delete_file(entryPath)) { return false; }
+    }
+
+    // Roots of devices are emptied, but not removed.
+    const std::u16string_view fullPath{directoryPath.full_path()};
+    if (fullPath.back() == u'/' && fullPath.find(u'/') == fullPath.length() - 1) { return true; }
+    return fslib::delete_directory(directoryPath);
+}
+
+bool fslib::rename_directory(const Path &oldPath, const Path &newPath)
+{
+    const std::string oldHost = host::to_host_path(oldPath);
+    const std::string newHost = host::to_host_path(newPath);
+    if (oldHost.empty() || newHost.empty() || ::rename(oldHost.c_str(), newHost.c_str()) != 0)
+    {
+        return set_error_return("rename");
+    }
+    return true;
+}
+
+bool fslib::file_exists(const Path &filePath)
+{
+    struct stat pathStat{};
+    const std::string hostPath = host::to_host_path(filePath);
+    return !hostPath.empty() && ::stat(hostPath.c_str(), &pathStat) == 0 && S_ISREG(pathStat.st_mode);
+}
+
+bool fslib::create_file(const Path &filePath, int64_t fileSize)
+{
+    File newFile{filePath, FS_OPEN_CREATE | FS_OPEN_WRITE, static_cast<uint64_t>(fileSize)};
+    return newFile.is_open();
+}
+
+bool fslib::delete_file(const Path &filePath)
+{
+    const std::string hostPath = host::to_host_path(filePath);
+    if (hostPath.empty() || ::unlink(hostPath.c_str()) != 0) { return set_error_return("unlink"); }
+    return true;
+}
+
+bool fslib::rename_file(const Path &oldPath, const Path &newPath) { return fslib::rename_directory(oldPath, newPath); }
+
+bool fslib::get_file_size(const Path &filePath, uint64_t &sizeOut)
+{
+    struct stat pathStat{};
+    const std::string hostPath = host::to_host_path(filePath);
+    if (hostPath.empty() || ::stat(hostPath.c_str(), &pathStat) != 0) { return set_error_return("stat"); }
+    sizeOut = pathStat.st_size;
+    return true;
+}
+
+bool fslib::control_device(std::u16string_view device)
+{
+    std::lock_guard deviceGuard{s_deviceLock};
+    if (s_deviceMap.find(std::u16string{device}) == s_deviceMap.end())
+    {
+        s_errorString = "Device not mapped.";
+        return false;
+    }
+    ++s_commitCount;
+    return true;
+}
+
+bool fslib::close_device(std::u16string_view device)
+{
+    std::lock_guard deviceGuard{s_deviceLock};
+    return s_deviceMap.erase(std::u16string{device}) > 0;
+}
+
+// The archive opening functions can't know where the host copy of an archive lives, so they only succeed when the device
+// was already mapped with host::map_device.
+static bool device_is_mapped(std::u16string_view device)
+{
+    std::lock_guard deviceGuard{s_deviceLock};
+    return s_deviceMap.find(std::u16string{device}) != s_deviceMap.end();
+}
+
+bool fslib::open_user_save_data(std::u16string_view device, FS_MediaType, uint64_t) { return device_is_mapped(device); }
+
+bool fslib::open_system_save_data(std::u16string_view device, uint32_t) { return device_is_mapped(device); }
+
+bool fslib::open_extra_data(std::u16string_view device, uint32_t) { return device_is_mapped(device); }
+
+bool fslib::open_shared_extra_data(std::u16string_view device, uint32_t) { return device_is_mapped(device); }
+
+bool fslib::open_boss_extra_data(std::u16string_view device, uint32_t) { return device_is_mapped(device); }
+
+bool fslib::get_secure_value_for_title(uint32_t uniqueID, uint64_t &valueOut)
+{
+    std::lock_guard deviceGuard{s_deviceLock};
+    auto findValue = s_secureValues.find(uniqueID);
+    if (findValue == s_secureValues.end()) { return false; }
+    valueOut = findValue->second;
+    return true;
+}
+
+bool fslib::set_secure_value_for_title(uint32_t uniqueID, uint64_t value)
+{
+    std::lock_guard deviceGuard{s_deviceLock};
+    s_secureValues[uniqueID] = value;
+    return true;
+}
+
+bool fslib::dev::initialize_sdmc() { return true; }
+
+const char *fslib::error::get_string() { return s_errorString.c_str(); }
+
+void fslib::host::map_device(std::u16string_view device, std::string_view hostPath)
+{
+    std::string root{hostPath};
+    while (root.length() > 1 && root.back() == '/') { root.pop_back(); }
+
+    std::lock_guard deviceGuard{s_deviceLock};
+    s_deviceMap[std::u16string{device}] = root;
+}
+
+std::string fslib::host::to_host_path(const Path &path)
+{
+    const std::u16string_view fullPath{path.full_path()};
+    const size_t colon = fullPath.find(u':');
+    if (colon == std::u16string_view::npos) { return {}; }
+
+    std::string root{};
+    {
+        std::lock_guard deviceGuard{s_deviceLock};
+        auto findDevice = s_deviceMap.find(std::u16string{fullPath.substr(0, colon)});
+        if (findDevice == s_deviceMap.end()) { return {}; }
+        root = findDevice->second;
+    }
+
+    std::u16string_view subPath = fullPath.substr(colon + 1);
+    while (!subPath.empty() && subPath.front() == u'/') { subPath.remove_prefix(1); }
+    while (!subPath.empty() && subPath.back() == u'/') { subPath.remove_suffix(1); }
+    if (subPath.empty()) { return root; }
+    return root + "/" + to_utf8(subPath);
+}
+
+uint64_t fslib::host::get_commit_count() { return s_commitCount.load(); }
+
+void fslib::host::reset_commit_count() { s_commitCount = 0; }
+
+void fslib::host::set_device_speed(uint32_t latency, uint32_t megabytesPerSecond)
+{
+    s_deviceLatency = latency;
+    s_deviceSpeed   = megabytesPerSecond;
+}